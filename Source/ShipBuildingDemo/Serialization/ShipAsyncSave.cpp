@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipAsyncSave.h"
+#include "ShipSaveGame.h"
+#include "Async/Async.h"
+
+DECLARE_LOG_CATEGORY_CLASS(LogShipAsyncSave, Log, All);
+
+TSharedRef<FShipAsyncSave, ESPMode::ThreadSafe> FShipAsyncSave::Start(const FString& ShipName, const TArray<AShipPart*>& ShipParts, const FShipSaveQuantization& Quantization, const FOnShipAsyncSaveComplete& OnComplete)
+{
+	check(IsInGameThread());
+
+	TSharedRef<FShipAsyncSave, ESPMode::ThreadSafe> Save = MakeShareable(new FShipAsyncSave(ShipName, Quantization, OnComplete));
+	Save->Snapshot.Capture(ShipParts);
+	Save->Header.Capture(ShipParts);
+	Save->Header.FormatVersion = ShipSaveFormat::Latest;
+
+	AsyncTask(ENamedThreads::AnyThread, [Save]() { Save->EncodeShipData(); });
+	return Save;
+}
+
+FShipAsyncSave::FShipAsyncSave(const FString& InShipName, const FShipSaveQuantization& InQuantization, const FOnShipAsyncSaveComplete& InOnComplete)
+: ShipName(InShipName)
+, Quantization(InQuantization)
+, OnComplete(InOnComplete)
+, UncompressedSize(0)
+, bComplete(false)
+{
+}
+
+void FShipAsyncSave::EncodeShipData()
+{
+	UShipSaveGame::EncodeShipData(Snapshot, Quantization, ShipData, UncompressedSize);
+	Snapshot.Reset();
+
+	TSharedRef<FShipAsyncSave, ESPMode::ThreadSafe> Save = AsShared();
+	AsyncTask(ENamedThreads::GameThread, [Save]() { Save->SerializeSaveGame(); });
+}
+
+void FShipAsyncSave::SerializeSaveGame()
+{
+	check(IsInGameThread());
+
+	// A new object rather than the one in the slot, as everything in it is about to be replaced anyway.
+	UShipSaveGame* SaveGame = Cast<UShipSaveGame>(UGameplayStatics::CreateSaveGameObject(UShipSaveGame::StaticClass()));
+	if (!SaveGame)
+	{
+		Finish(false);
+		return;
+	}
+
+	SaveGame->SetShipData(ShipName, MoveTemp(ShipData), UncompressedSize);
+	if (!UGameplayStatics::SaveGameToMemory(SaveGame, FileBytes))
+	{
+		Finish(false);
+		return;
+	}
+
+	TSharedRef<FShipAsyncSave, ESPMode::ThreadSafe> Save = AsShared();
+	AsyncTask(ENamedThreads::AnyThread, [Save]() { Save->WriteFile(); });
+}
+
+void FShipAsyncSave::WriteFile()
+{
+	const bool bSuccess = ShipSaveFile::Write(ShipName, Header, FileBytes);
+	UE_CLOG(bSuccess, LogShipAsyncSave, Log, TEXT("Saved %s in %d bytes"), *ShipName, FShipSaveHeader::Size + FileBytes.Num());
+	FileBytes.Empty();
+
+	TSharedRef<FShipAsyncSave, ESPMode::ThreadSafe> Save = AsShared();
+	AsyncTask(ENamedThreads::GameThread, [Save, bSuccess]() { Save->Finish(bSuccess); });
+}
+
+void FShipAsyncSave::Finish(bool bSuccess)
+{
+	check(IsInGameThread());
+	bComplete = true;
+	OnComplete.ExecuteIfBound(ShipName, bSuccess);
+}
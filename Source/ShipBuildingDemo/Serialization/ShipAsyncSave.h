@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ShipRecords.h"
+#include "ShipSaveFile.h"
+
+// Called on the game thread once an async save has finished.
+DECLARE_DELEGATE_TwoParams(FOnShipAsyncSaveComplete, const FString& /*ShipName*/, bool /*bSuccess*/);
+
+/**
+ *	Saves a ship without blocking the game thread for more than it takes to copy the parts' state.
+ *	 1. Game thread: captures a FShipSnapshot of the parts.
+ *	 2. Worker: encodes and compresses the snapshot.
+ *	 3. Game thread: wraps the data in a UShipSaveGame and serializes it (just the name and a byte array at this point).
+ *	 4. Worker: writes the file with ShipSaveFile::Write.
+ *	Never reads the existing slot.
+ */
+class SHIPBUILDINGDEMO_API FShipAsyncSave : public TSharedFromThis<FShipAsyncSave, ESPMode::ThreadSafe>
+{
+public:
+	/**
+	 *	Starts saving a ship. Must be called on the game thread.
+	 *
+	 *	@param ShipName: The name of the ship, also used as the slot name.
+	 *	@param ShipParts: The parts that make up the ship.
+	 *	@param Quantization: How precisely to store the part transforms.
+	 *	@param OnComplete: Called on the game thread when the save has finished or failed.
+	 *	@return: The save, which keeps itself alive until it's complete.
+	 */
+	static TSharedRef<FShipAsyncSave, ESPMode::ThreadSafe> Start(const FString& ShipName, const TArray<class AShipPart*>& ShipParts, const FShipSaveQuantization& Quantization, const FOnShipAsyncSaveComplete& OnComplete);
+
+	FORCEINLINE const FString& GetShipName() const noexcept { return ShipName; }
+	FORCEINLINE bool IsComplete() const { return bComplete; }
+
+private:
+	FShipAsyncSave(const FString& InShipName, const FShipSaveQuantization& InQuantization, const FOnShipAsyncSaveComplete& InOnComplete);
+
+	// The steps of the save, in order. Each one queues the next on the thread it needs.
+	void EncodeShipData();
+	void SerializeSaveGame();
+	void WriteFile();
+	void Finish(bool bSuccess);
+
+	FString ShipName;
+	FShipSaveQuantization Quantization;
+	FOnShipAsyncSaveComplete OnComplete;
+
+	// Only valid until it's encoded.
+	FShipSnapshot Snapshot;
+
+	// Captured with the snapshot, written in front of the save game.
+	FShipSaveHeader Header;
+
+	// Output of UShipSaveGame::EncodeShipData.
+	TArray<uint8> ShipData;
+	int32 UncompressedSize;
+
+	// The serialized save game to write.
+	TArray<uint8> FileBytes;
+
+	FThreadSafeBool bComplete;
+};
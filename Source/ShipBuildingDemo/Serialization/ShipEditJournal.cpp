@@ -0,0 +1,758 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipEditJournal.h"
+#include "ShipSaveGame.h"
+#include "ShipBuilding/ShipPart.h"
+#include "Async/Async.h"
+
+DECLARE_LOG_CATEGORY_CLASS(LogShipEditJournal, Log, All);
+
+namespace ShipEditJournal
+{
+	const uint32 JournalMagic = 0x4A504853; // 'SHPJ'
+	const uint32 SnapshotMagic = 0x53504853; // 'SHPS'
+	const uint32 Version = 2;
+
+	enum ERecordType : uint8
+	{
+		RT_Spawn,	// Id, class path, transform.
+		RT_Destroy,	// Id.
+		RT_Move,	// Id, location.
+		RT_Attach,	// Id and point index of both points.
+		RT_Detach,	// Id and point index of both points.
+	};
+
+	// Written at the start of each journal.
+	struct FJournalHeader
+	{
+		uint32 Magic = JournalMagic;
+		uint32 FileVersion = Version;
+		int32 Generation = 0;
+
+		// Generation the ship was replaced in.
+		int32 FirstGeneration = 0;
+
+		// Number of parts in the ship when it was replaced. If there were any, the journals can only be replayed on top of a snapshot.
+		int32 NumBaseParts = 0;
+
+		friend FArchive& operator<<(FArchive& Ar, FJournalHeader& Header)
+		{
+			Ar << Header.Magic << Header.FileVersion << Header.Generation << Header.FirstGeneration;
+			if (Header.FileVersion >= 2)
+			{
+				Ar << Header.NumBaseParts;
+			}
+			return Ar;
+		}
+	};
+
+	FString GetFilename(const FString& Directory, const TCHAR* Prefix, int32 Generation)
+	{
+		return Directory / FString::Printf(TEXT("%s_%d.bin"), Prefix, Generation);
+	}
+
+	// Gets the generations of the files with a prefix, in ascending order.
+	void FindGenerations(const FString& Directory, const TCHAR* Prefix, TArray<int32>& OutGenerations)
+	{
+		TArray<FString> Filenames;
+		IFileManager::Get().FindFiles(Filenames, *(Directory / FString::Printf(TEXT("%s_*.bin"), Prefix)), true, false);
+
+		const int32 PrefixLength = FCString::Strlen(Prefix) + 1;
+		for (const FString& Filename : Filenames)
+		{
+			const FString Number = FPaths::GetBaseFilename(Filename).Mid(PrefixLength);
+			if (Number.IsNumeric())
+			{
+				OutGenerations.Add(FCString::Atoi(*Number));
+			}
+		}
+		OutGenerations.Sort();
+	}
+
+	// Attachments are stored with the lower part (or point) first and sorted, as FShipSnapshot::Encode expects.
+	FShipAttachmentSnapshot MakeAttachment(int32 PartA, int32 PointA, int32 PartB, int32 PointB)
+	{
+		if (PartB < PartA || (PartB == PartA && PointB < PointA))
+		{
+			Swap(PartA, PartB);
+			Swap(PointA, PointB);
+		}
+		return { PartA, PointA, PartB, PointB };
+	}
+
+	bool IsSameAttachment(const FShipAttachmentSnapshot& A, const FShipAttachmentSnapshot& B)
+	{
+		return A.PartA == B.PartA && A.PointA == B.PointA && A.PartB == B.PartB && A.PointB == B.PointB;
+	}
+
+	bool IsPartAlive(const FShipSnapshot& Snapshot, int32 PartId)
+	{
+		return Snapshot.Parts.IsValidIndex(PartId) && Snapshot.Parts[PartId].TemplateIndex != INDEX_NONE;
+	}
+
+	// Applies a single record to a snapshot. Parts that are destroyed are kept (with no template) until RemoveDestroyedParts so ids stay the same.
+	bool ReplayRecord(FArchive& Ar, FShipSnapshot& Snapshot)
+	{
+		uint8 RecordType = 0;
+		int32 PartId = INDEX_NONE;
+		Ar << RecordType << PartId;
+		if (Ar.IsError() || PartId < 0)
+		{
+			return false;
+		}
+
+		switch (RecordType)
+		{
+		case RT_Spawn:
+		{
+			FString TemplatePath;
+			FTransform Transform;
+			Ar << TemplatePath << Transform;
+
+			// Ids are given out in order, so this only skips ids if records for parts that failed to spawn were dropped.
+			while (Snapshot.Parts.Num() <= PartId)
+			{
+				FShipPartSnapshot& Part = Snapshot.Parts[Snapshot.Parts.AddDefaulted()];
+				Part.TemplateIndex = INDEX_NONE;
+			}
+
+			FShipPartSnapshot& Part = Snapshot.Parts[PartId];
+			Part.TemplateIndex = Snapshot.Templates.AddUnique(TemplatePath);
+			Part.Transform = Transform;
+			Part.Properties.Empty();
+			break;
+		}
+		case RT_Destroy:
+			if (IsPartAlive(Snapshot, PartId))
+			{
+				Snapshot.Parts[PartId].TemplateIndex = INDEX_NONE;
+				Snapshot.Parts[PartId].Properties.Empty();
+				Snapshot.Attachments.RemoveAll([PartId](const FShipAttachmentSnapshot& Attachment) { return Attachment.PartA == PartId || Attachment.PartB == PartId; });
+			}
+			break;
+		case RT_Move:
+		{
+			FVector Location;
+			Ar << Location;
+			if (IsPartAlive(Snapshot, PartId))
+			{
+				Snapshot.Parts[PartId].Transform.SetLocation(Location);
+			}
+			break;
+		}
+		case RT_Attach:
+		case RT_Detach:
+		{
+			int32 PointA = INDEX_NONE;
+			int32 OtherPartId = INDEX_NONE;
+			int32 PointB = INDEX_NONE;
+			Ar << PointA << OtherPartId << PointB;
+			if (!IsPartAlive(Snapshot, PartId) || !IsPartAlive(Snapshot, OtherPartId) || PointA < 0 || PointB < 0)
+			{
+				break;
+			}
+
+			const FShipAttachmentSnapshot Attachment = MakeAttachment(PartId, PointA, OtherPartId, PointB);
+			const int32 ExistingIndex = Snapshot.Attachments.IndexOfByPredicate([&Attachment](const FShipAttachmentSnapshot& Other) { return IsSameAttachment(Attachment, Other); });
+			if (RecordType == RT_Attach && ExistingIndex == INDEX_NONE)
+			{
+				Snapshot.Attachments.Add(Attachment);
+			}
+			else if (RecordType == RT_Detach && ExistingIndex != INDEX_NONE)
+			{
+				Snapshot.Attachments.RemoveAtSwap(ExistingIndex);
+			}
+			break;
+		}
+		default:
+			UE_LOG(LogShipEditJournal, Error, TEXT("Unknown journal record %d."), RecordType);
+			return false;
+		}
+		return !Ar.IsError();
+	}
+
+	// Removes the destroyed parts, renumbering the rest in order. Same as FShipEditJournal does at the start of each generation.
+	void RemoveDestroyedParts(FShipSnapshot& Snapshot)
+	{
+		TArray<int32> NewIds;
+		NewIds.SetNumUninitialized(Snapshot.Parts.Num());
+
+		int32 NumAlive = 0;
+		for (int32 PartId = 0; PartId < Snapshot.Parts.Num(); ++PartId)
+		{
+			if (Snapshot.Parts[PartId].TemplateIndex == INDEX_NONE)
+			{
+				NewIds[PartId] = INDEX_NONE;
+				continue;
+			}
+
+			NewIds[PartId] = NumAlive;
+			if (NumAlive != PartId)
+			{
+				Snapshot.Parts[NumAlive] = MoveTemp(Snapshot.Parts[PartId]);
+			}
+			++NumAlive;
+		}
+		Snapshot.Parts.SetNum(NumAlive);
+
+		for (FShipAttachmentSnapshot& Attachment : Snapshot.Attachments)
+		{
+			Attachment = MakeAttachment(NewIds[Attachment.PartA], Attachment.PointA, NewIds[Attachment.PartB], Attachment.PointB);
+		}
+		Snapshot.Attachments.Sort([](const FShipAttachmentSnapshot& A, const FShipAttachmentSnapshot& B)
+		{
+			return (A.PartA != B.PartA) ? (A.PartA < B.PartA) : (A.PointA < B.PointA);
+		});
+	}
+
+	/**
+	 *	Replays a journal on top of a snapshot.
+	 *
+	 *	@param Filename: The journal.
+	 *	@param FirstGeneration: The generation the ship was replaced in. Journals from before then are rejected.
+	 *	@param Snapshot: The ship at the start of the journal.
+	 *	@return: False if the journal couldn't be read or isn't for the same ship.
+	 */
+	bool ReplayJournal(const FString& Filename, int32 FirstGeneration, FShipSnapshot& Snapshot)
+	{
+		TArray<uint8> FileBytes;
+		if (!FFileHelper::LoadFileToArray(FileBytes, *Filename, FILEREAD_Silent))
+		{
+			UE_LOG(LogShipEditJournal, Error, TEXT("Failed to read %s"), *Filename);
+			return false;
+		}
+		INC_DWORD_STAT_BY(STAT_ShipLoadBytesRead, FileBytes.Num());
+
+		FMemoryReader Reader{ FileBytes };
+		FJournalHeader Header;
+		Reader << Header;
+		if (Reader.IsError() || Header.Magic != JournalMagic || Header.FileVersion > Version || Header.FirstGeneration != FirstGeneration)
+		{
+			UE_LOG(LogShipEditJournal, Warning, TEXT("%s isn't a journal for the current ship."), *Filename);
+			return false;
+		}
+
+		// Each flush is a block with its own CRC. Stop at the first one that wasn't completely written.
+		while (!Reader.AtEnd())
+		{
+			int32 BlockSize = 0;
+			uint32 BlockCrc = 0;
+			Reader << BlockSize << BlockCrc;
+
+			const int64 BlockStart = Reader.Tell();
+			if (Reader.IsError() || BlockSize < 0 || BlockStart + BlockSize > FileBytes.Num() || FCrc::MemCrc32(FileBytes.GetData() + BlockStart, BlockSize) != BlockCrc)
+			{
+				UE_LOG(LogShipEditJournal, Warning, TEXT("%s ends with a partially written flush, ignoring the rest."), *Filename);
+				break;
+			}
+
+			while (Reader.Tell() < BlockStart + BlockSize)
+			{
+				if (!ReplayRecord(Reader, Snapshot))
+				{
+					UE_LOG(LogShipEditJournal, Error, TEXT("%s has a corrupt record."), *Filename);
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool WriteSnapshot(const FString& Filename, int32 Generation, int32 FirstGeneration, const FShipSnapshot& Snapshot, const FShipSaveQuantization& Quantization)
+	{
+		TArray<uint8> ShipData;
+		int32 UncompressedSize = 0;
+		UShipSaveGame::EncodeShipData(Snapshot, Quantization, ShipData, UncompressedSize);
+
+		TArray<uint8> FileBytes;
+		FMemoryWriter Writer{ FileBytes };
+		uint32 Magic = SnapshotMagic;
+		uint32 FileVersion = Version;
+		int32 FormatVersion = ShipSaveFormat::Latest;
+		uint32 Crc = FCrc::MemCrc32(ShipData.GetData(), ShipData.Num());
+		Writer << Magic << FileVersion << Generation << FirstGeneration << FormatVersion << UncompressedSize << Crc << ShipData;
+		if (!FFileHelper::SaveArrayToFile(FileBytes, *Filename))
+		{
+			return false;
+		}
+		INC_DWORD_STAT_BY(STAT_ShipSaveBytesWritten, FileBytes.Num());
+		return true;
+	}
+
+	bool ReadSnapshot(const FString& Filename, int32 FirstGeneration, FShipSnapshot& OutSnapshot)
+	{
+		TArray<uint8> FileBytes;
+		if (!FFileHelper::LoadFileToArray(FileBytes, *Filename, FILEREAD_Silent))
+		{
+			UE_LOG(LogShipEditJournal, Error, TEXT("Failed to read %s"), *Filename);
+			return false;
+		}
+		INC_DWORD_STAT_BY(STAT_ShipLoadBytesRead, FileBytes.Num());
+
+		FMemoryReader Reader{ FileBytes };
+		uint32 Magic = 0;
+		uint32 FileVersion = 0;
+		int32 FileGeneration = 0;
+		int32 FileFirstGeneration = 0;
+		int32 FormatVersion = 0;
+		int32 UncompressedSize = 0;
+		uint32 Crc = 0;
+		TArray<uint8> ShipData;
+		Reader << Magic << FileVersion << FileGeneration << FileFirstGeneration << FormatVersion << UncompressedSize << Crc << ShipData;
+		if (Reader.IsError() || Magic != SnapshotMagic || FileVersion > Version || FileFirstGeneration != FirstGeneration || FCrc::MemCrc32(ShipData.GetData(), ShipData.Num()) != Crc)
+		{
+			UE_LOG(LogShipEditJournal, Error, TEXT("%s is corrupt or isn't a snapshot of the current ship."), *Filename);
+			return false;
+		}
+
+		OutSnapshot.Reset();
+		return UShipSaveGame::DecodeShipData(ShipData, UncompressedSize, FormatVersion, OutSnapshot);
+	}
+
+	/**
+	 *	Builds the ship from a snapshot and the journals after it.
+	 *
+	 *	@param Directory: Where the files are.
+	 *	@param FirstGeneration: The generation the ship was replaced in.
+	 *	@param SnapshotGeneration: The snapshot to start from, or INDEX_NONE to start from an empty ship at FirstGeneration.
+	 *	@param NumBaseParts: Number of parts in the ship at FirstGeneration.
+	 *	@param LastJournal: The last journal to replay.
+	 *	@param OutSnapshot: The ship.
+	 *	@return: True if the ship was built.
+	 */
+	bool FoldGenerations(const FString& Directory, int32 FirstGeneration, int32 SnapshotGeneration, int32 NumBaseParts, int32 LastJournal, FShipSnapshot& OutSnapshot)
+	{
+		OutSnapshot.Reset();
+
+		// Replaying onto an empty ship would lose every part the ship started with.
+		if (SnapshotGeneration == INDEX_NONE && NumBaseParts > 0)
+		{
+			UE_LOG(LogShipEditJournal, Error, TEXT("The snapshot of the %d parts the autosaved ship started with in generation %d was never written."), NumBaseParts, FirstGeneration);
+			return false;
+		}
+
+		if (SnapshotGeneration != INDEX_NONE && !ReadSnapshot(GetFilename(Directory, TEXT("Snapshot"), SnapshotGeneration), FirstGeneration, OutSnapshot))
+		{
+			return false;
+		}
+
+		for (int32 JournalGeneration = (SnapshotGeneration != INDEX_NONE) ? SnapshotGeneration : FirstGeneration; JournalGeneration <= LastJournal; ++JournalGeneration)
+		{
+			if (!ReplayJournal(GetFilename(Directory, TEXT("Journal"), JournalGeneration), FirstGeneration, OutSnapshot))
+			{
+				return false;
+			}
+			RemoveDestroyedParts(OutSnapshot);
+		}
+		return true;
+	}
+}
+
+FShipEditJournal::FShipEditJournal(const FString& InDirectory, const FShipSaveQuantization& InQuantization, int32 InCompactAfterRecords)
+: Directory(InDirectory)
+, Quantization(InQuantization)
+, CompactAfterRecords(InCompactAfterRecords)
+, NextPartId(0)
+, NumPendingRecords(0)
+, NumJournalRecords(0)
+, Generation(INDEX_NONE)
+, FirstGeneration(INDEX_NONE)
+, NumBaseParts(0)
+, LatestSnapshot(INDEX_NONE)
+, Epoch(0)
+, NumSnapshotsInProgress(0)
+{
+	// Carry on from any files that are already there so they're replaced rather than mixed in with.
+	TArray<int32> Generations;
+	ShipEditJournal::FindGenerations(Directory, TEXT("Journal"), Generations);
+	ShipEditJournal::FindGenerations(Directory, TEXT("Snapshot"), Generations);
+	for (int32 ExistingGeneration : Generations)
+	{
+		Generation = FMath::Max(Generation, ExistingGeneration);
+	}
+}
+
+FString FShipEditJournal::GetDefaultDirectory()
+{
+	return FPaths::GameSavedDir() / TEXT("Autosave");
+}
+
+void FShipEditJournal::Rebase(const TArray<AShipPart*>& ShipParts)
+{
+	check(IsInGameThread());
+
+	// Anything not yet written belongs to the previous ship.
+	ShipUtils::ClearArray(PendingRecords);
+	NumPendingRecords = 0;
+
+	PartIds.Reset();
+	for (int32 PartIndex = 0; PartIndex < ShipParts.Num(); ++PartIndex)
+	{
+		PartIds.Add(ShipParts[PartIndex], PartIndex);
+	}
+	NextPartId = ShipParts.Num();
+
+	++Epoch;
+	FirstGeneration = Generation + 1;
+	NumBaseParts = ShipParts.Num();
+	LatestSnapshot = INDEX_NONE;
+
+	// Kept until it's been written, so it can be tried again if writing it fails.
+	TSharedRef<FShipSnapshot, ESPMode::ThreadSafe> Snapshot = MakeShareable(new FShipSnapshot());
+	Snapshot->Capture(ShipParts);
+	BaseSnapshot = Snapshot;
+
+	// The new journal is written first, so if this is interrupted the files from the previous ship are still ignored.
+	// Its header has the number of parts, so until the snapshot is written the journal is known to be unusable rather than replayed onto an empty ship.
+	if (!StartGeneration(FirstGeneration))
+	{
+		return;
+	}
+	DeleteFilesBefore(FirstGeneration);
+
+	WriteBaseSnapshot();
+}
+
+int32 FShipEditJournal::FindPartId(const AShipPart* ShipPart) const
+{
+	const int32* PartId = PartIds.Find(ShipPart);
+	return PartId ? *PartId : INDEX_NONE;
+}
+
+void FShipEditJournal::RecordSpawn(const AShipPart* ShipPart)
+{
+	check(ShipPart);
+	if (PartIds.Contains(ShipPart))
+	{
+		return;
+	}
+
+	int32 PartId = NextPartId++;
+	PartIds.Add(ShipPart, PartId);
+
+	uint8 RecordType = ShipEditJournal::RT_Spawn;
+	FString TemplatePath = ShipPart->GetClass()->GetPathName();
+	FTransform Transform = ShipPart->GetActorTransform();
+	FMemoryWriter Writer{ PendingRecords, false, true };
+	Writer << RecordType << PartId << TemplatePath << Transform;
+	++NumPendingRecords;
+}
+
+void FShipEditJournal::RecordDestroy(const AShipPart* ShipPart)
+{
+	int32 PartId = FindPartId(ShipPart);
+	if (PartId == INDEX_NONE)
+	{
+		return;
+	}
+	PartIds.Remove(ShipPart);
+
+	uint8 RecordType = ShipEditJournal::RT_Destroy;
+	FMemoryWriter Writer{ PendingRecords, false, true };
+	Writer << RecordType << PartId;
+	++NumPendingRecords;
+}
+
+void FShipEditJournal::RecordMove(const AShipPart* ShipPart)
+{
+	int32 PartId = FindPartId(ShipPart);
+	if (PartId == INDEX_NONE)
+	{
+		return;
+	}
+
+	uint8 RecordType = ShipEditJournal::RT_Move;
+	FVector Location = ShipPart->GetActorLocation();
+	FMemoryWriter Writer{ PendingRecords, false, true };
+	Writer << RecordType << PartId << Location;
+	++NumPendingRecords;
+}
+
+void FShipEditJournal::RecordAttach(const FShipAttachPointRef& A, const FShipAttachPointRef& B)
+{
+	RecordPoints(ShipEditJournal::RT_Attach, A, B);
+}
+
+void FShipEditJournal::RecordDetach(const FShipAttachPointRef& A, const FShipAttachPointRef& B)
+{
+	RecordPoints(ShipEditJournal::RT_Detach, A, B);
+}
+
+void FShipEditJournal::RecordPoints(uint8 RecordType, const FShipAttachPointRef& A, const FShipAttachPointRef& B)
+{
+	check(A.IsValid() && B.IsValid());
+
+	// Points on parts that aren't part of the ship yet (ie. still being streamed in) are captured when the ship is rebased.
+	int32 PartIdA = FindPartId(A.ShipPart);
+	int32 PartIdB = FindPartId(B.ShipPart);
+	if (PartIdA == INDEX_NONE || PartIdB == INDEX_NONE)
+	{
+		return;
+	}
+
+	int32 PointA = A.Index;
+	int32 PointB = B.Index;
+
+	FMemoryWriter Writer{ PendingRecords, false, true };
+	Writer << RecordType << PartIdA << PointA << PartIdB << PointB;
+	++NumPendingRecords;
+}
+
+bool FShipEditJournal::Flush()
+{
+	check(IsInGameThread());
+
+	if (NumPendingRecords == 0 || Generation == INDEX_NONE)
+	{
+		return true;
+	}
+
+	const FString Filename = ShipEditJournal::GetFilename(Directory, TEXT("Journal"), Generation);
+	TUniquePtr<FArchive> Writer{ IFileManager::Get().CreateFileWriter(*Filename, FILEWRITE_Append) };
+	if (!Writer.IsValid())
+	{
+		UE_LOG(LogShipEditJournal, Error, TEXT("Failed to open %s"), *Filename);
+		return false;
+	}
+
+	int32 BlockSize = PendingRecords.Num();
+	uint32 BlockCrc = FCrc::MemCrc32(PendingRecords.GetData(), PendingRecords.Num());
+	*Writer << BlockSize << BlockCrc;
+	Writer->Serialize(PendingRecords.GetData(), PendingRecords.Num());
+	if (!Writer->Close())
+	{
+		UE_LOG(LogShipEditJournal, Error, TEXT("Failed to write %s"), *Filename);
+		return false;
+	}
+
+	INC_DWORD_STAT_BY(STAT_ShipSaveBytesWritten, sizeof(BlockSize) + sizeof(BlockCrc) + BlockSize);
+	UE_LOG(LogShipEditJournal, Verbose, TEXT("Flushed %d records (%d bytes) to %s"), NumPendingRecords, BlockSize, *Filename);
+	NumJournalRecords += NumPendingRecords;
+	NumPendingRecords = 0;
+	PendingRecords.Reset();
+
+	if (NumJournalRecords >= CompactAfterRecords && NumSnapshotsInProgress == 0)
+	{
+		StartCompaction();
+	}
+	return true;
+}
+
+void FShipEditJournal::Discard()
+{
+	check(IsInGameThread());
+
+	++Epoch;
+	ShipUtils::ClearArray(PendingRecords);
+	NumPendingRecords = 0;
+	PartIds.Reset();
+	BaseSnapshot.Reset();
+	NumBaseParts = 0;
+	LatestSnapshot = INDEX_NONE;
+	DeleteFilesBefore(MAX_int32);
+	Generation = INDEX_NONE;
+}
+
+bool FShipEditJournal::HasRecoverableShip(const FString& Directory)
+{
+	TArray<int32> Journals;
+	ShipEditJournal::FindGenerations(Directory, TEXT("Journal"), Journals);
+	return Journals.Num() > 0;
+}
+
+bool FShipEditJournal::Recover(const FString& Directory, FShipSnapshot& OutSnapshot)
+{
+	TArray<int32> Journals;
+	ShipEditJournal::FindGenerations(Directory, TEXT("Journal"), Journals);
+	if (Journals.Num() == 0)
+	{
+		return false;
+	}
+
+	// The latest journal says which generation the current ship started in.
+	const int32 LastJournal = Journals.Last();
+	TUniquePtr<FArchive> Reader{ IFileManager::Get().CreateFileReader(*ShipEditJournal::GetFilename(Directory, TEXT("Journal"), LastJournal), FILEREAD_Silent) };
+	if (!Reader.IsValid())
+	{
+		return false;
+	}
+
+	ShipEditJournal::FJournalHeader Header;
+	*Reader << Header;
+	const bool bValidHeader = !Reader->IsError() && Header.Magic == ShipEditJournal::JournalMagic && Header.FileVersion <= ShipEditJournal::Version;
+	Reader.Reset();
+
+	const int32 FirstGeneration = Header.FirstGeneration;
+	if (!bValidHeader || FirstGeneration > LastJournal)
+	{
+		UE_LOG(LogShipEditJournal, Error, TEXT("Autosave journal %d is corrupt."), LastJournal);
+		return false;
+	}
+
+	// Start from the latest snapshot of the current ship, if one was written.
+	TArray<int32> Snapshots;
+	ShipEditJournal::FindGenerations(Directory, TEXT("Snapshot"), Snapshots);
+	Snapshots.RemoveAll([FirstGeneration, LastJournal](int32 Snapshot) { return Snapshot < FirstGeneration || Snapshot > LastJournal; });
+	const int32 SnapshotGeneration = (Snapshots.Num() > 0) ? Snapshots.Last() : INDEX_NONE;
+
+	if (!ShipEditJournal::FoldGenerations(Directory, FirstGeneration, SnapshotGeneration, Header.NumBaseParts, LastJournal, OutSnapshot))
+	{
+		return false;
+	}
+
+	UE_LOG(LogShipEditJournal, Log, TEXT("Recovered autosaved ship of %d parts from snapshot %d and journals up to %d."), OutSnapshot.Parts.Num(), SnapshotGeneration, LastJournal);
+	return true;
+}
+
+bool FShipEditJournal::StartGeneration(int32 NewGeneration)
+{
+	Generation = NewGeneration;
+	NumJournalRecords = 0;
+
+	const FString Filename = ShipEditJournal::GetFilename(Directory, TEXT("Journal"), Generation);
+	TUniquePtr<FArchive> Writer{ IFileManager::Get().CreateFileWriter(*Filename) };
+	bool bSuccess = Writer.IsValid();
+	if (bSuccess)
+	{
+		ShipEditJournal::FJournalHeader Header;
+		Header.Generation = Generation;
+		Header.FirstGeneration = FirstGeneration;
+		Header.NumBaseParts = NumBaseParts;
+		*Writer << Header;
+		bSuccess = Writer->Close();
+	}
+
+	UE_CLOG(!bSuccess, LogShipEditJournal, Error, TEXT("Failed to start %s, edits won't be autosaved."), *Filename);
+	return bSuccess;
+}
+
+void FShipEditJournal::StartCompaction()
+{
+	check(NumPendingRecords == 0);
+
+	// Folding needs the ship the journals start from. Keep appending to the current journal until it's been written.
+	if (LatestSnapshot == INDEX_NONE && NumBaseParts > 0)
+	{
+		UE_LOG(LogShipEditJournal, Warning, TEXT("Autosave snapshot %d wasn't written, trying again before compacting."), FirstGeneration);
+		WriteBaseSnapshot();
+		return;
+	}
+
+	const int32 SnapshotGeneration = LatestSnapshot;
+	const int32 LastJournal = Generation;
+
+	// Renumber the parts the same way replaying the journal will.
+	PartIds.ValueSort(TLess<int32>());
+	NextPartId = 0;
+	for (TPair<const AShipPart*, int32>& PartId : PartIds)
+	{
+		PartId.Value = NextPartId++;
+	}
+
+	if (!StartGeneration(Generation + 1))
+	{
+		return;
+	}
+
+	const FString JournalDirectory = Directory;
+	const int32 JournalFirstGeneration = FirstGeneration;
+	const int32 JournalBaseParts = NumBaseParts;
+	WriteSnapshotInBackground(Generation, [JournalDirectory, JournalFirstGeneration, SnapshotGeneration, JournalBaseParts, LastJournal](FShipSnapshot& OutSnapshot)
+	{
+		return ShipEditJournal::FoldGenerations(JournalDirectory, JournalFirstGeneration, SnapshotGeneration, JournalBaseParts, LastJournal, OutSnapshot);
+	});
+}
+
+void FShipEditJournal::WriteBaseSnapshot()
+{
+	if (!BaseSnapshot.IsValid())
+	{
+		return;
+	}
+
+	TSharedRef<const FShipSnapshot, ESPMode::ThreadSafe> Snapshot = BaseSnapshot.ToSharedRef();
+	WriteSnapshotInBackground(FirstGeneration, [Snapshot](FShipSnapshot& OutSnapshot)
+	{
+		OutSnapshot = *Snapshot;
+		return true;
+	});
+}
+
+void FShipEditJournal::WriteSnapshotInBackground(int32 SnapshotGeneration, TFunction<bool(FShipSnapshot&)>&& BuildSnapshot)
+{
+	const int32 SnapshotEpoch = Epoch;
+	const int32 SnapshotFirstGeneration = FirstGeneration;
+	const FShipSaveQuantization SnapshotQuantization = Quantization;
+	const FString TempFilename = ShipEditJournal::GetFilename(Directory, TEXT("Snapshot"), SnapshotGeneration) + TEXT(".tmp");
+	TWeakPtr<FShipEditJournal, ESPMode::ThreadSafe> WeakJournal = AsShared();
+	++NumSnapshotsInProgress;
+
+	TFunction<bool(FShipSnapshot&)> Build = MoveTemp(BuildSnapshot);
+	AsyncTask(ENamedThreads::AnyThread, [=]()
+	{
+		FShipSnapshot Snapshot;
+		const bool bSuccess = Build(Snapshot) && ShipEditJournal::WriteSnapshot(TempFilename, SnapshotGeneration, SnapshotFirstGeneration, Snapshot, SnapshotQuantization);
+
+		AsyncTask(ENamedThreads::GameThread, [WeakJournal, TempFilename, SnapshotGeneration, SnapshotEpoch, bSuccess]()
+		{
+			TSharedPtr<FShipEditJournal, ESPMode::ThreadSafe> Journal = WeakJournal.Pin();
+			if (Journal.IsValid())
+			{
+				Journal->HandleSnapshotWritten(SnapshotGeneration, SnapshotEpoch, bSuccess);
+			}
+			else
+			{
+				IFileManager::Get().Delete(*TempFilename, false, false, true);
+			}
+		});
+	});
+}
+
+void FShipEditJournal::HandleSnapshotWritten(int32 SnapshotGeneration, int32 SnapshotEpoch, bool bSuccess)
+{
+	check(IsInGameThread());
+	--NumSnapshotsInProgress;
+
+	const FString Filename = ShipEditJournal::GetFilename(Directory, TEXT("Snapshot"), SnapshotGeneration);
+	const FString TempFilename = Filename + TEXT(".tmp");
+
+	// The ship has been replaced since this was started.
+	if (SnapshotEpoch != Epoch)
+	{
+		IFileManager::Get().Delete(*TempFilename, false, false, true);
+		return;
+	}
+
+	// The previous snapshot and journals are still there, so they'll be folded again next time.
+	if (!bSuccess || !IFileManager::Get().Move(*Filename, *TempFilename, true, true))
+	{
+		UE_LOG(LogShipEditJournal, Error, TEXT("Failed to write autosave snapshot %d"), SnapshotGeneration);
+		IFileManager::Get().Delete(*TempFilename, false, false, true);
+		return;
+	}
+
+	UE_LOG(LogShipEditJournal, Log, TEXT("Wrote autosave snapshot %d"), SnapshotGeneration);
+	LatestSnapshot = FMath::Max(LatestSnapshot, SnapshotGeneration);
+	DeleteFilesBefore(LatestSnapshot);
+	if (SnapshotGeneration == FirstGeneration)
+	{
+		BaseSnapshot.Reset();
+	}
+}
+
+void FShipEditJournal::DeleteFilesBefore(int32 FirstKeptGeneration) const
+{
+	for (const TCHAR* Prefix : { TEXT("Snapshot"), TEXT("Journal") })
+	{
+		TArray<int32> Generations;
+		ShipEditJournal::FindGenerations(Directory, Prefix, Generations);
+		for (int32 FileGeneration : Generations)
+		{
+			if (FileGeneration < FirstKeptGeneration)
+			{
+				IFileManager::Get().Delete(*ShipEditJournal::GetFilename(Directory, Prefix, FileGeneration), false, false, true);
+			}
+		}
+	}
+}
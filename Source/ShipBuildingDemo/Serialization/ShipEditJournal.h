@@ -0,0 +1,138 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ShipRecords.h"
+#include "ShipBuilding/ShipAttachPointData.h"
+
+class AShipPart;
+
+/**
+ *	Autosave of the ship being edited: a snapshot of the whole ship plus an append-only journal of the edits made since.
+ *	 - The controller records spawns, destroys, moves and attaches/detaches as they happen. Parts are referred to by an id.
+ *	 - Flush appends the records made since the last flush to the journal, so each autosave writes as much as was edited rather than the whole ship.
+ *	 - Once the journal gets long a new one is started, and the previous snapshot and journals are folded into a new snapshot on a worker thread.
+ *	 - After a crash, Recover replays the journals on top of the snapshot.
+ *
+ *	The files are numbered by generation: Snapshot_N is the ship at the start of Journal_N. Each file also stores the generation the ship was
+ *	last replaced in (loaded or cleared), so any files left over from a previous ship are ignored.
+ *	At the start of each generation the parts are renumbered in id order, the same as replaying does, so the ids stay small.
+ *
+ *	Game thread only, apart from the snapshots which are encoded and written in the background.
+ */
+class SHIPBUILDINGDEMO_API FShipEditJournal : public TSharedFromThis<FShipEditJournal, ESPMode::ThreadSafe>
+{
+public:
+	/**
+	 *	@param InDirectory: Where to write the autosave files.
+	 *	@param InQuantization: How precisely to store the part transforms in the snapshots.
+	 *	@param InCompactAfterRecords: Number of records to write to a journal before folding it into a new snapshot.
+	 */
+	FShipEditJournal(const FString& InDirectory, const FShipSaveQuantization& InQuantization, int32 InCompactAfterRecords);
+
+	// Saved/Autosave.
+	static FString GetDefaultDirectory();
+
+	/**
+	 *	Starts a new journal from the ship as it is now, discarding everything recorded before. Should be called whenever the whole ship is replaced.
+	 *	The ship is captured straight away, then encoded and written as the new snapshot in the background. If that fails it's tried again
+	 *	instead of compacting, and until it's written the journal can't be recovered.
+	 *
+	 *	@param ShipParts: The parts that make up the ship.
+	 */
+	void Rebase(const TArray<AShipPart*>& ShipParts);
+
+	void RecordSpawn(const AShipPart* ShipPart);
+	void RecordDestroy(const AShipPart* ShipPart);
+	void RecordMove(const AShipPart* ShipPart);
+	void RecordAttach(const FShipAttachPointRef& A, const FShipAttachPointRef& B);
+	void RecordDetach(const FShipAttachPointRef& A, const FShipAttachPointRef& B);
+
+	/**
+	 *	Appends the records made since the last flush to the journal, and starts compacting if the journal is long enough.
+	 *
+	 *	@return: False if the records couldn't be written. They're kept for the next flush.
+	 */
+	bool Flush();
+
+	// Deletes the autosave, ie. when the editor is closed normally.
+	void Discard();
+
+	/**
+	 *	Checks if there's an autosave left over from a previous session.
+	 *
+	 *	@param Directory: The directory the journal wrote to.
+	 */
+	static bool HasRecoverableShip(const FString& Directory);
+
+	/**
+	 *	Rebuilds the autosaved ship by replaying the journals on top of the latest snapshot.
+	 *	A partially written flush at the end of a journal is ignored along with anything after it. Doesn't touch any UObjects.
+	 *
+	 *	@param Directory: The directory the journal wrote to.
+	 *	@param OutSnapshot: The ship.
+	 *	@return: False if there's no autosave or it couldn't be read, including if the snapshot of the ship it started from is missing.
+	 */
+	static bool Recover(const FString& Directory, FShipSnapshot& OutSnapshot);
+
+	FORCEINLINE int32 GetGeneration() const noexcept { return Generation; }
+	FORCEINLINE int32 GetNumPendingRecords() const noexcept { return NumPendingRecords; }
+
+private:
+	// Gets the id of a part, or INDEX_NONE if it isn't part of the ship being journaled.
+	int32 FindPartId(const AShipPart* ShipPart) const;
+
+	// Writes an attach or detach record.
+	void RecordPoints(uint8 RecordType, const FShipAttachPointRef& A, const FShipAttachPointRef& B);
+
+	// Starts a new, empty journal file.
+	bool StartGeneration(int32 NewGeneration);
+
+	// Starts a new generation and folds the previous ones into its snapshot in the background.
+	void StartCompaction();
+
+	// Writes the snapshot of the ship captured by Rebase, if it hasn't been written yet.
+	void WriteBaseSnapshot();
+
+	// Builds a snapshot on a worker and writes it to a temp file, which is moved into place by HandleSnapshotWritten.
+	void WriteSnapshotInBackground(int32 SnapshotGeneration, TFunction<bool(FShipSnapshot&)>&& BuildSnapshot);
+	void HandleSnapshotWritten(int32 SnapshotGeneration, int32 SnapshotEpoch, bool bSuccess);
+
+	// Deletes the files from before a generation.
+	void DeleteFilesBefore(int32 FirstKeptGeneration) const;
+
+	FString Directory;
+	FShipSaveQuantization Quantization;
+	int32 CompactAfterRecords;
+
+	// Ids of the parts in the ship being journaled.
+	TMap<const AShipPart*, int32> PartIds;
+	int32 NextPartId;
+
+	// Records made since the last flush.
+	TArray<uint8> PendingRecords;
+	int32 NumPendingRecords;
+
+	// Records flushed to the current journal.
+	int32 NumJournalRecords;
+
+	// Generation of the journal being written to.
+	int32 Generation;
+
+	// Generation the ship was last replaced in.
+	int32 FirstGeneration;
+
+	// Number of parts in the ship when it was last replaced.
+	int32 NumBaseParts;
+
+	// The ship as it was when it was last replaced, until it's been written as the snapshot at FirstGeneration.
+	TSharedPtr<const FShipSnapshot, ESPMode::ThreadSafe> BaseSnapshot;
+
+	// Generation of the latest snapshot that's been written. INDEX_NONE if there isn't one since the ship was replaced.
+	int32 LatestSnapshot;
+
+	// Changed whenever the ship is replaced, so snapshots of the previous ship are thrown away when they finish.
+	int32 Epoch;
+
+	int32 NumSnapshotsInProgress;
+};
@@ -0,0 +1,456 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipLibraryPack.h"
+
+DECLARE_LOG_CATEGORY_CLASS(LogShipLibraryPack, Log, All);
+
+namespace ShipLibraryPack
+{
+	const uint32 Magic = 0x4B504853; // 'SHPK'
+	const uint32 Version = 1;
+
+	// Magic, version, index offset, number of entries and index CRC.
+	const int64 FooterSize = 4 + 4 + 8 + 4 + 4;
+}
+
+const float FShipLibraryPack::CompactThreshold = 0.5f;
+
+FShipLibraryPack::FShipLibraryPack(const FString& InFilename)
+: Filename(InFilename)
+, FileSize(-1)
+, WastedBytes(0)
+{
+}
+
+FString FShipLibraryPack::GetDefaultFilename()
+{
+	return FPaths::GetPath(ShipSaveFile::GetSlotFilename(TEXT("ShipLibrary"))) / TEXT("ShipLibrary.pack");
+}
+
+bool FShipLibraryPack::Save(const FString& ShipName, FShipSaveHeader& Header, USaveGame* SaveGame)
+{
+	check(IsInGameThread());
+
+	if (!RefreshIndex())
+	{
+		UE_LOG(LogShipLibraryPack, Error, TEXT("Can't save %s, %s couldn't be read."), *ShipName, *Filename);
+		return false;
+	}
+
+	TArray<uint8> SaveGameBytes;
+	if (!UGameplayStatics::SaveGameToMemory(SaveGame, SaveGameBytes))
+	{
+		return false;
+	}
+
+	FEntry Entry;
+	Entry.Offset = FileSize;
+	Entry.Header = Header;
+	Entry.Header.PayloadSize = SaveGameBytes.Num();
+	Entry.Header.PayloadCrc = FCrc::MemCrc32(SaveGameBytes.GetData(), SaveGameBytes.Num());
+	Header = Entry.Header;
+
+	// Only keep the compressed version if it's actually smaller.
+	TArray<uint8> Blob;
+	int32 CompressedSize = FCompression::CompressMemoryBound(COMPRESS_ZLIB, SaveGameBytes.Num());
+	Blob.SetNumUninitialized(CompressedSize);
+	if (FCompression::CompressMemory(COMPRESS_ZLIB, Blob.GetData(), CompressedSize, SaveGameBytes.GetData(), SaveGameBytes.Num()) && CompressedSize < SaveGameBytes.Num())
+	{
+		Blob.SetNum(CompressedSize);
+		Entry.UncompressedSize = SaveGameBytes.Num();
+	}
+	else
+	{
+		Blob = MoveTemp(SaveGameBytes);
+	}
+	Entry.Size = Blob.Num();
+
+	Index.Add(ShipName, Entry);
+	if (!Append(Blob))
+	{
+		return false;
+	}
+
+	UE_LOG(LogShipLibraryPack, Log, TEXT("Saved %s in %d bytes, %lld of %lld bytes in the pack are unused."), *ShipName, Entry.Size, WastedBytes, FileSize);
+	if (WastedBytes > FileSize * CompactThreshold)
+	{
+		Compact();
+	}
+	return true;
+}
+
+USaveGame* FShipLibraryPack::Load(const FString& ShipName)
+{
+	check(IsInGameThread());
+
+	if (!RefreshIndex())
+	{
+		return nullptr;
+	}
+
+	const FEntry* Entry = Index.Find(ShipName);
+	if (!Entry)
+	{
+		return nullptr;
+	}
+
+	TArray<uint8> SaveGameBytes;
+	if (!ReadBlob(*Entry, SaveGameBytes))
+	{
+		UE_LOG(LogShipLibraryPack, Error, TEXT("Save for %s in %s is corrupt."), *ShipName, *Filename);
+		return nullptr;
+	}
+	return UGameplayStatics::LoadGameFromMemory(SaveGameBytes);
+}
+
+bool FShipLibraryPack::Remove(const FString& ShipName)
+{
+	return RefreshIndex() && Index.Remove(ShipName) > 0 && Append(TArray<uint8>());
+}
+
+bool FShipLibraryPack::Contains(const FString& ShipName)
+{
+	return RefreshIndex() && Index.Contains(ShipName);
+}
+
+void FShipLibraryPack::GetShips(TArray<FShipSaveInfo>& OutShips)
+{
+	OutShips.Reset();
+	if (!RefreshIndex())
+	{
+		return;
+	}
+
+	OutShips.Reserve(Index.Num());
+	for (const TPair<FString, FEntry>& Entry : Index)
+	{
+		FShipSaveInfo& Info = OutShips[OutShips.AddDefaulted()];
+		Info.ShipName = Entry.Key;
+		Info.NumParts = Entry.Value.Header.NumParts;
+		Info.SizeBytes = Entry.Value.Size;
+		Info.ModifiedTime = Entry.Value.Header.SavedTime;
+		Info.RootPartType = Entry.Value.Header.RootPartType;
+	}
+	OutShips.Sort([](const FShipSaveInfo& A, const FShipSaveInfo& B) { return A.ShipName < B.ShipName; });
+}
+
+bool FShipLibraryPack::Compact()
+{
+	check(IsInGameThread());
+
+	if (!RefreshIndex())
+	{
+		return false;
+	}
+
+	if (WastedBytes == 0)
+	{
+		return true;
+	}
+
+	const FString TempFilename = Filename + TEXT(".tmp");
+	TUniquePtr<FArchive> Writer{ IFileManager::Get().CreateFileWriter(*TempFilename) };
+	TUniquePtr<FArchive> Reader{ IFileManager::Get().CreateFileReader(*Filename) };
+	bool bSuccess = Writer.IsValid() && Reader.IsValid();
+
+	// Copy the blobs still in use to the start of the new pack, in the order they were in.
+	TMap<FString, FEntry> Compacted;
+	if (bSuccess)
+	{
+		Index.ValueSort([](const FEntry& A, const FEntry& B) { return A.Offset < B.Offset; });
+
+		TArray<uint8> Blob;
+		int64 Offset = 0;
+		for (const TPair<FString, FEntry>& Entry : Index)
+		{
+			Blob.SetNumUninitialized(Entry.Value.Size, false);
+			Reader->Seek(Entry.Value.Offset);
+			Reader->Serialize(Blob.GetData(), Blob.Num());
+			Writer->Serialize(Blob.GetData(), Blob.Num());
+
+			FEntry& CompactedEntry = Compacted.Add(Entry.Key, Entry.Value);
+			CompactedEntry.Offset = Offset;
+			Offset += Entry.Value.Size;
+		}
+
+		WriteIndex(*Writer, Compacted, Offset);
+		bSuccess = !Reader->IsError() && Writer->Close();
+	}
+
+	// Both need to be closed before the pack can be replaced.
+	Reader.Reset();
+	Writer.Reset();
+
+	if (bSuccess)
+	{
+		bSuccess = IFileManager::Get().Move(*Filename, *TempFilename, true, true);
+	}
+	else
+	{
+		IFileManager::Get().Delete(*TempFilename, false, false, true);
+	}
+
+	if (!bSuccess)
+	{
+		UE_LOG(LogShipLibraryPack, Error, TEXT("Failed to compact %s"), *Filename);
+		return false;
+	}
+
+	UE_LOG(LogShipLibraryPack, Log, TEXT("Compacted %s, removed %lld bytes."), *Filename, WastedBytes);
+	Index = MoveTemp(Compacted);
+	WastedBytes = 0;
+	UpdateFileStat();
+	return true;
+}
+
+bool FShipLibraryPack::RefreshIndex()
+{
+	if (FileSize >= 0)
+	{
+		const FFileStatData StatData = IFileManager::Get().GetStatData(*Filename);
+		const int64 CurrentSize = StatData.bIsValid ? StatData.FileSize : 0;
+		if (CurrentSize == FileSize && (!StatData.bIsValid || StatData.ModificationTime == Timestamp))
+		{
+			return true;
+		}
+	}
+	return ReadIndex();
+}
+
+bool FShipLibraryPack::ReadIndex()
+{
+	Index.Reset();
+	WastedBytes = 0;
+	FileSize = -1;
+
+	const FFileStatData StatData = IFileManager::Get().GetStatData(*Filename);
+	if (!StatData.bIsValid)
+	{
+		// Nothing saved yet.
+		FileSize = 0;
+		return true;
+	}
+
+	TUniquePtr<FArchive> Reader{ IFileManager::Get().CreateFileReader(*Filename, FILEREAD_Silent) };
+	if (!Reader.IsValid())
+	{
+		return false;
+	}
+
+	const int64 TotalSize = Reader->TotalSize();
+	if (TotalSize < ShipLibraryPack::FooterSize)
+	{
+		UE_LOG(LogShipLibraryPack, Error, TEXT("%s is too small to be a ship library pack."), *Filename);
+		return false;
+	}
+
+	int64 IndexOffset = 0;
+	if (!ReadIndexAt(*Reader, TotalSize - ShipLibraryPack::FooterSize, Index, IndexOffset))
+	{
+		// A save was cut off or failed part way through, so fall back to the index before it.
+		// New saves are still appended after the partial write; it's removed next time the pack is compacted.
+		UE_LOG(LogShipLibraryPack, Warning, TEXT("%s doesn't end with a valid index, looking for the last complete save."), *Filename);
+		if (!FindLastValidIndex(*Reader, Index, IndexOffset))
+		{
+			UE_LOG(LogShipLibraryPack, Error, TEXT("%s has no valid index."), *Filename);
+			return false;
+		}
+	}
+
+	FileSize = TotalSize;
+	Timestamp = StatData.ModificationTime;
+	UpdateWastedBytes(IndexOffset);
+	return true;
+}
+
+bool FShipLibraryPack::ReadIndexAt(FArchive& Reader, int64 FooterOffset, TMap<FString, FEntry>& OutIndex, int64& OutIndexOffset)
+{
+	OutIndex.Reset();
+	if (FooterOffset < 0 || FooterOffset + ShipLibraryPack::FooterSize > Reader.TotalSize())
+	{
+		return false;
+	}
+
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	int64 IndexOffset = 0;
+	int32 NumEntries = 0;
+	uint32 IndexCrc = 0;
+	Reader.Seek(FooterOffset);
+	Reader << Magic << Version << IndexOffset << NumEntries << IndexCrc;
+
+	if (Reader.IsError() || Magic != ShipLibraryPack::Magic || Version > ShipLibraryPack::Version || IndexOffset < 0 || IndexOffset > FooterOffset || NumEntries < 0)
+	{
+		return false;
+	}
+
+	TArray<uint8> IndexBytes;
+	IndexBytes.SetNumUninitialized(FooterOffset - IndexOffset);
+	Reader.Seek(IndexOffset);
+	Reader.Serialize(IndexBytes.GetData(), IndexBytes.Num());
+	if (Reader.IsError() || FCrc::MemCrc32(IndexBytes.GetData(), IndexBytes.Num()) != IndexCrc)
+	{
+		return false;
+	}
+
+	FMemoryReader IndexReader{ IndexBytes };
+	OutIndex.Reserve(NumEntries);
+	for (int32 EntryIndex = 0; EntryIndex < NumEntries; ++EntryIndex)
+	{
+		FString ShipName;
+		FEntry Entry;
+		IndexReader << ShipName << Entry.Offset << Entry.Size << Entry.UncompressedSize;
+		if (!Entry.Header.Read(IndexReader) || IndexReader.IsError() || Entry.Offset < 0 || Entry.Size < 0 || Entry.Offset + Entry.Size > IndexOffset)
+		{
+			OutIndex.Reset();
+			return false;
+		}
+		OutIndex.Add(ShipName, Entry);
+	}
+
+	OutIndexOffset = IndexOffset;
+	return true;
+}
+
+bool FShipLibraryPack::FindLastValidIndex(FArchive& Reader, TMap<FString, FEntry>& OutIndex, int64& OutIndexOffset)
+{
+	// Scan back through the file a chunk at a time for the footer magic. Chunks overlap so a footer split across two is still found.
+	static const int64 ChunkSize = 64 * 1024;
+	const uint32 Magic = ShipLibraryPack::Magic;
+	const int64 LastFooterOffset = Reader.TotalSize() - ShipLibraryPack::FooterSize;
+
+	TArray<uint8> Chunk;
+	int64 ChunkEnd = LastFooterOffset + sizeof(Magic) - 1;
+	while (ChunkEnd >= (int64)sizeof(Magic))
+	{
+		const int64 ChunkStart = FMath::Max<int64>(ChunkEnd - ChunkSize, 0);
+		Chunk.SetNumUninitialized(ChunkEnd - ChunkStart);
+		Reader.Seek(ChunkStart);
+		Reader.Serialize(Chunk.GetData(), Chunk.Num());
+		if (Reader.IsError())
+		{
+			return false;
+		}
+
+		for (int32 i = Chunk.Num() - (int32)sizeof(Magic); i >= 0; --i)
+		{
+			const int64 FooterOffset = ChunkStart + i;
+			if (FooterOffset < LastFooterOffset && FMemory::Memcmp(&Chunk[i], &Magic, sizeof(Magic)) == 0 && ReadIndexAt(Reader, FooterOffset, OutIndex, OutIndexOffset))
+			{
+				return true;
+			}
+		}
+
+		if (ChunkStart == 0)
+		{
+			break;
+		}
+		ChunkEnd = ChunkStart + sizeof(Magic) - 1;
+	}
+	return false;
+}
+
+bool FShipLibraryPack::Append(const TArray<uint8>& Blob)
+{
+	const int64 PreviousFileSize = FileSize;
+	const int64 IndexOffset = FileSize + Blob.Num();
+
+	// Everything's written after the current index, which stays valid until the new footer is complete.
+	bool bSuccess = false;
+	TUniquePtr<FArchive> Writer{ IFileManager::Get().CreateFileWriter(*Filename, FILEWRITE_Append) };
+	if (Writer.IsValid())
+	{
+		Writer->Serialize(const_cast<uint8*>(Blob.GetData()), Blob.Num());
+		WriteIndex(*Writer, Index, IndexOffset);
+		bSuccess = Writer->Close();
+	}
+
+	if (!bSuccess)
+	{
+		UE_LOG(LogShipLibraryPack, Error, TEXT("Failed to write %s"), *Filename);
+
+		// Index has already been changed, so make sure it's read back from the file. Reading falls back to the previous footer if this one was partly written.
+		FileSize = -1;
+		return false;
+	}
+
+	UpdateFileStat();
+	UpdateWastedBytes(IndexOffset);
+	INC_DWORD_STAT_BY(STAT_ShipSaveBytesWritten, FMath::Max<int64>(FileSize - PreviousFileSize, 0));
+	return true;
+}
+
+void FShipLibraryPack::WriteIndex(FArchive& Ar, const TMap<FString, FEntry>& Entries, int64 IndexOffset)
+{
+	TArray<uint8> IndexBytes;
+	FMemoryWriter IndexWriter{ IndexBytes };
+	for (const TPair<FString, FEntry>& Entry : Entries)
+	{
+		FString ShipName = Entry.Key;
+		int64 Offset = Entry.Value.Offset;
+		int32 Size = Entry.Value.Size;
+		int32 UncompressedSize = Entry.Value.UncompressedSize;
+		IndexWriter << ShipName << Offset << Size << UncompressedSize;
+		Entry.Value.Header.Write(IndexWriter);
+	}
+	Ar.Serialize(IndexBytes.GetData(), IndexBytes.Num());
+
+	uint32 Magic = ShipLibraryPack::Magic;
+	uint32 Version = ShipLibraryPack::Version;
+	int32 NumEntries = Entries.Num();
+	uint32 IndexCrc = FCrc::MemCrc32(IndexBytes.GetData(), IndexBytes.Num());
+	Ar << Magic << Version << IndexOffset << NumEntries << IndexCrc;
+}
+
+bool FShipLibraryPack::ReadBlob(const FEntry& Entry, TArray<uint8>& OutSaveGameBytes) const
+{
+	TUniquePtr<FArchive> Reader{ IFileManager::Get().CreateFileReader(*Filename, FILEREAD_Silent) };
+	if (!Reader.IsValid())
+	{
+		return false;
+	}
+
+	TArray<uint8> Blob;
+	Blob.SetNumUninitialized(Entry.Size);
+	Reader->Seek(Entry.Offset);
+	Reader->Serialize(Blob.GetData(), Blob.Num());
+	if (Reader->IsError())
+	{
+		return false;
+	}
+	INC_DWORD_STAT_BY(STAT_ShipLoadBytesRead, Blob.Num());
+
+	if (Entry.UncompressedSize == 0)
+	{
+		OutSaveGameBytes = MoveTemp(Blob);
+	}
+	else
+	{
+		OutSaveGameBytes.SetNumUninitialized(Entry.UncompressedSize);
+		if (!FCompression::UncompressMemory(COMPRESS_ZLIB, OutSaveGameBytes.GetData(), OutSaveGameBytes.Num(), Blob.GetData(), Blob.Num()))
+		{
+			return false;
+		}
+	}
+
+	return OutSaveGameBytes.Num() == Entry.Header.PayloadSize
+		&& FCrc::MemCrc32(OutSaveGameBytes.GetData(), OutSaveGameBytes.Num()) == Entry.Header.PayloadCrc;
+}
+
+void FShipLibraryPack::UpdateFileStat()
+{
+	const FFileStatData StatData = IFileManager::Get().GetStatData(*Filename);
+	FileSize = StatData.bIsValid ? StatData.FileSize : -1;
+	Timestamp = StatData.ModificationTime;
+}
+
+void FShipLibraryPack::UpdateWastedBytes(int64 IndexOffset)
+{
+	int64 UsedBytes = 0;
+	for (const TPair<FString, FEntry>& Entry : Index)
+	{
+		UsedBytes += Entry.Value.Size;
+	}
+	WastedBytes = IndexOffset - UsedBytes;
+}
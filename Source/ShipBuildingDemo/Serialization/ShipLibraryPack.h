@@ -0,0 +1,142 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ShipSaveFile.h"
+#include "ShipSaveLibrary.h"
+
+class USaveGame;
+
+/**
+ *	All the saved ships in a single pack file rather than a slot each.
+ *
+ *	Layout: [blob][blob]...[index][footer]. Each blob is a serialized UShipSaveGame, compressed if that makes it smaller.
+ *	The index holds the name, location and save header of every ship, and the footer at the end of the file says where the index is.
+ *	Saving only ever appends (the blob, then a new index and footer), so a failed or interrupted write leaves the previous index intact.
+ *	If the end of the file isn't a valid footer, reading searches back for the last footer whose index is intact and carries on from there.
+ *	Blobs that have been replaced, and anything left by a failed write, stay in the file until Compact rewrites it.
+ *
+ *	Listing the ships only reads the footer and index, and loading a ship reads just its blob.
+ *	The index is cached and re-read whenever the file's timestamp or size changes. Game thread only.
+ */
+class SHIPBUILDINGDEMO_API FShipLibraryPack
+{
+public:
+	explicit FShipLibraryPack(const FString& InFilename);
+
+	// The pack in the save games directory.
+	static FString GetDefaultFilename();
+
+	/**
+	 *	Saves a ship, replacing any existing one with the same name.
+	 *
+	 *	@param ShipName: The name of the ship.
+	 *	@param Header: The header for the ship. Its payload size and CRC are filled in.
+	 *	@param SaveGame: The save game to write.
+	 *	@return: True if the ship was saved.
+	 */
+	bool Save(const FString& ShipName, FShipSaveHeader& Header, USaveGame* SaveGame);
+
+	/**
+	 *	Loads a ship.
+	 *
+	 *	@param ShipName: The name of the ship.
+	 *	@return: The save game or nullptr if it isn't in the pack or couldn't be loaded.
+	 */
+	USaveGame* Load(const FString& ShipName);
+
+	/**
+	 *	Removes a ship. Its blob is left in the file until it's compacted.
+	 *
+	 *	@param ShipName: The name of the ship.
+	 *	@return: True if the ship was in the pack and was removed.
+	 */
+	bool Remove(const FString& ShipName);
+
+	// Is there a ship with this name in the pack.
+	bool Contains(const FString& ShipName);
+
+	/**
+	 *	Gets all the ships in the pack, ordered by name.
+	 *
+	 *	@param OutShips: The ships in the pack.
+	 */
+	void GetShips(TArray<FShipSaveInfo>& OutShips);
+
+	/**
+	 *	Rewrites the pack with only the blobs that are still in use.
+	 *
+	 *	@return: True if the pack was rewritten or there was nothing to remove.
+	 */
+	bool Compact();
+
+	FORCEINLINE const FString& GetFilename() const noexcept { return Filename; }
+
+	// Bytes used by blobs that have been replaced or removed.
+	FORCEINLINE int64 GetWastedBytes() const noexcept { return WastedBytes; }
+
+private:
+	struct FEntry
+	{
+		int64 Offset = 0;
+		int32 Size = 0;
+
+		// 0 if the blob isn't compressed.
+		int32 UncompressedSize = 0;
+
+		FShipSaveHeader Header;
+	};
+
+	// Re-reads the index if the file has changed since it was last read.
+	bool RefreshIndex();
+	bool ReadIndex();
+
+	/**
+	 *	Reads the index of a footer, checking the footer and index are intact.
+	 *
+	 *	@param Reader: The pack file.
+	 *	@param FooterOffset: Where the footer starts.
+	 *	@param OutIndex: The index that was read.
+	 *	@param OutIndexOffset: Where the index starts, which is also the end of the blobs it refers to.
+	 *	@return: True if there's a valid footer and index at the offset.
+	 */
+	static bool ReadIndexAt(FArchive& Reader, int64 FooterOffset, TMap<FString, FEntry>& OutIndex, int64& OutIndexOffset);
+
+	/**
+	 *	Searches back from the end of the file for the last footer with an intact index, ie. after a write was cut off.
+	 *
+	 *	@param Reader: The pack file.
+	 *	@param OutIndex: The index that was found.
+	 *	@param OutIndexOffset: Where the index starts.
+	 *	@return: True if a valid footer was found.
+	 */
+	static bool FindLastValidIndex(FArchive& Reader, TMap<FString, FEntry>& OutIndex, int64& OutIndexOffset);
+
+	// Appends a blob (which may be empty) then the current index and footer to the file.
+	bool Append(const TArray<uint8>& Blob);
+
+	// Writes an index and footer for blobs before IndexOffset.
+	static void WriteIndex(FArchive& Ar, const TMap<FString, FEntry>& Entries, int64 IndexOffset);
+
+	// Reads and decompresses a ship's blob.
+	bool ReadBlob(const FEntry& Entry, TArray<uint8>& OutSaveGameBytes) const;
+
+	// Remembers the file's size and timestamp so our own writes don't cause the index to be re-read.
+	void UpdateFileStat();
+
+	void UpdateWastedBytes(int64 IndexOffset);
+
+	FString Filename;
+
+	// By ship name.
+	TMap<FString, FEntry> Index;
+
+	// Size and timestamp of the file when Index was read, to tell when it's changed.
+	int64 FileSize;
+	FDateTime Timestamp;
+
+	int64 WastedBytes;
+
+	// Compact once over this fraction of the file is wasted.
+	static const float CompactThreshold;
+};
@@ -2,6 +2,452 @@
 
 #include "ShipBuildingDemo.h"
 #include "ShipRecords.h"
+#include "ShipSaveGame.h"
 #include "ShipBuilding/ShipPart.h"
 
+DECLARE_LOG_CATEGORY_CLASS(LogShipSnapshot, Log, All);
 
+namespace
+{
+	// Flags stored with each part saying which optional fields follow.
+	enum EPartFlags : uint8
+	{
+		PF_Rotated		= 1 << 0,
+		PF_Scaled		= 1 << 1,
+		PF_Properties	= 1 << 2,
+	};
+
+	// Maps signed values to unsigned so that small negative numbers stay small when packed.
+	FORCEINLINE uint32 ZigZag(int32 Value) { return (uint32(Value) << 1) ^ uint32(Value >> 31); }
+	FORCEINLINE int32 UnZigZag(uint32 Value) { return int32(Value >> 1) ^ -int32(Value & 1); }
+
+	FORCEINLINE void WritePacked(FArchive& Ar, int32 Value)
+	{
+		uint32 Packed = uint32(Value);
+		Ar.SerializeIntPacked(Packed);
+	}
+
+	// Same format as FArchive::SerializeIntPacked, which keeps reading forever if the data ends partway through a value.
+	FORCEINLINE uint32 ReadPackedUnsigned(FArchive& Ar)
+	{
+		uint32 Value = 0;
+		for (int32 Shift = 0; Shift < 32; Shift += 7)
+		{
+			uint8 NextByte = 0;
+			Ar << NextByte;
+			Value += uint32(NextByte >> 1) << Shift;
+			if (!(NextByte & 1))
+			{
+				break;
+			}
+		}
+		return Value;
+	}
+
+	FORCEINLINE int32 ReadPacked(FArchive& Ar)
+	{
+		return int32(ReadPackedUnsigned(Ar));
+	}
+
+	// Reads a count, failing the archive if it couldn't possibly fit in what's left of it.
+	FORCEINLINE int32 ReadCount(FArchive& Ar, int32 MinBytesPerItem = 1)
+	{
+		const int32 Count = ReadPacked(Ar);
+		if (Count < 0 || int64(Count) * MinBytesPerItem > Ar.TotalSize() - Ar.Tell())
+		{
+			Ar.ArIsError = true;
+			return 0;
+		}
+		return Count;
+	}
+
+	// Reads a string, failing the archive rather than allocating it if it's longer than what's left.
+	FORCEINLINE void ReadString(FArchive& Ar, FString& OutString)
+	{
+		const int64 Start = Ar.Tell();
+		int32 Length = 0;
+		Ar << Length;
+
+		// Negative lengths are UTF-16.
+		const int64 NumBytes = (Length < 0) ? -int64(Length) * 2 : int64(Length);
+		if (Ar.IsError() || NumBytes > Ar.TotalSize() - Ar.Tell())
+		{
+			Ar.ArIsError = true;
+			return;
+		}
+
+		Ar.Seek(Start);
+		Ar << OutString;
+	}
+
+	FORCEINLINE uint32 QuantizeAngle(float Degrees, int32 Bits)
+	{
+		const uint32 NumSteps = 1u << Bits;
+		return uint32(FMath::RoundToInt(FRotator::ClampAxis(Degrees) / 360.f * NumSteps)) & (NumSteps - 1);
+	}
+
+	FORCEINLINE float DequantizeAngle(uint32 Value, int32 Bits)
+	{
+		return FRotator::NormalizeAxis(Value * 360.f / float(1u << Bits));
+	}
+}
+
+void FShipSnapshot::Capture(const TArray<AShipPart*>& ShipParts)
+{
+	Reset();
+
+	TMap<UClass*, int32> TemplateIndices;
+	TMap<FName, int32> PropertyIndices;
+	Parts.Reserve(ShipParts.Num());
+
+	for (AShipPart* ShipPart : ShipParts)
+	{
+		UClass* PartClass = ShipPart->GetClass();
+		const int32* TemplateIndex = TemplateIndices.Find(PartClass);
+		if (!TemplateIndex)
+		{
+			TemplateIndex = &TemplateIndices.Add(PartClass, Templates.Add(PartClass->GetPathName()));
+		}
+
+		FShipPartSnapshot& Part = Parts[Parts.AddDefaulted()];
+		Part.TemplateIndex = *TemplateIndex;
+		Part.Transform = ShipPart->GetActorTransform();
+
+		// Only SaveGame properties that have been changed from the class defaults are worth storing.
+		const AShipPart* Defaults = PartClass->GetDefaultObject<AShipPart>();
+		for (TFieldIterator<UProperty> It(PartClass); It; ++It)
+		{
+			UProperty* Property = *It;
+			if (!Property->HasAnyPropertyFlags(CPF_SaveGame))
+			{
+				continue;
+			}
+
+			bool bIdentical = true;
+			for (int32 i = 0; bIdentical && i < Property->ArrayDim; ++i)
+			{
+				bIdentical = Property->Identical_InContainer(ShipPart, Defaults, i);
+			}
+			if (bIdentical)
+			{
+				continue;
+			}
+
+			const int32* NameIndex = PropertyIndices.Find(Property->GetFName());
+			if (!NameIndex)
+			{
+				NameIndex = &PropertyIndices.Add(Property->GetFName(), PropertyNames.Add(Property->GetFName()));
+			}
+
+			FShipPropertySnapshot& Saved = Part.Properties[Part.Properties.AddDefaulted()];
+			Saved.NameIndex = *NameIndex;
+
+			FMemoryWriter MemoryWriter{ Saved.Value };
+			FShipSaveGameArchiveProxy Archive{ MemoryWriter };
+			for (int32 i = 0; i < Property->ArrayDim; ++i)
+			{
+				Property->SerializeItem(Archive, Property->ContainerPtrToValuePtr<void>(ShipPart, i), nullptr);
+			}
+		}
+	}
+
+	// Store each attachment once, from the part that comes first.
+	TMap<const AShipPart*, int32> PartIndices;
+	PartIndices.Reserve(ShipParts.Num());
+	for (int32 PartIndex = 0; PartIndex < ShipParts.Num(); ++PartIndex)
+	{
+		PartIndices.Add(ShipParts[PartIndex], PartIndex);
+	}
+
+	for (int32 PartIndex = 0; PartIndex < ShipParts.Num(); ++PartIndex)
+	{
+		const TArray<FShipAttachPointData>& AttachPoints = ShipParts[PartIndex]->GetAttachPoints();
+		for (int32 PointIndex = 0; PointIndex < AttachPoints.Num(); ++PointIndex)
+		{
+			const FShipAttachPointData& AttachPoint = AttachPoints[PointIndex];
+			const int32* OtherPartIndex = AttachPoint.IsAttached() ? PartIndices.Find(AttachPoint.AttachedToPart) : nullptr;
+			if (!OtherPartIndex)
+			{
+				continue;
+			}
+
+			const int32 OtherPointIndex = AttachPoint.AttachedToIndex;
+			if (*OtherPartIndex > PartIndex || (*OtherPartIndex == PartIndex && OtherPointIndex > PointIndex))
+			{
+				Attachments.Add({ PartIndex, PointIndex, *OtherPartIndex, OtherPointIndex });
+			}
+		}
+	}
+}
+
+int32 FShipSnapshot::RestoreAttachments(const TArray<AShipPart*>& ShipParts) const
+{
+	check(ShipParts.Num() == Parts.Num());
+
+	// Returns the point if it's still there and free to attach.
+	auto GetFreePoint = [&ShipParts](int32 PartIndex, int32 PointIndex) -> FShipAttachPointRef
+	{
+		AShipPart* ShipPart = ShipParts[PartIndex];
+		if (!ShipPart || !ShipPart->GetAttachPoints().IsValidIndex(PointIndex) || ShipPart->GetAttachPoints()[PointIndex].IsAttached())
+		{
+			return FShipAttachPointRef();
+		}
+		return FShipAttachPointRef(ShipPart, PointIndex);
+	};
+
+	int32 NumFailed = 0;
+	for (const FShipAttachmentSnapshot& Attachment : Attachments)
+	{
+		const FShipAttachPointRef A = GetFreePoint(Attachment.PartA, Attachment.PointA);
+		const FShipAttachPointRef B = GetFreePoint(Attachment.PartB, Attachment.PointB);
+		if (A.IsValid() && B.IsValid() && A != B)
+		{
+			AShipPart::RestoreAttachment(A, B);
+		}
+		else
+		{
+			UE_LOG(LogShipSnapshot, Warning, TEXT("Couldn't restore attachment between point %d of %s and point %d of %s. The parts may have changed since they were saved."),
+				Attachment.PointA, *GetNameSafe(ShipParts[Attachment.PartA]), Attachment.PointB, *GetNameSafe(ShipParts[Attachment.PartB]));
+			++NumFailed;
+		}
+	}
+	return NumFailed;
+}
+
+void FShipSnapshot::ApplyProperties(int32 PartIndex, AShipPart* ShipPart) const
+{
+	check(ShipPart);
+	UClass* PartClass = ShipPart->GetClass();
+	for (const FShipPropertySnapshot& Saved : Parts[PartIndex].Properties)
+	{
+		const FName PropertyName = PropertyNames[Saved.NameIndex];
+		UProperty* Property = FindField<UProperty>(PartClass, PropertyName);
+		if (!Property || !Property->HasAnyPropertyFlags(CPF_SaveGame))
+		{
+			UE_LOG(LogShipSnapshot, Verbose, TEXT("Skipping saved property %s as it's no longer saved by %s."), *PropertyName.ToString(), *GetNameSafe(PartClass));
+			continue;
+		}
+
+		FMemoryReader MemoryReader{ Saved.Value, true };
+		FShipSaveGameArchiveProxy Archive{ MemoryReader };
+		for (int32 i = 0; i < Property->ArrayDim; ++i)
+		{
+			Property->SerializeItem(Archive, Property->ContainerPtrToValuePtr<void>(ShipPart, i), nullptr);
+		}
+	}
+}
+
+void FShipSnapshot::Encode(const FShipSaveQuantization& Quantization, TArray<uint8>& OutBytes) const
+{
+	OutBytes.Reset();
+	FMemoryWriter Ar{ OutBytes };
+
+	float PositionStep = FMath::Max(Quantization.PositionStep, KINDA_SMALL_NUMBER);
+	uint8 RotationBits = (uint8)FMath::Clamp(Quantization.RotationBits, 1, 16);
+	Ar << PositionStep << RotationBits;
+
+	WritePacked(Ar, Templates.Num());
+	for (const FString& Template : Templates)
+	{
+		Ar << const_cast<FString&>(Template);
+	}
+
+	// Names are written as strings as FName indices aren't stable between runs.
+	WritePacked(Ar, PropertyNames.Num());
+	for (const FName& PropertyName : PropertyNames)
+	{
+		FString Name = PropertyName.ToString();
+		Ar << Name;
+	}
+
+	WritePacked(Ar, Parts.Num());
+	int32 PreviousPosition[3] = { 0, 0, 0 };
+	for (const FShipPartSnapshot& Part : Parts)
+	{
+		const FVector Location = Part.Transform.GetLocation();
+		const FRotator Rotation = Part.Transform.Rotator();
+		const FVector Scale = Part.Transform.GetScale3D();
+
+		const int32 Position[3] = {
+			FMath::RoundToInt(Location.X / PositionStep),
+			FMath::RoundToInt(Location.Y / PositionStep),
+			FMath::RoundToInt(Location.Z / PositionStep)
+		};
+		uint32 Angles[3] = {
+			QuantizeAngle(Rotation.Pitch, RotationBits),
+			QuantizeAngle(Rotation.Yaw, RotationBits),
+			QuantizeAngle(Rotation.Roll, RotationBits)
+		};
+
+		uint8 Flags = 0;
+		Flags |= (Angles[0] | Angles[1] | Angles[2]) ? PF_Rotated : 0;
+		Flags |= !Scale.Equals(FVector(1.f)) ? PF_Scaled : 0;
+		Flags |= (Part.Properties.Num() > 0) ? PF_Properties : 0;
+
+		WritePacked(Ar, Part.TemplateIndex);
+		Ar << Flags;
+
+		// Positions are stored relative to the previous part as neighbouring parts tend to be close together.
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			uint32 Delta = ZigZag(Position[Axis] - PreviousPosition[Axis]);
+			Ar.SerializeIntPacked(Delta);
+			PreviousPosition[Axis] = Position[Axis];
+		}
+
+		if (Flags & PF_Rotated)
+		{
+			for (uint32& Angle : Angles)
+			{
+				Ar.SerializeIntPacked(Angle);
+			}
+		}
+
+		if (Flags & PF_Scaled)
+		{
+			FVector ScaleToWrite = Scale;
+			Ar << ScaleToWrite;
+		}
+
+		if (Flags & PF_Properties)
+		{
+			WritePacked(Ar, Part.Properties.Num());
+			for (const FShipPropertySnapshot& Saved : Part.Properties)
+			{
+				WritePacked(Ar, Saved.NameIndex);
+				WritePacked(Ar, Saved.Value.Num());
+				Ar.Serialize(const_cast<uint8*>(Saved.Value.GetData()), Saved.Value.Num());
+			}
+		}
+	}
+
+	// Attachments are sorted by the first part so it's stored relative to the previous one, and the second part relative to the first.
+	WritePacked(Ar, Attachments.Num());
+	int32 PreviousPartA = 0;
+	for (const FShipAttachmentSnapshot& Attachment : Attachments)
+	{
+		uint32 PartBDelta = ZigZag(Attachment.PartB - Attachment.PartA);
+		WritePacked(Ar, Attachment.PartA - PreviousPartA);
+		WritePacked(Ar, Attachment.PointA);
+		Ar.SerializeIntPacked(PartBDelta);
+		WritePacked(Ar, Attachment.PointB);
+		PreviousPartA = Attachment.PartA;
+	}
+}
+
+bool FShipSnapshot::Decode(const TArray<uint8>& Bytes, int32 FormatVersion /*= ShipSaveFormat::Latest*/)
+{
+	Reset();
+	FMemoryReader Ar{ Bytes, true };
+
+	float PositionStep = 0.f;
+	uint8 RotationBits = 0;
+	Ar << PositionStep << RotationBits;
+	if (PositionStep <= 0.f || RotationBits < 1 || RotationBits > 16)
+	{
+		UE_LOG(LogShipSnapshot, Error, TEXT("Invalid quantization in compact ship data."));
+		return false;
+	}
+
+	Templates.SetNum(ReadCount(Ar));
+	for (FString& Template : Templates)
+	{
+		ReadString(Ar, Template);
+	}
+
+	PropertyNames.SetNum(ReadCount(Ar));
+	for (FName& PropertyName : PropertyNames)
+	{
+		FString Name;
+		ReadString(Ar, Name);
+		PropertyName = *Name;
+	}
+
+	// Every part takes at least 5 bytes (template, flags and position).
+	Parts.SetNum(ReadCount(Ar, 5));
+	int32 Position[3] = { 0, 0, 0 };
+	for (FShipPartSnapshot& Part : Parts)
+	{
+		Part.TemplateIndex = ReadPacked(Ar);
+		uint8 Flags = 0;
+		Ar << Flags;
+
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			Position[Axis] += UnZigZag(ReadPackedUnsigned(Ar));
+		}
+		Part.Transform.SetLocation(FVector(Position[0], Position[1], Position[2]) * PositionStep);
+
+		if (Flags & PF_Rotated)
+		{
+			uint32 Angles[3] = { 0, 0, 0 };
+			for (uint32& Angle : Angles)
+			{
+				Angle = ReadPackedUnsigned(Ar);
+			}
+			Part.Transform.SetRotation(FRotator(DequantizeAngle(Angles[0], RotationBits), DequantizeAngle(Angles[1], RotationBits), DequantizeAngle(Angles[2], RotationBits)).Quaternion());
+		}
+
+		if (Flags & PF_Scaled)
+		{
+			FVector Scale;
+			Ar << Scale;
+			Part.Transform.SetScale3D(Scale);
+		}
+
+		if (Flags & PF_Properties)
+		{
+			Part.Properties.SetNum(ReadCount(Ar, 2));
+			for (FShipPropertySnapshot& Saved : Part.Properties)
+			{
+				Saved.NameIndex = ReadPacked(Ar);
+				Saved.Value.SetNumUninitialized(ReadCount(Ar));
+				Ar.Serialize(Saved.Value.GetData(), Saved.Value.Num());
+
+				if (!PropertyNames.IsValidIndex(Saved.NameIndex))
+				{
+					Ar.ArIsError = true;
+				}
+			}
+		}
+
+		if (Ar.IsError() || !Templates.IsValidIndex(Part.TemplateIndex))
+		{
+			UE_LOG(LogShipSnapshot, Error, TEXT("Compact ship data is corrupt."));
+			Reset();
+			return false;
+		}
+	}
+
+	if (FormatVersion >= ShipSaveFormat::Attachments)
+	{
+		// Every attachment takes at least 4 bytes.
+		Attachments.SetNum(ReadCount(Ar, 4));
+		int32 PartA = 0;
+		for (FShipAttachmentSnapshot& Attachment : Attachments)
+		{
+			PartA += ReadPacked(Ar);
+			Attachment.PartA = PartA;
+			Attachment.PointA = ReadPacked(Ar);
+			Attachment.PartB = PartA + UnZigZag(ReadPackedUnsigned(Ar));
+			Attachment.PointB = ReadPacked(Ar);
+
+			if (Ar.IsError() || !Parts.IsValidIndex(Attachment.PartA) || !Parts.IsValidIndex(Attachment.PartB) || Attachment.PointA < 0 || Attachment.PointB < 0)
+			{
+				UE_LOG(LogShipSnapshot, Error, TEXT("Compact ship data has corrupt attachments."));
+				Reset();
+				return false;
+			}
+		}
+	}
+
+	return !Ar.IsError();
+}
+
+void FShipSnapshot::Reset()
+{
+	ShipUtils::ClearArray(Templates);
+	ShipUtils::ClearArray(PropertyNames);
+	ShipUtils::ClearArray(Parts);
+	ShipUtils::ClearArray(Attachments);
+}
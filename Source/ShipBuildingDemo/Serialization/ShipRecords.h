@@ -5,8 +5,11 @@
 #include "ShipBuilding/ShipBuildingTypes.h"
 #include "ShipRecords.generated.h"
 
+class AShipPart;
+
 /**
  * Represents the data for a ship part that is written to disk.
+ * Only used by saves in the legacy format, see FShipSnapshot for the compact one.
  */
 USTRUCT()
 struct FShipPartRecord
@@ -21,8 +24,140 @@ struct FShipPartRecord
 	UPROPERTY()
 	FTransform PartTransform;
 
-	// Part data - should retain attach point info like which other point it's attached to.
+	// SaveGame properties of the part. Attachments aren't stored in the legacy format, see FShipSnapshot::Attachments.
 	UPROPERTY()
 	TArray<uint8> ShipPartData;
 };
 
+/**
+ * How precisely part transforms are stored in the compact save format.
+ */
+USTRUCT(BlueprintType)
+struct FShipSaveQuantization
+{
+	GENERATED_BODY()
+
+	// Size in uu of the steps positions are rounded to.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ShipSaving")
+	float PositionStep = 0.01f;
+
+	// Number of bits used for each rotation axis (1-16).
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ShipSaving")
+	int32 RotationBits = 16;
+};
+
+namespace ShipSaveFormat
+{
+	// Versions of the data stored in UShipSaveGame.
+	enum Type : int32
+	{
+		// FShipPartRecords with full class paths, transforms and AShipPart::Serialize blobs.
+		Legacy = 0,
+		// FShipSnapshot encoded with a template table and quantized transforms.
+		Compact = 1,
+		// Compact with the attachments between parts.
+		Attachments = 2,
+		// Attachments with the encoded data zlib compressed (if that makes it smaller).
+		Compressed = 3,
+
+		Latest = Compressed
+	};
+}
+
+/**
+ * A SaveGame flagged property of a part that differs from the class defaults.
+ */
+struct FShipPropertySnapshot
+{
+	// Index into FShipSnapshot::PropertyNames.
+	int32 NameIndex;
+
+	// The property value serialized through FShipSaveGameArchiveProxy.
+	TArray<uint8> Value;
+};
+
+/**
+ * The saved state of a single part.
+ */
+struct FShipPartSnapshot
+{
+	// Index into FShipSnapshot::Templates.
+	int32 TemplateIndex;
+
+	FTransform Transform;
+
+	TArray<FShipPropertySnapshot> Properties;
+};
+
+/**
+ * Two attached points, by the index of their part in FShipSnapshot::Parts and their index in the part's AShipPart::GetAttachPoints.
+ * Stored once per pair with the lower part (or point) index first.
+ */
+struct FShipAttachmentSnapshot
+{
+	int32 PartA;
+	int32 PointA;
+	int32 PartB;
+	int32 PointB;
+};
+
+/**
+ * Plain data copy of a ship that can be encoded to and decoded from the compact save format.
+ * Capturing and applying touch the parts so must happen on the game thread, but encoding and decoding don't touch any UObjects.
+ */
+struct SHIPBUILDINGDEMO_API FShipSnapshot
+{
+	// Path names of the part classes used by the ship. Each is only stored once.
+	TArray<FString> Templates;
+
+	// Names of the properties saved by any of the parts. Each is only stored once.
+	TArray<FName> PropertyNames;
+
+	TArray<FShipPartSnapshot> Parts;
+
+	// Which parts are attached to each other, sorted by PartA. Attachments to parts that weren't captured are dropped.
+	TArray<FShipAttachmentSnapshot> Attachments;
+
+	/**
+	 *	Copies the state of the parts into the snapshot.
+	 *
+	 *	@param ShipParts: The parts to capture. Their order is kept.
+	 */
+	void Capture(const TArray<AShipPart*>& ShipParts);
+
+	/**
+	 *	Re-attaches the points of parts created from the snapshot in a single pass over Attachments, without any spatial search.
+	 *	Points are linked without firing the attach events, so anything tracking them should be built afterwards (ie. FShipAssemblyGraph::Build).
+	 *
+	 *	@param ShipParts: The parts created from the snapshot, in the same order as Parts. Parts that failed to spawn can be null.
+	 *	@return: The number of attachments that couldn't be restored because the part's points have changed since it was saved.
+	 */
+	int32 RestoreAttachments(const TArray<AShipPart*>& ShipParts) const;
+
+	/**
+	 *	Sets the saved properties on a part. Properties that no longer exist or aren't SaveGame flagged are skipped.
+	 *
+	 *	@param PartIndex: Index into Parts of the part's data.
+	 *	@param ShipPart: The part to apply the properties to. Must be of the part's template class.
+	 */
+	void ApplyProperties(int32 PartIndex, AShipPart* ShipPart) const;
+
+	/**
+	 *	Writes the snapshot in the compact format.
+	 *
+	 *	@param Quantization: How precisely to store the transforms.
+	 *	@param OutBytes: The encoded data.
+	 */
+	void Encode(const FShipSaveQuantization& Quantization, TArray<uint8>& OutBytes) const;
+
+	/**
+	 *	Reads a snapshot written by Encode. Transforms are only as precise as the quantization they were written with.
+	 *
+	 *	@param Bytes: The encoded data.
+	 *	@param FormatVersion: The ShipSaveFormat the data was written with.
+	 *	@return: True if the data was read successfully.
+	 */
+	bool Decode(const TArray<uint8>& Bytes, int32 FormatVersion = ShipSaveFormat::Latest);
+
+	void Reset();
+};
@@ -0,0 +1,173 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipRecords.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace ShipRecordsTests
+{
+	// Turns off the errors FShipSnapshot::Decode logs while checking it rejects bad data, as the automation framework fails tests that log errors.
+	struct FScopedSnapshotErrorsOff
+	{
+		FScopedSnapshotErrorsOff() { FSelfRegisteringExec::StaticExec(nullptr, TEXT("Log LogShipSnapshot Off"), *GLog); }
+		~FScopedSnapshotErrorsOff() { FSelfRegisteringExec::StaticExec(nullptr, TEXT("Log LogShipSnapshot Log"), *GLog); }
+	};
+
+	FShipPartSnapshot MakePart(int32 TemplateIndex, const FRotator& Rotation, const FVector& Location, const FVector& Scale = FVector(1.f))
+	{
+		FShipPartSnapshot Part;
+		Part.TemplateIndex = TemplateIndex;
+		Part.Transform = FTransform(Rotation, Location, Scale);
+		return Part;
+	}
+
+	// A ship covering each of the optional fields, with parts that move backwards along every axis.
+	FShipSnapshot MakeShip()
+	{
+		FShipSnapshot Snapshot;
+		Snapshot.Templates.Add(TEXT("/Game/Parts/Hull.Hull_C"));
+		Snapshot.Templates.Add(TEXT("/Game/Parts/Engine.Engine_C"));
+		Snapshot.PropertyNames.Add(TEXT("Health"));
+		Snapshot.PropertyNames.Add(TEXT("PaintColour"));
+
+		Snapshot.Parts.Add(MakePart(0, FRotator::ZeroRotator, FVector(100.f, 200.f, 50.f)));
+		Snapshot.Parts.Add(MakePart(1, FRotator(0.f, 90.f, 0.f), FVector(-350.5f, 12.25f, -80.f)));
+		Snapshot.Parts.Add(MakePart(0, FRotator(30.f, -45.f, 170.f), FVector(-351.f, -1000.01f, -80.f), FVector(2.f, 0.5f, 1.f)));
+		Snapshot.Parts.Add(MakePart(1, FRotator::ZeroRotator, FVector(0.f, 0.f, 0.f), FVector(-1.f, 1.f, 1.f)));
+
+		FShipPropertySnapshot& Health = Snapshot.Parts[1].Properties[Snapshot.Parts[1].Properties.AddDefaulted()];
+		Health.NameIndex = 0;
+		Health.Value = { 0, 0, 200, 66 };
+		FShipPropertySnapshot& Paint = Snapshot.Parts[3].Properties[Snapshot.Parts[3].Properties.AddDefaulted()];
+		Paint.NameIndex = 1;
+		Paint.Value = { 255, 0, 0, 255 };
+
+		Snapshot.Attachments.Add({ 0, 0, 1, 2 });
+		Snapshot.Attachments.Add({ 0, 3, 3, 0 });
+		Snapshot.Attachments.Add({ 1, 1, 2, 0 });
+		Snapshot.Attachments.Add({ 2, 4, 3, 1 });
+		return Snapshot;
+	}
+
+	bool IsSameAttachment(const FShipAttachmentSnapshot& A, const FShipAttachmentSnapshot& B)
+	{
+		return A.PartA == B.PartA && A.PointA == B.PointA && A.PartB == B.PartB && A.PointB == B.PointB;
+	}
+
+	// Encodes a snapshot that Decode should reject.
+	bool DecodesCorrupt(const FShipSnapshot& Snapshot)
+	{
+		TArray<uint8> Bytes;
+		Snapshot.Encode(FShipSaveQuantization(), Bytes);
+
+		FShipSnapshot Decoded;
+		return !Decoded.Decode(Bytes) && Decoded.Parts.Num() == 0;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FShipSnapshotRoundTripTest, "ShipBuilding.Serialization.SnapshotRoundTrip", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FShipSnapshotRoundTripTest::RunTest(const FString& Parameters)
+{
+	using namespace ShipRecordsTests;
+
+	const FShipSnapshot Snapshot = MakeShip();
+
+	FShipSaveQuantization Fine;
+	FShipSaveQuantization Coarse;
+	Coarse.PositionStep = 10.f;
+	Coarse.RotationBits = 6;
+
+	for (const FShipSaveQuantization& Quantization : { Fine, Coarse })
+	{
+		TArray<uint8> Bytes;
+		Snapshot.Encode(Quantization, Bytes);
+
+		FShipSnapshot Decoded;
+		if (!Decoded.Decode(Bytes) || Decoded.Parts.Num() != Snapshot.Parts.Num())
+		{
+			AddError(FString::Printf(TEXT("Failed to decode the ship with a position step of %g."), Quantization.PositionStep));
+			return false;
+		}
+
+		TestTrue(TEXT("Templates are kept"), Decoded.Templates == Snapshot.Templates);
+		TestTrue(TEXT("Property names are kept"), Decoded.PropertyNames == Snapshot.PropertyNames);
+
+		// Positions are rounded to the nearest step and each angle to the nearest of 2^RotationBits steps.
+		const float PositionTolerance = Quantization.PositionStep * 0.5f + KINDA_SMALL_NUMBER;
+		const float AngleTolerance = FMath::DegreesToRadians(360.f / (1 << Quantization.RotationBits)) * 2.f;
+		for (int32 PartIndex = 0; PartIndex < Snapshot.Parts.Num(); ++PartIndex)
+		{
+			const FShipPartSnapshot& Expected = Snapshot.Parts[PartIndex];
+			const FShipPartSnapshot& Actual = Decoded.Parts[PartIndex];
+			const FString Part = FString::Printf(TEXT("Part %d"), PartIndex);
+
+			TestEqual(Part + TEXT(" template"), Actual.TemplateIndex, Expected.TemplateIndex);
+			TestTrue(Part + TEXT(" location"), Actual.Transform.GetLocation().Equals(Expected.Transform.GetLocation(), PositionTolerance));
+			TestTrue(Part + TEXT(" scale"), Actual.Transform.GetScale3D().Equals(Expected.Transform.GetScale3D(), 0.f));
+
+			if (Expected.Transform.GetRotation().IsIdentity())
+			{
+				TestTrue(Part + TEXT(" rotation is identity"), Actual.Transform.GetRotation().IsIdentity());
+			}
+			else
+			{
+				TestTrue(Part + TEXT(" rotation"), Actual.Transform.GetRotation().AngularDistance(Expected.Transform.GetRotation()) <= AngleTolerance);
+			}
+
+			TestEqual(Part + TEXT(" property count"), Actual.Properties.Num(), Expected.Properties.Num());
+			if (Actual.Properties.Num() == Expected.Properties.Num())
+			{
+				for (int32 PropertyIndex = 0; PropertyIndex < Expected.Properties.Num(); ++PropertyIndex)
+				{
+					TestEqual(Part + TEXT(" property name"), Actual.Properties[PropertyIndex].NameIndex, Expected.Properties[PropertyIndex].NameIndex);
+					TestTrue(Part + TEXT(" property value"), Actual.Properties[PropertyIndex].Value == Expected.Properties[PropertyIndex].Value);
+				}
+			}
+		}
+
+		TestEqual(TEXT("Attachment count"), Decoded.Attachments.Num(), Snapshot.Attachments.Num());
+		if (Decoded.Attachments.Num() == Snapshot.Attachments.Num())
+		{
+			for (int32 AttachmentIndex = 0; AttachmentIndex < Snapshot.Attachments.Num(); ++AttachmentIndex)
+			{
+				TestTrue(FString::Printf(TEXT("Attachment %d"), AttachmentIndex), IsSameAttachment(Decoded.Attachments[AttachmentIndex], Snapshot.Attachments[AttachmentIndex]));
+			}
+		}
+	}
+
+	FScopedSnapshotErrorsOff ErrorsOff;
+
+	// Every byte is needed, so cutting the data anywhere should fail.
+	TArray<uint8> Bytes;
+	Snapshot.Encode(Fine, Bytes);
+	for (int32 Length = 0; Length < Bytes.Num(); ++Length)
+	{
+		TArray<uint8> Truncated(Bytes.GetData(), Length);
+		FShipSnapshot Decoded;
+		TestFalse(FString::Printf(TEXT("Decode of the first %d of %d bytes fails"), Length, Bytes.Num()), Decoded.Decode(Truncated));
+	}
+
+	// The quantization is the first thing read: a float position step followed by the number of rotation bits.
+	TArray<uint8> BadQuantization = Bytes;
+	BadQuantization[sizeof(float)] = 0;
+	FShipSnapshot Decoded;
+	TestFalse(TEXT("Decode with no rotation bits fails"), Decoded.Decode(BadQuantization));
+
+	FShipSnapshot BadTemplate = Snapshot;
+	BadTemplate.Parts[2].TemplateIndex = BadTemplate.Templates.Num();
+	TestTrue(TEXT("Decode of a part with an unknown template fails"), DecodesCorrupt(BadTemplate));
+
+	FShipSnapshot BadPropertyName = Snapshot;
+	BadPropertyName.Parts[1].Properties[0].NameIndex = BadPropertyName.PropertyNames.Num();
+	TestTrue(TEXT("Decode of a property with an unknown name fails"), DecodesCorrupt(BadPropertyName));
+
+	FShipSnapshot BadAttachment = Snapshot;
+	BadAttachment.Attachments.Last().PartB = BadAttachment.Parts.Num();
+	TestTrue(TEXT("Decode of an attachment to a missing part fails"), DecodesCorrupt(BadAttachment));
+
+	return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
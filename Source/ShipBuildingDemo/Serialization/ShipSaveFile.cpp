@@ -0,0 +1,175 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipSaveFile.h"
+#include "ShipBuilding/ShipPart.h"
+
+DECLARE_LOG_CATEGORY_CLASS(LogShipSaveFile, Log, All);
+
+const uint32 FShipSaveHeader::Magic = 0x53485053; // 'SHPS'
+const uint32 FShipSaveHeader::Version = 1;
+
+void FShipSaveHeader::Capture(const TArray<AShipPart*>& ShipParts)
+{
+	NumParts = ShipParts.Num();
+	NumAttachments = 0;
+	RootPartType = (ShipParts.Num() > 0) ? ShipParts[0]->GetPartType() : EPartType::PT_MAX;
+	SavedTime = FDateTime::UtcNow();
+
+	int32 NumAttachedPoints = 0;
+	for (const AShipPart* ShipPart : ShipParts)
+	{
+		if (ShipPart->GetPartType() == EPartType::PT_Cockpit)
+		{
+			RootPartType = EPartType::PT_Cockpit;
+		}
+
+		for (const FShipAttachPointData& AttachPoint : ShipPart->GetAttachPoints())
+		{
+			NumAttachedPoints += AttachPoint.IsAttached() ? 1 : 0;
+		}
+	}
+	NumAttachments = NumAttachedPoints / 2;
+}
+
+void FShipSaveHeader::Write(FArchive& Ar) const
+{
+	check(Ar.IsSaving());
+	const int64 Start = Ar.Tell();
+
+	uint32 FileMagic = Magic;
+	uint32 FileVersion = Version;
+	int32 Format = FormatVersion;
+	int32 Parts = NumParts;
+	int32 Attachments = NumAttachments;
+	uint8 RootType = (uint8)RootPartType;
+	int64 Ticks = SavedTime.GetTicks();
+	int32 PayloadBytes = PayloadSize;
+	uint32 Crc = PayloadCrc;
+	Ar << FileMagic << FileVersion << Format << Parts << Attachments << RootType << Ticks << PayloadBytes << Crc;
+
+	// Pad so fields can be added without moving the payload.
+	uint8 Padding[Size] = {};
+	const int64 NumPadding = Size - (Ar.Tell() - Start);
+	check(NumPadding >= 0);
+	Ar.Serialize(Padding, NumPadding);
+}
+
+bool FShipSaveHeader::Read(FArchive& Ar)
+{
+	check(Ar.IsLoading());
+	const int64 Start = Ar.Tell();
+
+	uint32 FileMagic = 0;
+	uint32 FileVersion = 0;
+	Ar << FileMagic;
+	if (FileMagic != Magic)
+	{
+		return false;
+	}
+
+	Ar << FileVersion;
+	if (FileVersion > Version)
+	{
+		UE_LOG(LogShipSaveFile, Warning, TEXT("Ship save header is from a newer version (%u)."), FileVersion);
+		return false;
+	}
+
+	uint8 RootType = 0;
+	int64 Ticks = 0;
+	Ar << FormatVersion << NumParts << NumAttachments << RootType << Ticks << PayloadSize << PayloadCrc;
+	RootPartType = (RootType <= (uint8)EPartType::PT_MAX) ? (EPartType)RootType : EPartType::PT_MAX;
+	SavedTime = FDateTime(Ticks);
+
+	Ar.Seek(Start + Size);
+	return !Ar.IsError();
+}
+
+FString ShipSaveFile::GetSlotFilename(const FString& SlotName)
+{
+	// Matches FGenericSaveGameSystem.
+	return FString::Printf(TEXT("%sSaveGames/%s.sav"), *FPaths::GameSavedDir(), *SlotName);
+}
+
+bool ShipSaveFile::Write(const FString& SlotName, FShipSaveHeader& Header, const TArray<uint8>& SaveGameBytes)
+{
+	const FString Filename = GetSlotFilename(SlotName);
+	const FString TempFilename = Filename + TEXT(".tmp");
+
+	Header.PayloadSize = SaveGameBytes.Num();
+	Header.PayloadCrc = FCrc::MemCrc32(SaveGameBytes.GetData(), SaveGameBytes.Num());
+
+	// Only replace the existing save once the new one is completely written.
+	bool bSuccess = false;
+	if (FArchive* Writer = IFileManager::Get().CreateFileWriter(*TempFilename))
+	{
+		Header.Write(*Writer);
+		Writer->Serialize(const_cast<uint8*>(SaveGameBytes.GetData()), SaveGameBytes.Num());
+		bSuccess = Writer->Close();
+		delete Writer;
+	}
+
+	if (bSuccess)
+	{
+		bSuccess = IFileManager::Get().Move(*Filename, *TempFilename, true, true);
+	}
+	else
+	{
+		IFileManager::Get().Delete(*TempFilename, false, false, true);
+	}
+
+	if (bSuccess)
+	{
+		INC_DWORD_STAT_BY(STAT_ShipSaveBytesWritten, FShipSaveHeader::Size + SaveGameBytes.Num());
+	}
+	UE_CLOG(!bSuccess, LogShipSaveFile, Error, TEXT("Failed to write %s"), *Filename);
+	return bSuccess;
+}
+
+bool ShipSaveFile::Save(const FString& SlotName, FShipSaveHeader& Header, USaveGame* SaveGame)
+{
+	check(IsInGameThread());
+
+	TArray<uint8> SaveGameBytes;
+	return UGameplayStatics::SaveGameToMemory(SaveGame, SaveGameBytes) && Write(SlotName, Header, SaveGameBytes);
+}
+
+USaveGame* ShipSaveFile::Load(const FString& SlotName)
+{
+	check(IsInGameThread());
+
+	TArray<uint8> FileBytes;
+	if (!FFileHelper::LoadFileToArray(FileBytes, *GetSlotFilename(SlotName), FILEREAD_Silent))
+	{
+		return nullptr;
+	}
+	INC_DWORD_STAT_BY(STAT_ShipLoadBytesRead, FileBytes.Num());
+
+	FMemoryReader Reader{ FileBytes, true };
+	FShipSaveHeader Header;
+	if (FileBytes.Num() < FShipSaveHeader::Size || !Header.Read(Reader))
+	{
+		// Saved before ships had a header.
+		return UGameplayStatics::LoadGameFromMemory(FileBytes);
+	}
+
+	if (Header.PayloadSize != FileBytes.Num() - FShipSaveHeader::Size || Header.PayloadCrc != FCrc::MemCrc32(FileBytes.GetData() + FShipSaveHeader::Size, Header.PayloadSize))
+	{
+		UE_LOG(LogShipSaveFile, Error, TEXT("Save for %s is corrupt."), *SlotName);
+		return nullptr;
+	}
+
+	// Drop the header rather than copying the rest into another array.
+	FileBytes.RemoveAt(0, FShipSaveHeader::Size, false);
+	return UGameplayStatics::LoadGameFromMemory(FileBytes);
+}
+
+bool ShipSaveFile::ReadHeader(const FString& Filename, FShipSaveHeader& OutHeader)
+{
+	TUniquePtr<FArchive> Reader{ IFileManager::Get().CreateFileReader(*Filename, FILEREAD_Silent) };
+	if (!Reader.IsValid() || Reader->TotalSize() < FShipSaveHeader::Size)
+	{
+		return false;
+	}
+	return OutHeader.Read(*Reader);
+}
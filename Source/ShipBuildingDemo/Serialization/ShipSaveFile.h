@@ -0,0 +1,114 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ShipBuilding/ShipBuildingTypes.h"
+
+class AShipPart;
+class USaveGame;
+
+/**
+ *	Fixed layout header at the front of every ship save, followed by the serialized UShipSaveGame.
+ *	Lets the ship library be listed by reading a few bytes of each save rather than loading the whole thing.
+ */
+struct SHIPBUILDINGDEMO_API FShipSaveHeader
+{
+	// Bytes the header takes up at the front of the file, including padding for fields added later.
+	static const int32 Size = 64;
+
+	// The ShipSaveFormat of the ship data.
+	int32 FormatVersion = 0;
+
+	int32 NumParts = 0;
+
+	// Number of attached pairs of points.
+	int32 NumAttachments = 0;
+
+	// Type of the part the ship is built around. The cockpit if there is one, otherwise the first part.
+	EPartType RootPartType = EPartType::PT_MAX;
+
+	// When the ship was saved, in UTC.
+	FDateTime SavedTime;
+
+	// Size and CRC of the serialized save game following the header.
+	int32 PayloadSize = 0;
+	uint32 PayloadCrc = 0;
+
+	/**
+	 *	Fills in the ship details from the parts being saved.
+	 *
+	 *	@param ShipParts: The parts being saved.
+	 */
+	void Capture(const TArray<AShipPart*>& ShipParts);
+
+	/**
+	 *	Writes the header, padded to Size.
+	 *
+	 *	@param Ar: The archive to write to.
+	 */
+	void Write(FArchive& Ar) const;
+
+	/**
+	 *	Reads the header.
+	 *
+	 *	@param Ar: The archive to read from. Should have at least Size bytes left.
+	 *	@return: False if it isn't a ship save header (ie. a save from before they had one) or it's from a newer version.
+	 */
+	bool Read(FArchive& Ar);
+
+private:
+	static const uint32 Magic;
+	static const uint32 Version;
+};
+
+/**
+ *	Reading and writing ship save files. Files are written to the same place as the generic save game system, so the slots work with DoesSaveGameExist,
+ *	but should only be used on platforms using the generic save game system.
+ */
+namespace ShipSaveFile
+{
+	/**
+	 *	Gets the file the generic save game system uses for a slot.
+	 *
+	 *	@param SlotName: The name of the slot.
+	 *	@return: The full path of the slot's file.
+	 */
+	SHIPBUILDINGDEMO_API FString GetSlotFilename(const FString& SlotName);
+
+	/**
+	 *	Writes a save to a temp file then moves it over the slot, so a failed write never leaves a partially written save. Safe to call from any thread.
+	 *
+	 *	@param SlotName: The name of the slot.
+	 *	@param Header: The header to write. Its payload size and CRC are filled in.
+	 *	@param SaveGameBytes: The save game from UGameplayStatics::SaveGameToMemory.
+	 *	@return: True if the save was written.
+	 */
+	SHIPBUILDINGDEMO_API bool Write(const FString& SlotName, FShipSaveHeader& Header, const TArray<uint8>& SaveGameBytes);
+
+	/**
+	 *	Serializes a save game and writes it with a header. Must be called on the game thread.
+	 *
+	 *	@param SlotName: The name of the slot.
+	 *	@param Header: The header to write.
+	 *	@param SaveGame: The save game to write.
+	 *	@return: True if the save was written.
+	 */
+	SHIPBUILDINGDEMO_API bool Save(const FString& SlotName, FShipSaveHeader& Header, USaveGame* SaveGame);
+
+	/**
+	 *	Loads the save game from a slot. Handles saves from before they had a header. Must be called on the game thread.
+	 *
+	 *	@param SlotName: The name of the slot.
+	 *	@return: The save game or nullptr if it couldn't be loaded.
+	 */
+	SHIPBUILDINGDEMO_API USaveGame* Load(const FString& SlotName);
+
+	/**
+	 *	Reads just the header of a save file. Safe to call from any thread.
+	 *
+	 *	@param Filename: The full path of the save file.
+	 *	@param OutHeader: The header.
+	 *	@return: True if the file has a header.
+	 */
+	SHIPBUILDINGDEMO_API bool ReadHeader(const FString& Filename, FShipSaveHeader& OutHeader);
+}
@@ -3,6 +3,7 @@
 #include "ShipBuildingDemo.h"
 #include "ShipSaveGame.h"
 #include "ShipBuilding/ShipPart.h"
+#include "ShipBuilding/ShipPartPool.h"
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -15,10 +16,97 @@ FShipSaveGameArchiveProxy::FShipSaveGameArchiveProxy(FArchive& innerArchive)
 
 //////////////////////////////////////////////////////////////////////////
 
-bool UShipSaveGame::SaveShip(const FString& NameOfShip, const TArray<AShipPart*>& ShipParts)
+UShipSaveGame::UShipSaveGame()
+: FormatVersion(ShipSaveFormat::Legacy)
+, UncompressedSize(0)
+{
+}
+
+bool UShipSaveGame::SaveShip(const FString& NameOfShip, const TArray<AShipPart*>& ShipParts, const FShipSaveQuantization& Quantization /*= FShipSaveQuantization()*/)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShipSaveShip);
+	FShipSnapshot Snapshot;
+	Snapshot.Capture(ShipParts);
+
+	TArray<uint8> ShipData;
+	int32 ShipDataUncompressedSize = 0;
+	EncodeShipData(Snapshot, Quantization, ShipData, ShipDataUncompressedSize);
+	SetShipData(NameOfShip, MoveTemp(ShipData), ShipDataUncompressedSize);
+
+	UE_LOG(LogTemp, Log, TEXT("Saved %d parts using %d templates in %d bytes"), Snapshot.Parts.Num(), Snapshot.Templates.Num(), CompactShipData.Num());
+	return true;
+}
+
+void UShipSaveGame::EncodeShipData(const FShipSnapshot& Snapshot, const FShipSaveQuantization& Quantization, TArray<uint8>& OutShipData, int32& OutUncompressedSize)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShipEncodeShipData);
+	TArray<uint8> Encoded;
+	Snapshot.Encode(Quantization, Encoded);
+
+	// Only keep the compressed version if it's actually smaller.
+	int32 CompressedSize = FCompression::CompressMemoryBound(COMPRESS_ZLIB, Encoded.Num());
+	OutShipData.SetNumUninitialized(CompressedSize);
+	if (FCompression::CompressMemory(COMPRESS_ZLIB, OutShipData.GetData(), CompressedSize, Encoded.GetData(), Encoded.Num()) && CompressedSize < Encoded.Num())
+	{
+		OutShipData.SetNum(CompressedSize);
+		OutUncompressedSize = Encoded.Num();
+	}
+	else
+	{
+		OutShipData = MoveTemp(Encoded);
+		OutUncompressedSize = 0;
+	}
+	INC_DWORD_STAT_BY(STAT_ShipDataBytesEncoded, OutShipData.Num());
+}
+
+void UShipSaveGame::SetShipData(const FString& NameOfShip, TArray<uint8>&& ShipData, int32 InUncompressedSize)
+{
+	ShipName = NameOfShip;
+
+	// Drop any legacy data that was loaded along with this object.
+	ShipPartRecords.Empty();
+
+	CompactShipData = MoveTemp(ShipData);
+	UncompressedSize = InUncompressedSize;
+	FormatVersion = ShipSaveFormat::Latest;
+}
+
+bool UShipSaveGame::DecodeShipData(FShipSnapshot& OutSnapshot) const
+{
+	return DecodeShipData(CompactShipData, UncompressedSize, FormatVersion, OutSnapshot);
+}
+
+bool UShipSaveGame::DecodeShipData(const TArray<uint8>& ShipData, int32 InUncompressedSize, int32 InFormatVersion, FShipSnapshot& OutSnapshot)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShipDecodeShipData);
+	INC_DWORD_STAT_BY(STAT_ShipDataBytesDecoded, ShipData.Num());
+
+	if (InFormatVersion < ShipSaveFormat::Compressed || InUncompressedSize == 0)
+	{
+		return OutSnapshot.Decode(ShipData, InFormatVersion);
+	}
+
+	if (InUncompressedSize < 0)
+	{
+		return false;
+	}
+
+	TArray<uint8> Uncompressed;
+	Uncompressed.SetNumUninitialized(InUncompressedSize);
+	if (!FCompression::UncompressMemory(COMPRESS_ZLIB, Uncompressed.GetData(), Uncompressed.Num(), ShipData.GetData(), ShipData.Num()))
+	{
+		return false;
+	}
+	return OutSnapshot.Decode(Uncompressed, InFormatVersion);
+}
+
+bool UShipSaveGame::SaveShipLegacy(const FString& NameOfShip, const TArray<AShipPart*>& ShipParts)
 {
 	// Clear any existing records but retain memory for the number of parts we'll be adding records for.
 	ShipPartRecords.Empty(ShipParts.Num());
+	CompactShipData.Empty();
+	UncompressedSize = 0;
+	FormatVersion = ShipSaveFormat::Legacy;
 
 	ShipName = NameOfShip;
 
@@ -40,11 +128,35 @@ bool UShipSaveGame::SaveShip(const FString& NameOfShip, const TArray<AShipPart*>
 	return true;
 }
 
-bool UShipSaveGame::LoadShip(UObject* WorldContext, TArray<AShipPart*>& OutShipParts) const
+bool UShipSaveGame::LoadShip(UObject* WorldContext, TArray<AShipPart*>& OutShipParts, UShipPartPool* ShipPartPool /*= nullptr*/) const
 {
+	SCOPE_CYCLE_COUNTER(STAT_ShipLoadShip);
 	UWorld* WorldRef = GEngine->GetWorldFromContextObject(WorldContext);
 	check(WorldRef);
 
+	// This should be empty. TODO: be more explicit here when not tired.
+	if (OutShipParts.Num() > 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("OutShipParts already contains data; there are likely undestroyed ship parts."));
+		OutShipParts.Empty();
+	}
+
+	switch (FormatVersion)
+	{
+	case ShipSaveFormat::Legacy:
+		return LoadShipLegacy(WorldRef, OutShipParts, ShipPartPool);
+	case ShipSaveFormat::Compact:
+	case ShipSaveFormat::Attachments:
+	case ShipSaveFormat::Compressed:
+		return LoadShipCompact(WorldRef, OutShipParts, ShipPartPool);
+	default:
+		UE_LOG(LogTemp, Error, TEXT("Save data for %s is from a newer version (%d)"), *ShipName, FormatVersion);
+		return false;
+	}
+}
+
+bool UShipSaveGame::LoadShipLegacy(UWorld* World, TArray<AShipPart*>& OutShipParts, UShipPartPool* ShipPartPool) const
+{
 	// TODO: should we allow saving no parts?
 	if (ShipPartRecords.Num() == 0)
 	{
@@ -52,38 +164,217 @@ bool UShipSaveGame::LoadShip(UObject* WorldContext, TArray<AShipPart*>& OutShipP
 		return true;
 	}
 
-	// This should be empty. TODO: be more explicit here when not tired.
-	if (OutShipParts.Num() > 0)
-	{
-		UE_LOG(LogTemp, Warning, TEXT("OutShipParts already contains data; there are likely undestroyed ship parts."));
-		OutShipParts.Empty(ShipPartRecords.Num());
-	}
-
 	// Create the ship part instances from the records and store in OutShipParts.
+	OutShipParts.Reserve(ShipPartRecords.Num());
 	for (const FShipPartRecord& Record : ShipPartRecords)
 	{
-		UClass* ShipTemplate = FindObject<UClass>(ANY_PACKAGE, *Record.ShipTemplateName);
-		if (!ShipTemplate)
+		UClass* ShipTemplate = ResolveShipTemplate(Record.ShipTemplateName);
+
+		AShipPart* ShipPart = SpawnShipPart(World, ShipTemplate, Record.PartTransform, ShipPartPool, [&Record](AShipPart* NewShipPart)
 		{
-			ShipTemplate = LoadObject<UClass>(NULL, *Record.ShipTemplateName);
-		}
+			FMemoryReader MemoryReader{ Record.ShipPartData, true };
+			FShipSaveGameArchiveProxy Archive{ MemoryReader };
+			NewShipPart->Serialize(Archive);
+		});
 
-		auto ShipPart = Cast<AShipPart>(UGameplayStatics::BeginDeferredActorSpawnFromClass(WorldRef, ShipTemplate, Record.PartTransform));
-		if (!ShipPart) 
+		if (!ShipPart)
 		{
-			UE_LOG(LogTemp, Error, TEXT("Failed to create ship part: %s"), ShipTemplate);
+			UE_LOG(LogTemp, Error, TEXT("Failed to create ship part: %s"), *Record.ShipTemplateName);
 			return false;
 		}
+		OutShipParts.Add(ShipPart);
+	}
 
-		FMemoryReader MemoryReader{ Record.ShipPartData, true };
-		FShipSaveGameArchiveProxy Archive{ MemoryReader };
+	return true;
+}
 
-		ShipPart->Serialize(Archive);
+bool UShipSaveGame::LoadShipCompact(UWorld* World, TArray<AShipPart*>& OutShipParts, UShipPartPool* ShipPartPool) const
+{
+	FShipSnapshot Snapshot;
+	if (!DecodeShipData(Snapshot))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to decode ship data for %s"), *ShipName);
+		return false;
+	}
 
-		ShipPart = Cast<AShipPart>(UGameplayStatics::FinishSpawningActor(ShipPart, Record.PartTransform));
-		check(ShipPart);
-		OutShipParts.Add(MoveTemp(ShipPart));
+	if (Snapshot.Parts.Num() == 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("No ship records to load for %s"), *ShipName);
+		return true;
 	}
 
+	if (!SpawnSnapshot(World, Snapshot, OutShipParts, ShipPartPool))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to create some of the parts for %s"), *ShipName);
+		return false;
+	}
 	return true;
-}
\ No newline at end of file
+}
+
+bool UShipSaveGame::SpawnSnapshot(UWorld* World, const FShipSnapshot& Snapshot, TArray<AShipPart*>& OutShipParts, UShipPartPool* ShipPartPool /*= nullptr*/, ShipLoadStaging::Type Staging /*= ShipLoadStaging::Parallel*/)
+{
+	// Parts by their index in the snapshot, null if they failed to spawn.
+	TArray<AShipPart*> SpawnedParts;
+	SpawnedParts.Reserve(Snapshot.Parts.Num());
+
+	if (Staging == ShipLoadStaging::None)
+	{
+		// Each template only needs to be looked up once rather than once per part.
+		TArray<UClass*> TemplateClasses;
+		TemplateClasses.Reserve(Snapshot.Templates.Num());
+		for (const FString& Template : Snapshot.Templates)
+		{
+			TemplateClasses.Add(ResolveShipTemplate(Template));
+		}
+
+		for (int32 PartIndex = 0; PartIndex < Snapshot.Parts.Num(); ++PartIndex)
+		{
+			const FShipPartSnapshot& Part = Snapshot.Parts[PartIndex];
+			SpawnedParts.Add(SpawnShipPart(World, TemplateClasses[Part.TemplateIndex], Part.Transform, ShipPartPool, [&Snapshot, PartIndex](AShipPart* NewShipPart)
+			{
+				Snapshot.ApplyProperties(PartIndex, NewShipPart);
+			}));
+		}
+	}
+	else
+	{
+		FShipStagedParts StagedParts;
+		StagedParts.Stage(Snapshot, Staging == ShipLoadStaging::Parallel);
+		for (int32 PartIndex = 0; PartIndex < StagedParts.Num(); ++PartIndex)
+		{
+			SpawnedParts.Add(StagedParts.SpawnPart(PartIndex, World, ShipPartPool));
+		}
+	}
+
+	const int32 NumFailed = Snapshot.RestoreAttachments(SpawnedParts);
+	UE_CLOG(NumFailed > 0, LogTemp, Warning, TEXT("%d of %d attachments couldn't be restored"), NumFailed, Snapshot.Attachments.Num());
+
+	bool bSuccess = true;
+	OutShipParts.Reserve(OutShipParts.Num() + SpawnedParts.Num());
+	for (int32 PartIndex = 0; PartIndex < SpawnedParts.Num(); ++PartIndex)
+	{
+		if (SpawnedParts[PartIndex])
+		{
+			OutShipParts.Add(SpawnedParts[PartIndex]);
+		}
+		else
+		{
+			UE_LOG(LogTemp, Error, TEXT("Failed to create ship part: %s"), *Snapshot.Templates[Snapshot.Parts[PartIndex].TemplateIndex]);
+			bSuccess = false;
+		}
+	}
+	return bSuccess;
+}
+
+UClass* UShipSaveGame::ResolveShipTemplate(const FString& TemplatePath)
+{
+	UClass* ShipTemplate = FindObject<UClass>(ANY_PACKAGE, *TemplatePath);
+	if (!ShipTemplate)
+	{
+		ShipTemplate = LoadObject<UClass>(NULL, *TemplatePath);
+	}
+	return ShipTemplate;
+}
+
+AShipPart* UShipSaveGame::SpawnShipPart(UWorld* World, UClass* ShipTemplate, const FTransform& Transform, UShipPartPool* ShipPartPool, TFunctionRef<void(AShipPart*)> ApplySavedData)
+{
+	if (!ShipTemplate)
+	{
+		return nullptr;
+	}
+
+	// Reuse a pooled part if there is one. It's already been spawned so it only needs the saved data applied.
+	if (AShipPart* PooledShipPart = ShipPartPool ? ShipPartPool->Acquire(ShipTemplate, Transform) : nullptr)
+	{
+		ApplySavedData(PooledShipPart);
+		return PooledShipPart;
+	}
+
+	auto ShipPart = Cast<AShipPart>(UGameplayStatics::BeginDeferredActorSpawnFromClass(World, ShipTemplate, Transform));
+	if (!ShipPart)
+	{
+		return nullptr;
+	}
+
+	ApplySavedData(ShipPart);
+
+	ShipPart = Cast<AShipPart>(UGameplayStatics::FinishSpawningActor(ShipPart, Transform));
+	check(ShipPart);
+	return ShipPart;
+}
+
+bool UShipSaveGame::ValidateCompactRoundTrip(const TArray<AShipPart*>& ShipParts, const FShipSaveQuantization& Quantization, float* OutSizeRatio /*= nullptr*/)
+{
+	UShipSaveGame* LegacySave = NewObject<UShipSaveGame>();
+	UShipSaveGame* CompactSave = NewObject<UShipSaveGame>();
+	LegacySave->SaveShipLegacy(TEXT("RoundTrip"), ShipParts);
+	CompactSave->SaveShip(TEXT("RoundTrip"), ShipParts, Quantization);
+
+	FShipSnapshot Snapshot;
+	if (!CompactSave->DecodeShipData(Snapshot) || Snapshot.Parts.Num() != LegacySave->ShipPartRecords.Num())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Compact ship data failed to decode to the same number of parts"));
+		return false;
+	}
+
+	// Allow for the rounding done by the quantization.
+	const float PositionTolerance = Quantization.PositionStep * 0.5f + KINDA_SMALL_NUMBER;
+	const float RotationTolerance = 360.f / (1 << FMath::Clamp(Quantization.RotationBits, 1, 16)) + KINDA_SMALL_NUMBER;
+
+	bool bMatches = true;
+	for (int32 i = 0; i < Snapshot.Parts.Num(); ++i)
+	{
+		const FShipPartRecord& Record = LegacySave->ShipPartRecords[i];
+		const FShipPartSnapshot& Part = Snapshot.Parts[i];
+		const bool bSameTemplate = (Snapshot.Templates[Part.TemplateIndex] == Record.ShipTemplateName);
+		const bool bSamePosition = Part.Transform.GetLocation().Equals(Record.PartTransform.GetLocation(), PositionTolerance);
+		const bool bSameRotation = Part.Transform.Rotator().Equals(Record.PartTransform.Rotator(), RotationTolerance);
+		const bool bSameScale = Part.Transform.GetScale3D().Equals(Record.PartTransform.GetScale3D());
+		if (!bSameTemplate || !bSamePosition || !bSameRotation || !bSameScale)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Compact ship data doesn't match for part %d (template: %d, position: %d, rotation: %d, scale: %d)"),
+				i, bSameTemplate, bSamePosition, bSameRotation, bSameScale);
+			bMatches = false;
+		}
+	}
+
+	// Every decoded attachment should be between points that are attached, and there should be one per attached pair.
+	const TSet<AShipPart*> SavedParts{ ShipParts };
+	int32 NumAttachedPoints = 0;
+	for (const AShipPart* ShipPart : ShipParts)
+	{
+		for (const FShipAttachPointData& AttachPoint : ShipPart->GetAttachPoints())
+		{
+			NumAttachedPoints += (AttachPoint.IsAttached() && SavedParts.Contains(AttachPoint.AttachedToPart)) ? 1 : 0;
+		}
+	}
+	for (const FShipAttachmentSnapshot& Attachment : Snapshot.Attachments)
+	{
+		const FShipAttachPointRef PointA(ShipParts[Attachment.PartA], Attachment.PointA);
+		const FShipAttachPointRef PointB(ShipParts[Attachment.PartB], Attachment.PointB);
+		if (!PointA.ShipPart->GetAttachPoints().IsValidIndex(PointA.Index) || !PointB.ShipPart->GetAttachPoints().IsValidIndex(PointB.Index) || !PointA.IsAttachedToPoint(PointB))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Compact ship data has an attachment that doesn't exist between parts %d and %d"), Attachment.PartA, Attachment.PartB);
+			bMatches = false;
+		}
+	}
+	if (Snapshot.Attachments.Num() * 2 != NumAttachedPoints)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Compact ship data has %d attachments but the ship has %d"), Snapshot.Attachments.Num(), NumAttachedPoints / 2);
+		bMatches = false;
+	}
+
+	// Measure what each format would actually write to the slot.
+	TArray<uint8> LegacyBytes;
+	TArray<uint8> CompactBytes;
+	UGameplayStatics::SaveGameToMemory(LegacySave, LegacyBytes);
+	UGameplayStatics::SaveGameToMemory(CompactSave, CompactBytes);
+	const float SizeRatio = CompactBytes.Num() > 0 ? (float)LegacyBytes.Num() / CompactBytes.Num() : 0.f;
+	UE_LOG(LogTemp, Log, TEXT("Ship save round trip %s. Legacy: %d bytes, compact: %d bytes (%.1fx smaller)"),
+		bMatches ? TEXT("passed") : TEXT("failed"), LegacyBytes.Num(), CompactBytes.Num(), SizeRatio);
+	if (OutSizeRatio)
+	{
+		*OutSizeRatio = SizeRatio;
+	}
+	return bMatches;
+}
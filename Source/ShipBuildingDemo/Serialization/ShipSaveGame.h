@@ -5,8 +5,10 @@
 #include "GameFramework/SaveGame.h"
 #include "ArchiveUObject.h"
 #include "ShipRecords.h"
+#include "ShipStagedParts.h"
 #include "ShipSaveGame.generated.h"
 
+class AShipPart;
 
 struct FShipSaveGameArchiveProxy : public FObjectAndNameAsStringProxyArchive 
 {
@@ -26,28 +28,142 @@ class SHIPBUILDINGDEMO_API UShipSaveGame : public USaveGame
 	UPROPERTY()
 	FString ShipName;
 
-	// The parts that make up the ship.
+	// Which of the ShipSaveFormat versions the ship data is stored in. Saves from before it existed load as Legacy.
+	UPROPERTY()
+	int32 FormatVersion;
+
+	// The parts that make up the ship. Only used by the legacy format.
 	UPROPERTY()
 	TArray<FShipPartRecord> ShipPartRecords;
+
+	// FShipSnapshot of the ship in the compact format.
+	UPROPERTY()
+	TArray<uint8> CompactShipData;
+
+	// Size of CompactShipData before it was compressed. 0 if it's stored uncompressed.
+	UPROPERTY()
+	int32 UncompressedSize;
 	
 public:
+	UShipSaveGame();
+
+	/**
+	 * Populates this save object with the data for a ship in preparation for saving (ie. converting the AShipParts to the compact format).
+	 *
+	 * @param NameOfShip: The name of the ship being saved.
+	 * @param InShipParts: The parts that make up this ship.
+	 * @param Quantization: How precisely to store the part transforms.
+	 * @return: True if it saved successfully.
+	 */
+	bool SaveShip(const FString& NameOfShip, const TArray<class AShipPart*>& InShipParts, const FShipSaveQuantization& Quantization = FShipSaveQuantization());
+
 	/**
-	 * Populates this save object with the data for a ship in preparation for saving (ie. converting the AShipParts to FShipPartRecords).
+	 * Populates this save object in the legacy format of one FShipPartRecord per part.
 	 *
 	 * @param NameOfShip: The name of the ship being saved.
 	 * @param InShipParts: The parts that make up this ship.
 	 * @return: True if it saved successfully.
 	 */
-	bool SaveShip(const FString& NameOfShip, const TArray<class AShipPart*>& InShipParts);
+	bool SaveShipLegacy(const FString& NameOfShip, const TArray<class AShipPart*>& InShipParts);
+
+	/**
+	 * Encodes and compresses a snapshot into the data stored by SetShipData. Doesn't touch any UObjects so is safe to call from any thread.
+	 *
+	 * @param Snapshot: The ship to encode.
+	 * @param Quantization: How precisely to store the part transforms.
+	 * @param OutShipData: The encoded data.
+	 * @param OutUncompressedSize: The size of the data before compression, or 0 if it wasn't compressed.
+	 */
+	static void EncodeShipData(const FShipSnapshot& Snapshot, const FShipSaveQuantization& Quantization, TArray<uint8>& OutShipData, int32& OutUncompressedSize);
+
+	/**
+	 * Populates this save object with data from EncodeShipData.
+	 *
+	 * @param NameOfShip: The name of the ship being saved.
+	 * @param ShipData: The encoded data. Moved into the save object.
+	 * @param InUncompressedSize: The uncompressed size from EncodeShipData.
+	 */
+	void SetShipData(const FString& NameOfShip, TArray<uint8>&& ShipData, int32 InUncompressedSize);
 
 	/**
 	 * Exports saved ship data this object contains to AShipParts that can be used within the game world.
 	 *
 	 * @param WorldContext: An object that has a valid reference to the world.
 	 * @param OutShipParts: The array the created ship parts should be stored in.
+	 * @param ShipPartPool: Optional pool to take parts from before spawning new ones.
 	 * @return: True if loaded successfully.
 	 */
-	bool LoadShip(UObject* WorldContext, TArray<class AShipPart*>& OutShipParts) const;
+	bool LoadShip(UObject* WorldContext, TArray<class AShipPart*>& OutShipParts, class UShipPartPool* ShipPartPool = nullptr) const;
+
+	/**
+	 * Saves the parts in both the legacy and compact formats and checks that the compact data decodes to the same ship.
+	 * Used for debugging changes to the compact format.
+	 *
+	 * @param InShipParts: The parts to save.
+	 * @param Quantization: How precisely to store the part transforms.
+	 * @param OutSizeRatio: Optionally set to how many times smaller the compact save is than the legacy one, as written by SaveGameToMemory.
+	 * @return: True if the compact data matches the legacy records within the quantization error.
+	 */
+	static bool ValidateCompactRoundTrip(const TArray<class AShipPart*>& InShipParts, const FShipSaveQuantization& Quantization, float* OutSizeRatio = nullptr);
+
+	/**
+	 * Decompresses and decodes the ship data. Only available for saves in the compact format.
+	 *
+	 * @param OutSnapshot: The decoded ship.
+	 * @return: True if the data was decoded successfully.
+	 */
+	bool DecodeShipData(FShipSnapshot& OutSnapshot) const;
+
+	/**
+	 * Decompresses and decodes data from EncodeShipData. Doesn't touch any UObjects so is safe to call from any thread.
+	 *
+	 * @param ShipData: The encoded data.
+	 * @param InUncompressedSize: The uncompressed size from EncodeShipData.
+	 * @param InFormatVersion: The ShipSaveFormat the data was written with.
+	 * @param OutSnapshot: The decoded ship.
+	 * @return: True if the data was decoded successfully.
+	 */
+	static bool DecodeShipData(const TArray<uint8>& ShipData, int32 InUncompressedSize, int32 InFormatVersion, FShipSnapshot& OutSnapshot);
+
+	/**
+	 * Spawns a part or takes one from the pool.
+	 *
+	 * @param World: The world to spawn the part in.
+	 * @param ShipTemplate: The class of part.
+	 * @param Transform: Where to put the part.
+	 * @param ShipPartPool: Optional pool to take the part from.
+	 * @param ApplySavedData: Called to restore the saved data before the part finishes spawning.
+	 * @return: The part or nullptr if it failed to spawn.
+	 */
+	static AShipPart* SpawnShipPart(UWorld* World, UClass* ShipTemplate, const FTransform& Transform, class UShipPartPool* ShipPartPool, TFunctionRef<void(AShipPart*)> ApplySavedData);
+
+	/**
+	 * Spawns the parts of a decoded ship and restores their attachments.
+	 *
+	 * @param World: The world to spawn the parts in.
+	 * @param Snapshot: The decoded ship.
+	 * @param OutShipParts: The parts that were spawned, in saved order. Appended to.
+	 * @param ShipPartPool: Optional pool to take parts from before spawning new ones.
+	 * @param Staging: How to prepare the parts before spawning them. Anything but parallel is only useful for benchmarking.
+	 * @return: True if every part was spawned.
+	 */
+	static bool SpawnSnapshot(UWorld* World, const FShipSnapshot& Snapshot, TArray<class AShipPart*>& OutShipParts, class UShipPartPool* ShipPartPool = nullptr, ShipLoadStaging::Type Staging = ShipLoadStaging::Parallel);
+
+	/**
+	 * Finds or loads a part class from its path name.
+	 *
+	 * @param TemplatePath: Path name of the class.
+	 * @return: The class or nullptr if it couldn't be found.
+	 */
+	static UClass* ResolveShipTemplate(const FString& TemplatePath);
 
+	FORCEINLINE bool IsCompactFormat() const noexcept { return FormatVersion >= ShipSaveFormat::Compact; }
 	FORCEINLINE const FString& GetShipName() const noexcept { return ShipName; }
+	FORCEINLINE int32 GetFormatVersion() const noexcept { return FormatVersion; }
+	FORCEINLINE int32 GetShipDataSize() const noexcept { return CompactShipData.Num(); }
+
+private:
+	// LoadShip for each format.
+	bool LoadShipLegacy(UWorld* World, TArray<class AShipPart*>& OutShipParts, class UShipPartPool* ShipPartPool) const;
+	bool LoadShipCompact(UWorld* World, TArray<class AShipPart*>& OutShipParts, class UShipPartPool* ShipPartPool) const;
 };
@@ -0,0 +1,158 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipSaveGame.h"
+#include "ShipSaveTestPart.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace ShipSaveGameTests
+{
+	// A transient game world for spawning parts in, torn down when it goes out of scope.
+	struct FScopedTestWorld
+	{
+		UWorld* World;
+
+		FScopedTestWorld()
+		{
+			World = UWorld::CreateWorld(EWorldType::Game, false);
+			FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+			WorldContext.SetCurrentWorld(World);
+			World->InitializeActorsForPlay(FURL());
+			World->GetWorldSettings()->NotifyBeginPlay();
+		}
+
+		~FScopedTestWorld()
+		{
+			GEngine->DestroyWorldContext(World);
+			World->DestroyWorld(false);
+		}
+	};
+
+	/**
+	 *	Builds a chain of parts, each attached to the next, with rotations, scales and saved properties that vary from part to part.
+	 *	Long enough that the size of the save is mostly the parts rather than the save game's own header.
+	 */
+	TArray<AShipPart*> MakeShip(UWorld* World, int32 NumParts)
+	{
+		TArray<AShipPart*> ShipParts;
+		for (int32 PartIndex = 0; PartIndex < NumParts; ++PartIndex)
+		{
+			const FRotator Rotation{ 0.f, (PartIndex % 4) * 90.f, (PartIndex % 3 == 0) ? 45.f : 0.f };
+			const FVector Location{ PartIndex * AShipSaveTestPart::Length, -25.f * (PartIndex % 5), 10.f };
+			const FVector Scale = (PartIndex % 7 == 0) ? FVector(2.f, 1.f, 0.5f) : FVector(1.f);
+
+			AShipSaveTestPart* ShipPart = World->SpawnActor<AShipSaveTestPart>(Location, Rotation);
+			ShipPart->SetActorScale3D(Scale);
+			ShipPart->Health = PartIndex;
+			ShipPart->UnsavedValue = 7;
+			if (PartIndex % 4 == 0)
+			{
+				ShipPart->Label = FString::Printf(TEXT("Part %d"), PartIndex);
+			}
+			if (PartIndex % 2 == 0)
+			{
+				ShipPart->PaintColour = FLinearColor(0.25f, 0.5f, PartIndex / float(NumParts));
+			}
+
+			if (ShipParts.Num() > 0)
+			{
+				AShipPart::AttachPointPair(FShipAttachPointRef(ShipParts.Last(), 1), FShipAttachPointRef(ShipPart, 0));
+			}
+			ShipParts.Add(ShipPart);
+		}
+		return ShipParts;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FShipSaveFormatRoundTripTest, "ShipBuilding.Serialization.SaveFormatRoundTrip", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FShipSaveFormatRoundTripTest::RunTest(const FString& Parameters)
+{
+	using namespace ShipSaveGameTests;
+
+	FScopedTestWorld TestWorld;
+	const TArray<AShipPart*> ShipParts = MakeShip(TestWorld.World, 64);
+	if (ShipParts.Num() == 0 || ShipParts[0]->GetNumAttachPoints() != 2)
+	{
+		AddError(TEXT("Failed to spawn the test parts with their attach points."));
+		return false;
+	}
+
+	// The compact data should decode to the same ship as the legacy records, and be several times smaller once written.
+	float SizeRatio = 0.f;
+	TestTrue(TEXT("Compact save matches the legacy save"), UShipSaveGame::ValidateCompactRoundTrip(ShipParts, FShipSaveQuantization(), &SizeRatio));
+	TestTrue(FString::Printf(TEXT("Compact save is at least 3x smaller than the legacy save (%.1fx)"), SizeRatio), SizeRatio >= 3.f);
+
+	// Both formats should load back the same parts and saved properties. Only the compact format stores the attachments.
+	UShipSaveGame* LegacySave = NewObject<UShipSaveGame>();
+	UShipSaveGame* CompactSave = NewObject<UShipSaveGame>();
+	LegacySave->SaveShipLegacy(TEXT("RoundTrip"), ShipParts);
+	CompactSave->SaveShip(TEXT("RoundTrip"), ShipParts);
+
+	for (const UShipSaveGame* Save : { LegacySave, CompactSave })
+	{
+		const FString Format = Save->IsCompactFormat() ? TEXT("Compact") : TEXT("Legacy");
+
+		TArray<AShipPart*> LoadedParts;
+		TestTrue(Format + TEXT(" save loads"), Save->LoadShip(TestWorld.World, LoadedParts));
+		TestEqual(Format + TEXT(" part count"), LoadedParts.Num(), ShipParts.Num());
+		if (LoadedParts.Num() != ShipParts.Num())
+		{
+			continue;
+		}
+
+		TMap<const AShipPart*, AShipPart*> LoadedFromSaved;
+		for (int32 PartIndex = 0; PartIndex < ShipParts.Num(); ++PartIndex)
+		{
+			LoadedFromSaved.Add(ShipParts[PartIndex], LoadedParts[PartIndex]);
+		}
+
+		for (int32 PartIndex = 0; PartIndex < ShipParts.Num(); ++PartIndex)
+		{
+			const AShipSaveTestPart* Saved = CastChecked<AShipSaveTestPart>(ShipParts[PartIndex]);
+			const AShipSaveTestPart* Loaded = Cast<AShipSaveTestPart>(LoadedParts[PartIndex]);
+			const FString Part = FString::Printf(TEXT("%s part %d"), *Format, PartIndex);
+			if (!Loaded)
+			{
+				AddError(Part + TEXT(" isn't the saved class."));
+				continue;
+			}
+
+			TestEqual(Part + TEXT(" health"), Loaded->Health, Saved->Health);
+			TestTrue(Part + TEXT(" label"), Loaded->Label == Saved->Label);
+			TestTrue(Part + TEXT(" paint colour"), Loaded->PaintColour.Equals(Saved->PaintColour, 0.f));
+			TestEqual(Part + TEXT(" unsaved value"), Loaded->UnsavedValue, 0);
+			TestTrue(Part + TEXT(" location"), Loaded->GetActorLocation().Equals(Saved->GetActorLocation(), 0.01f));
+			TestTrue(Part + TEXT(" scale"), Loaded->GetActorScale3D().Equals(Saved->GetActorScale3D()));
+
+			if (Save->IsCompactFormat())
+			{
+				for (int32 PointIndex = 0; PointIndex < Saved->GetNumAttachPoints(); ++PointIndex)
+				{
+					const FShipAttachPointRef SavedPoint(const_cast<AShipSaveTestPart*>(Saved), PointIndex);
+					const FShipAttachPointRef LoadedPoint(const_cast<AShipSaveTestPart*>(Loaded), PointIndex);
+					const bool bSameAttachment = SavedPoint.IsAttached()
+						? LoadedPoint.IsAttachedToPoint(FShipAttachPointRef(LoadedFromSaved.FindRef(SavedPoint.GetAttachedToShipPart()), SavedPoint.GetAttachedToPoint().Index))
+						: !LoadedPoint.IsAttached();
+					TestTrue(FString::Printf(TEXT("%s point %d attachment"), *Part, PointIndex), bSameAttachment);
+				}
+			}
+		}
+
+		for (AShipPart* LoadedPart : LoadedParts)
+		{
+			LoadedPart->DetatchAllPoints();
+			LoadedPart->Destroy();
+		}
+	}
+
+	for (AShipPart* ShipPart : ShipParts)
+	{
+		ShipPart->DetatchAllPoints();
+		ShipPart->Destroy();
+	}
+	return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipSaveLibrary.h"
+#include "ShipSaveFile.h"
+
+bool FShipSaveLibrary::GetShips(TArray<FShipSaveInfo>& OutShips)
+{
+	OutShips.Reset();
+
+	struct FStatVisitor : public IPlatformFile::FDirectoryStatVisitor
+	{
+		TArray<TPair<FString, FFileStatData>> Saves;
+
+		bool Visit(const TCHAR* FilenameOrDirectory, const FFileStatData& StatData) final
+		{
+			// Skip anything that isn't a save, ie. temp files.
+			if (!StatData.bIsDirectory && FPaths::GetExtension(FilenameOrDirectory) == TEXT("sav"))
+			{
+				Saves.Emplace(FilenameOrDirectory, StatData);
+			}
+			return true;
+		}
+	};
+
+	const FString SaveGameDir = FPaths::GetPath(ShipSaveFile::GetSlotFilename(TEXT("")));
+	FStatVisitor Visitor;
+	if (!FPlatformFileManager::Get().GetPlatformFile().IterateDirectoryStat(*SaveGameDir, Visitor))
+	{
+		return false;
+	}
+
+	// Find which saves are new or have changed since they were last read.
+	TSet<FString> Existing;
+	TArray<FString> StaleFilenames;
+	Existing.Reserve(Visitor.Saves.Num());
+	for (const TPair<FString, FFileStatData>& Save : Visitor.Saves)
+	{
+		Existing.Add(Save.Key);
+
+		FCachedSave& Cached = Cache.FindOrAdd(Save.Key);
+		if (Cached.Timestamp != Save.Value.ModificationTime || Cached.FileSize != Save.Value.FileSize)
+		{
+			Cached.Timestamp = Save.Value.ModificationTime;
+			Cached.FileSize = Save.Value.FileSize;
+			StaleFilenames.Add(Save.Key);
+		}
+	}
+
+	// Forget saves that have been deleted.
+	for (auto It = Cache.CreateIterator(); It; ++It)
+	{
+		if (!Existing.Contains(It.Key()))
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	// Adding to the cache can move its elements, so only take pointers into it once it's stopped changing.
+	TArray<FCachedSave*> Stale;
+	Stale.Reserve(StaleFilenames.Num());
+	for (const FString& Filename : StaleFilenames)
+	{
+		Stale.Add(&Cache.FindChecked(Filename));
+	}
+
+	ParallelFor(Stale.Num(), [&Stale, &StaleFilenames](int32 Index)
+	{
+		FCachedSave& Cached = *Stale[Index];
+		FShipSaveInfo& Info = Cached.Info;
+		Info = FShipSaveInfo();
+		Info.ShipName = FPaths::GetBaseFilename(StaleFilenames[Index]);
+		Info.SizeBytes = (int32)FMath::Min<int64>(Cached.FileSize, MAX_int32);
+		Info.ModifiedTime = Cached.Timestamp;
+
+		FShipSaveHeader Header;
+		if (ShipSaveFile::ReadHeader(StaleFilenames[Index], Header))
+		{
+			Info.NumParts = Header.NumParts;
+			Info.RootPartType = Header.RootPartType;
+		}
+	});
+
+	OutShips.Reserve(Cache.Num());
+	for (const TPair<FString, FCachedSave>& Cached : Cache)
+	{
+		OutShips.Add(Cached.Value.Info);
+	}
+	OutShips.Sort([](const FShipSaveInfo& A, const FShipSaveInfo& B) { return A.ShipName < B.ShipName; });
+	return true;
+}
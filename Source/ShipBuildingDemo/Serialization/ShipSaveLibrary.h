@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ShipBuilding/ShipBuildingTypes.h"
+#include "ShipSaveLibrary.generated.h"
+
+// Where ships are saved to and loaded from.
+UENUM(BlueprintType)
+enum class EShipSaveBackend : uint8
+{
+	SB_Slots		UMETA(DisplayName = "Save game slot per ship"),
+	SB_LibraryPack	UMETA(DisplayName = "Single library pack"), // See FShipLibraryPack.
+};
+
+/**
+ *	What the ship library shows for a saved ship, read from its save header.
+ */
+USTRUCT(BlueprintType)
+struct FShipSaveInfo
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "ShipSaving")
+	FString ShipName;
+
+	// -1 for saves from before they had a header.
+	UPROPERTY(BlueprintReadOnly, Category = "ShipSaving")
+	int32 NumParts = -1;
+
+	UPROPERTY(BlueprintReadOnly, Category = "ShipSaving")
+	int32 SizeBytes = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "ShipSaving")
+	FDateTime ModifiedTime;
+
+	// The cockpit if the ship has one. PT_MAX if unknown.
+	UPROPERTY(BlueprintReadOnly, Category = "ShipSaving")
+	EPartType RootPartType = EPartType::PT_MAX;
+};
+
+/**
+ *	Lists the saved ships. Only the header of each save is read, on worker threads, and the results are cached
+ *	until the file's timestamp or size changes, so listing the library again is just a directory scan.
+ */
+class SHIPBUILDINGDEMO_API FShipSaveLibrary
+{
+public:
+	/**
+	 *	Gets all the saved ships, ordered by name.
+	 *
+	 *	@param OutShips: The saved ships.
+	 *	@return: False if the save directory couldn't be read.
+	 */
+	bool GetShips(TArray<FShipSaveInfo>& OutShips);
+
+	// Forgets all cached headers.
+	FORCEINLINE void Invalidate() { Cache.Empty(); }
+
+private:
+	struct FCachedSave
+	{
+		FShipSaveInfo Info;
+		FDateTime Timestamp;
+		int64 FileSize = -1;
+	};
+
+	// By full filename.
+	TMap<FString, FCachedSave> Cache;
+};
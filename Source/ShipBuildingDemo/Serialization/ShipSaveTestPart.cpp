@@ -0,0 +1,25 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipSaveTestPart.h"
+#include "ShipBuilding/ShipAttachPoint.h"
+
+const float AShipSaveTestPart::Length = 100.f;
+
+AShipSaveTestPart::AShipSaveTestPart()
+: Health(100)
+, PaintColour(FLinearColor::White)
+, UnsavedValue(0)
+{
+	RootComponent = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("Mesh"));
+
+	// A point at each end, so the parts can be chained together.
+	UShipAttachPoint* Back = CreateDefaultSubobject<UShipAttachPoint>(TEXT("Back"));
+	Back->SetupAttachment(RootComponent);
+	Back->RelativeLocation = FVector(-Length * 0.5f, 0.f, 0.f);
+	Back->RelativeRotation = FRotator(0.f, 180.f, 0.f);
+
+	UShipAttachPoint* Front = CreateDefaultSubobject<UShipAttachPoint>(TEXT("Front"));
+	Front->SetupAttachment(RootComponent);
+	Front->RelativeLocation = FVector(Length * 0.5f, 0.f, 0.f);
+}
@@ -0,0 +1,35 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ShipBuilding/ShipPart.h"
+#include "ShipSaveTestPart.generated.h"
+
+/**
+ *	Ship part with a couple of attach points and SaveGame properties of a few kinds, used by the save round trip tests.
+ *	Native so the tests don't depend on any content.
+ */
+UCLASS(NotBlueprintable, NotPlaceable)
+class SHIPBUILDINGDEMO_API AShipSaveTestPart : public AShipPart
+{
+	GENERATED_BODY()
+
+public:
+	AShipSaveTestPart();
+
+	UPROPERTY(SaveGame)
+	int32 Health;
+
+	UPROPERTY(SaveGame)
+	FString Label;
+
+	UPROPERTY(SaveGame)
+	FLinearColor PaintColour;
+
+	// Not saved, so it should come back as the default.
+	UPROPERTY()
+	int32 UnsavedValue;
+
+	// Distance between the two attach points.
+	static const float Length;
+};
@@ -0,0 +1,161 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipStagedParts.h"
+#include "ShipSaveGame.h"
+#include "ShipBuilding/ShipPart.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	// Reads a saved value through the same proxy it was written with.
+	void DecodePropertyValue(UProperty* Property, const TArray<uint8>& EncodedValue, void* Value)
+	{
+		FMemoryReader MemoryReader{ EncodedValue, true };
+		FShipSaveGameArchiveProxy Archive{ MemoryReader };
+		for (int32 i = 0; i < Property->ArrayDim; ++i)
+		{
+			Property->SerializeItem(Archive, static_cast<uint8*>(Value) + i * Property->ElementSize, nullptr);
+		}
+	}
+}
+
+FShipStagedParts::~FShipStagedParts()
+{
+	Reset();
+}
+
+void FShipStagedParts::Stage(const FShipSnapshot& Snapshot, bool bParallel /*= true*/)
+{
+	check(IsInGameThread());
+	Reset();
+
+	TemplateClasses.Reserve(Snapshot.Templates.Num());
+	for (const FString& Template : Snapshot.Templates)
+	{
+		TemplateClasses.Add(UShipSaveGame::ResolveShipTemplate(Template));
+	}
+
+	// Look up each saved property once per template rather than once per part. Null if the class no longer saves it.
+	const int32 NumPropertyNames = Snapshot.PropertyNames.Num();
+	TArray<UProperty*> PropertyTable;
+	PropertyTable.SetNumZeroed(TemplateClasses.Num() * NumPropertyNames);
+	for (int32 TemplateIndex = 0; TemplateIndex < TemplateClasses.Num(); ++TemplateIndex)
+	{
+		if (UClass* PartClass = TemplateClasses[TemplateIndex])
+		{
+			for (int32 NameIndex = 0; NameIndex < NumPropertyNames; ++NameIndex)
+			{
+				UProperty* Property = FindField<UProperty>(PartClass, Snapshot.PropertyNames[NameIndex]);
+				if (Property && Property->HasAnyPropertyFlags(CPF_SaveGame))
+				{
+					PropertyTable[TemplateIndex * NumPropertyNames + NameIndex] = Property;
+				}
+			}
+		}
+	}
+
+	Parts.SetNum(Snapshot.Parts.Num());
+	ParallelFor(Parts.Num(), [this, &Snapshot, &PropertyTable, NumPropertyNames](int32 PartIndex)
+	{
+		StagePart(Snapshot.Parts[PartIndex], PropertyTable, NumPropertyNames, Parts[PartIndex]);
+	}, !bParallel);
+}
+
+void FShipStagedParts::StagePart(const FShipPartSnapshot& PartSnapshot, const TArray<UProperty*>& PropertyTable, int32 NumPropertyNames, FStagedPart& OutPart) const
+{
+	OutPart.Class = TemplateClasses[PartSnapshot.TemplateIndex];
+	OutPart.Transform = PartSnapshot.Transform;
+	OutPart.ValueBlock = nullptr;
+	if (!OutPart.Class || PartSnapshot.Properties.Num() == 0)
+	{
+		return;
+	}
+
+	// Lay the values out in a single block.
+	int32 BlockSize = 0;
+	OutPart.Properties.Reserve(PartSnapshot.Properties.Num());
+	for (const FShipPropertySnapshot& Saved : PartSnapshot.Properties)
+	{
+		UProperty* Property = PropertyTable[PartSnapshot.TemplateIndex * NumPropertyNames + Saved.NameIndex];
+		if (!Property)
+		{
+			continue;
+		}
+
+		int32 ValueOffset = INDEX_NONE;
+		if (!Property->ContainsObjectReference())
+		{
+			ValueOffset = Align(BlockSize, Property->GetMinAlignment());
+			BlockSize = ValueOffset + Property->GetSize();
+		}
+		OutPart.Properties.Add({ Property, ValueOffset, &Saved.Value });
+	}
+
+	if (BlockSize == 0)
+	{
+		return;
+	}
+
+	OutPart.ValueBlock = static_cast<uint8*>(FMemory::Malloc(BlockSize, 16));
+	for (const FStagedProperty& Staged : OutPart.Properties)
+	{
+		if (Staged.ValueOffset != INDEX_NONE)
+		{
+			void* Value = OutPart.ValueBlock + Staged.ValueOffset;
+			Staged.Property->InitializeValue(Value);
+			DecodePropertyValue(Staged.Property, *Staged.EncodedValue, Value);
+		}
+	}
+}
+
+AShipPart* FShipStagedParts::SpawnPart(int32 PartIndex, UWorld* World, UShipPartPool* ShipPartPool) const
+{
+	const FStagedPart& Part = Parts[PartIndex];
+	return UShipSaveGame::SpawnShipPart(World, Part.Class, Part.Transform, ShipPartPool, [this, &Part](AShipPart* NewShipPart)
+	{
+		ApplyProperties(Part, NewShipPart);
+	});
+}
+
+void FShipStagedParts::ApplyProperties(const FStagedPart& Part, AShipPart* ShipPart) const
+{
+	check(ShipPart->IsA(Part.Class));
+	for (const FStagedProperty& Staged : Part.Properties)
+	{
+		void* Dest = Staged.Property->ContainerPtrToValuePtr<void>(ShipPart);
+		if (Staged.ValueOffset != INDEX_NONE)
+		{
+			Staged.Property->CopyCompleteValue(Dest, Part.ValueBlock + Staged.ValueOffset);
+		}
+		else
+		{
+			DecodePropertyValue(Staged.Property, *Staged.EncodedValue, Dest);
+		}
+	}
+}
+
+void FShipStagedParts::Reset()
+{
+	for (FStagedPart& Part : Parts)
+	{
+		if (Part.ValueBlock)
+		{
+			for (const FStagedProperty& Staged : Part.Properties)
+			{
+				if (Staged.ValueOffset != INDEX_NONE)
+				{
+					Staged.Property->DestroyValue(Part.ValueBlock + Staged.ValueOffset);
+				}
+			}
+			FMemory::Free(Part.ValueBlock);
+		}
+	}
+	ShipUtils::ClearArray(Parts);
+	ShipUtils::ClearArray(TemplateClasses);
+}
+
+void FShipStagedParts::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	Collector.AddReferencedObjects(TemplateClasses);
+}
@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ShipRecords.h"
+
+class AShipPart;
+class UShipPartPool;
+
+namespace ShipLoadStaging
+{
+	// How UShipSaveGame::SpawnSnapshot prepares the parts before spawning them.
+	enum Type
+	{
+		// Decode each part's properties on the game thread as it's spawned.
+		None,
+		// Stage the parts first, on the game thread. Only used for benchmarking.
+		SingleThreaded,
+		// Stage the parts first, decoding them in parallel.
+		Parallel,
+	};
+}
+
+/**
+ *	The parts of a decoded ship, ready to be spawned.
+ *	Staging resolves each class and saved property once on the game thread, then decodes every part's properties into spawn-ready values across the task graph.
+ *	That leaves the game thread with just spawning the parts and copying the values in.
+ *	Properties that reference other objects are left encoded and decoded when they're applied, as resolving objects isn't safe off the game thread.
+ */
+class SHIPBUILDINGDEMO_API FShipStagedParts : public FGCObject
+{
+public:
+	struct FStagedProperty
+	{
+		UProperty* Property;
+
+		// Offset of the decoded value in the part's ValueBlock, or INDEX_NONE if it's decoded from EncodedValue when applied.
+		int32 ValueOffset;
+
+		// The value in the snapshot.
+		const TArray<uint8>* EncodedValue;
+	};
+
+	struct FStagedPart
+	{
+		UClass* Class;
+		FTransform Transform;
+		TArray<FStagedProperty> Properties;
+
+		// Memory holding the decoded property values.
+		uint8* ValueBlock;
+	};
+
+	FShipStagedParts() = default;
+	~FShipStagedParts();
+
+	FShipStagedParts(const FShipStagedParts&) = delete;
+	FShipStagedParts& operator=(const FShipStagedParts&) = delete;
+
+	/**
+	 *	Stages the parts of a snapshot. Must be called on the game thread.
+	 *
+	 *	@param Snapshot: The ship to stage. Must outlive the staged parts as the undecoded values point into it.
+	 *	@param bParallel: Decode the parts across the task graph rather than all on the game thread.
+	 */
+	void Stage(const FShipSnapshot& Snapshot, bool bParallel = true);
+
+	/**
+	 *	Spawns a staged part (or takes it from the pool) and applies its properties.
+	 *
+	 *	@param PartIndex: Index of the part in the snapshot.
+	 *	@param World: The world to spawn the part in.
+	 *	@param ShipPartPool: Optional pool to take the part from.
+	 *	@return: The part or nullptr if it failed to spawn.
+	 */
+	AShipPart* SpawnPart(int32 PartIndex, UWorld* World, UShipPartPool* ShipPartPool) const;
+
+	// Frees the decoded values.
+	void Reset();
+
+	FORCEINLINE int32 Num() const { return Parts.Num(); }
+	FORCEINLINE const FStagedPart& GetPart(int32 PartIndex) const { return Parts[PartIndex]; }
+
+	// Begin FGCObject Interface.
+	void AddReferencedObjects(FReferenceCollector& Collector) override;
+	// End FGCObject Interface.
+
+private:
+	// Decodes the properties of a single part. Safe to call from any thread.
+	void StagePart(const FShipPartSnapshot& PartSnapshot, const TArray<UProperty*>& PropertyTable, int32 NumPropertyNames, FStagedPart& OutPart) const;
+
+	// Copies the staged properties into a part.
+	void ApplyProperties(const FStagedPart& Part, AShipPart* ShipPart) const;
+
+	TArray<FStagedPart> Parts;
+
+	// Class of each of the snapshot's templates.
+	TArray<UClass*> TemplateClasses;
+};
@@ -0,0 +1,197 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipStreamingLoad.h"
+#include "ShipBuilding/ShipPart.h"
+#include "ShipBuilding/ShipPartPool.h"
+
+DECLARE_LOG_CATEGORY_CLASS(LogShipStreamingLoad, Log, All);
+
+FShipStreamingLoad::FShipStreamingLoad(UWorld* InWorld, FShipSnapshot&& InSnapshot, EShipLoadOrder Order, const FVector& ViewLocation, UShipPartPool* InShipPartPool)
+: World(InWorld)
+, ShipPartPool(InShipPartPool)
+, Snapshot(MoveTemp(InSnapshot))
+, NumSpawned(0)
+, bAnyFailed(false)
+, bComplete(false)
+{
+	// There are only a handful of templates, and they're usually already loaded by the part factory.
+	StagedParts.Stage(Snapshot);
+
+	ShipParts.SetNumZeroed(Snapshot.Parts.Num());
+	SpawnOrder.Reserve(Snapshot.Parts.Num());
+	for (int32 PartIndex = 0; PartIndex < Snapshot.Parts.Num(); ++PartIndex)
+	{
+		SpawnOrder.Add(PartIndex);
+	}
+
+	switch (Order)
+	{
+	case EShipLoadOrder::LO_NearestToCamera:
+		SortByDistance(ViewLocation);
+		break;
+	case EShipLoadOrder::LO_FromCockpit:
+		SortFromCockpit();
+		break;
+	default:
+		break;
+	}
+}
+
+bool FShipStreamingLoad::Tick(float BudgetMs)
+{
+	if (bComplete)
+	{
+		return true;
+	}
+
+	UWorld* WorldRef = World.Get();
+	if (!WorldRef)
+	{
+		return false;
+	}
+
+	const double EndTime = FPlatformTime::Seconds() + BudgetMs / 1000.0;
+	do
+	{
+		if (NumSpawned == SpawnOrder.Num())
+		{
+			Finish();
+			return true;
+		}
+
+		const int32 PartIndex = SpawnOrder[NumSpawned++];
+		ShipParts[PartIndex] = StagedParts.SpawnPart(PartIndex, WorldRef, ShipPartPool);
+		if (!ShipParts[PartIndex])
+		{
+			UE_LOG(LogShipStreamingLoad, Error, TEXT("Failed to create ship part: %s"), *Snapshot.Templates[Snapshot.Parts[PartIndex].TemplateIndex]);
+			bAnyFailed = true;
+		}
+	}
+	while (FPlatformTime::Seconds() < EndTime);
+
+	return false;
+}
+
+void FShipStreamingLoad::Cancel()
+{
+	for (AShipPart*& ShipPart : ShipParts)
+	{
+		if (ShipPart)
+		{
+			if (ShipPartPool)
+			{
+				ShipPartPool->Release(ShipPart);
+			}
+			else
+			{
+				ShipPart->Destroy();
+			}
+			ShipPart = nullptr;
+		}
+	}
+	ShipUtils::ClearArray(ShipParts, false);
+	StagedParts.Reset();
+	SpawnOrder.Empty();
+	NumSpawned = 0;
+	bComplete = true;
+}
+
+void FShipStreamingLoad::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	Collector.AddReferencedObjects(ShipParts);
+	Collector.AddReferencedObject(ShipPartPool);
+}
+
+void FShipStreamingLoad::SortByDistance(const FVector& ViewLocation)
+{
+	TArray<float> DistancesSquared;
+	DistancesSquared.Reserve(Snapshot.Parts.Num());
+	for (const FShipPartSnapshot& Part : Snapshot.Parts)
+	{
+		DistancesSquared.Add(FVector::DistSquared(Part.Transform.GetLocation(), ViewLocation));
+	}
+
+	SpawnOrder.Sort([&DistancesSquared](int32 A, int32 B) { return DistancesSquared[A] < DistancesSquared[B]; });
+}
+
+void FShipStreamingLoad::SortFromCockpit()
+{
+	const int32 NumParts = Snapshot.Parts.Num();
+
+	// Flatten the attachments into a neighbour list per part (offsets into one array) so the search doesn't allocate per part.
+	TArray<int32> NeighbourOffsets;
+	NeighbourOffsets.SetNumZeroed(NumParts + 1);
+	for (const FShipAttachmentSnapshot& Attachment : Snapshot.Attachments)
+	{
+		++NeighbourOffsets[Attachment.PartA + 1];
+		++NeighbourOffsets[Attachment.PartB + 1];
+	}
+	for (int32 i = 0; i < NumParts; ++i)
+	{
+		NeighbourOffsets[i + 1] += NeighbourOffsets[i];
+	}
+
+	TArray<int32> Neighbours;
+	Neighbours.SetNumUninitialized(NeighbourOffsets[NumParts]);
+	TArray<int32> NextNeighbour = NeighbourOffsets;
+	for (const FShipAttachmentSnapshot& Attachment : Snapshot.Attachments)
+	{
+		Neighbours[NextNeighbour[Attachment.PartA]++] = Attachment.PartB;
+		Neighbours[NextNeighbour[Attachment.PartB]++] = Attachment.PartA;
+	}
+
+	// Start from the cockpits, then any pieces that aren't connected to one in saved order.
+	TArray<int32> Roots;
+	for (int32 PartIndex = 0; PartIndex < NumParts; ++PartIndex)
+	{
+		const UClass* PartClass = StagedParts.GetPart(PartIndex).Class;
+		if (PartClass && PartClass->GetDefaultObject<AShipPart>()->GetPartType() == EPartType::PT_Cockpit)
+		{
+			Roots.Add(PartIndex);
+		}
+	}
+	for (int32 PartIndex = 0; PartIndex < NumParts; ++PartIndex)
+	{
+		Roots.Add(PartIndex);
+	}
+
+	TBitArray<> Visited{ false, NumParts };
+	SpawnOrder.Reset();
+	for (int32 Root : Roots)
+	{
+		if (Visited[Root])
+		{
+			continue;
+		}
+
+		// SpawnOrder doubles as the queue.
+		Visited[Root] = true;
+		int32 Head = SpawnOrder.Add(Root);
+		for (; Head < SpawnOrder.Num(); ++Head)
+		{
+			const int32 PartIndex = SpawnOrder[Head];
+			for (int32 i = NeighbourOffsets[PartIndex]; i < NeighbourOffsets[PartIndex + 1]; ++i)
+			{
+				const int32 Neighbour = Neighbours[i];
+				if (!Visited[Neighbour])
+				{
+					Visited[Neighbour] = true;
+					SpawnOrder.Add(Neighbour);
+				}
+			}
+		}
+	}
+	check(SpawnOrder.Num() == NumParts);
+}
+
+void FShipStreamingLoad::Finish()
+{
+	const int32 NumFailed = Snapshot.RestoreAttachments(ShipParts);
+	UE_CLOG(NumFailed > 0, LogShipStreamingLoad, Warning, TEXT("%d of %d attachments couldn't be restored"), NumFailed, Snapshot.Attachments.Num());
+
+	ShipParts.Remove(nullptr);
+	StagedParts.Reset();
+	Snapshot.Reset();
+	bComplete = true;
+}
@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ShipRecords.h"
+#include "ShipStagedParts.h"
+#include "ShipStreamingLoad.generated.h"
+
+class AShipPart;
+class UShipPartPool;
+
+// Order a streaming load spawns a ship's parts in.
+UENUM(BlueprintType)
+enum class EShipLoadOrder : uint8
+{
+	LO_Saved			UMETA(DisplayName = "Saved order"),
+	LO_NearestToCamera	UMETA(DisplayName = "Nearest to camera"),
+	LO_FromCockpit		UMETA(DisplayName = "Outwards from cockpit"), // Breadth first through the attachments.
+};
+
+/**
+ *	Spawns the parts of a saved ship over several frames, spending at most a set amount of time per frame.
+ *	Attachments are restored once every part has been spawned, without firing the attach events, the same as UShipSaveGame::LoadShip.
+ */
+class SHIPBUILDINGDEMO_API FShipStreamingLoad : public FGCObject
+{
+public:
+	/**
+	 *	Stages the parts (see FShipStagedParts) and works out the spawn order. Nothing is spawned until Tick.
+	 *
+	 *	@param InWorld: The world to spawn the parts in.
+	 *	@param InSnapshot: The decoded ship (see UShipSaveGame::DecodeShipData).
+	 *	@param Order: The order to spawn the parts in.
+	 *	@param ViewLocation: Where the camera is, for LO_NearestToCamera.
+	 *	@param InShipPartPool: Optional pool to take parts from before spawning new ones.
+	 */
+	FShipStreamingLoad(UWorld* InWorld, FShipSnapshot&& InSnapshot, EShipLoadOrder Order, const FVector& ViewLocation, UShipPartPool* InShipPartPool);
+
+	/**
+	 *	Spawns parts until the time budget runs out. Always spawns at least one so the load can't stall.
+	 *
+	 *	@param BudgetMs: How long in milliseconds to spend spawning.
+	 *	@return: True once every part has been spawned and the attachments restored.
+	 */
+	bool Tick(float BudgetMs);
+
+	// Stops the load, returning the parts spawned so far to the pool (or destroying them if there isn't one).
+	void Cancel();
+
+	// Fraction of the parts that have been spawned.
+	FORCEINLINE float GetProgress() const { return (SpawnOrder.Num() > 0) ? (float)NumSpawned / SpawnOrder.Num() : 1.f; }
+	FORCEINLINE bool IsComplete() const { return bComplete; }
+
+	// Did any of the parts fail to spawn.
+	FORCEINLINE bool HasFailures() const { return bAnyFailed; }
+
+	// The parts that were spawned, in saved order. Only valid once complete.
+	FORCEINLINE TArray<AShipPart*>& GetShipParts() { return ShipParts; }
+
+	// Begin FGCObject Interface.
+	void AddReferencedObjects(FReferenceCollector& Collector) override;
+	// End FGCObject Interface.
+
+private:
+	// Works out SpawnOrder.
+	void SortByDistance(const FVector& ViewLocation);
+	void SortFromCockpit();
+
+	// Restores the attachments and compacts ShipParts.
+	void Finish();
+
+	TWeakObjectPtr<UWorld> World;
+	UShipPartPool* ShipPartPool;
+	FShipSnapshot Snapshot;
+
+	// The snapshot's parts, decoded and ready to spawn.
+	FShipStagedParts StagedParts;
+
+	// Indices into Snapshot.Parts in the order they're spawned.
+	TArray<int32> SpawnOrder;
+	int32 NumSpawned;
+
+	// Spawned parts by their index in Snapshot.Parts. Null until spawned or if spawning failed.
+	TArray<AShipPart*> ShipParts;
+
+	bool bAnyFailed;
+	bool bComplete;
+};
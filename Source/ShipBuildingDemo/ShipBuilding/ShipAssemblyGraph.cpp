@@ -0,0 +1,239 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipAssemblyGraph.h"
+#include "ShipPart.h"
+
+
+FShipAssemblyGraph::FShipAssemblyGraph()
+: NumComponents(0)
+, bComponentsDirty(false)
+{
+}
+
+void FShipAssemblyGraph::Build(const TArray<AShipPart*>& InParts)
+{
+	Reset();
+
+	Parts.Reserve(InParts.Num());
+	for (AShipPart* ShipPart : InParts)
+	{
+		AddPart(ShipPart);
+	}
+
+	// Add each attachment once, from the lower of the two points.
+	for (AShipPart* ShipPart : InParts)
+	{
+		for (int32 PointIndex = 0; PointIndex < ShipPart->GetNumAttachPoints(); ++PointIndex)
+		{
+			const FShipAttachPointRef AttachPoint(ShipPart, PointIndex);
+			const FShipAttachPointRef AttachedTo = AttachPoint.GetAttachedToPoint();
+			if (AttachedTo.IsValid() && AttachPoint < AttachedTo)
+			{
+				AddEdge(AttachPoint, AttachedTo);
+			}
+		}
+	}
+}
+
+void FShipAssemblyGraph::Reset()
+{
+	for (AShipPart* ShipPart : Parts)
+	{
+		ShipPart->AssemblyIndex = INDEX_NONE;
+	}
+	ShipUtils::ClearArray(Parts);
+	ShipUtils::ClearArray(Adjacency);
+	ShipUtils::ClearArray(ComponentParents);
+	NumComponents = 0;
+	bComponentsDirty = false;
+}
+
+void FShipAssemblyGraph::AddPart(AShipPart* ShipPart)
+{
+	check(ShipPart);
+	checkf(ShipPart->AssemblyIndex == INDEX_NONE, TEXT("%s is already in an assembly graph."), *GetNameSafe(ShipPart));
+
+	ShipPart->AssemblyIndex = Parts.Add(ShipPart);
+	Adjacency.AddDefaulted();
+
+	// A new part is its own component.
+	ComponentParents.Add(ShipPart->AssemblyIndex);
+	++NumComponents;
+}
+
+void FShipAssemblyGraph::RemovePart(AShipPart* ShipPart)
+{
+	const int32 Index = GetIndexChecked(ShipPart);
+
+	// Remove any edges that are left.
+	for (const int32 Neighbour : Adjacency[Index])
+	{
+		Adjacency[Neighbour].RemoveSingleSwap(Index, false);
+	}
+
+	// Move the last part into the removed part's slot and point its neighbours at the new index.
+	const int32 LastIndex = Parts.Num() - 1;
+	if (Index != LastIndex)
+	{
+		for (const int32 Neighbour : Adjacency[LastIndex])
+		{
+			for (int32& NeighbourOfNeighbour : Adjacency[Neighbour])
+			{
+				if (NeighbourOfNeighbour == LastIndex)
+				{
+					NeighbourOfNeighbour = Index;
+				}
+			}
+		}
+		Parts[LastIndex]->AssemblyIndex = Index;
+	}
+
+	Parts.RemoveAtSwap(Index, 1, false);
+	Adjacency.RemoveAtSwap(Index, 1, false);
+	ComponentParents.RemoveAtSwap(Index, 1, false);
+	ShipPart->AssemblyIndex = INDEX_NONE;
+
+	// Moving indices around invalidates the parent links.
+	bComponentsDirty = true;
+}
+
+void FShipAssemblyGraph::AddEdge(const FShipAttachPointRef& A, const FShipAttachPointRef& B)
+{
+	const int32 IndexA = GetIndexChecked(A.GetOwningShipPart());
+	const int32 IndexB = GetIndexChecked(B.GetOwningShipPart());
+	Adjacency[IndexA].Add(IndexB);
+	Adjacency[IndexB].Add(IndexA);
+
+	if (!bComponentsDirty)
+	{
+		Union(IndexA, IndexB);
+	}
+}
+
+void FShipAssemblyGraph::RemoveEdge(const FShipAttachPointRef& A, const FShipAttachPointRef& B)
+{
+	const int32 IndexA = GetIndexChecked(A.GetOwningShipPart());
+	const int32 IndexB = GetIndexChecked(B.GetOwningShipPart());
+	Adjacency[IndexA].RemoveSingleSwap(IndexB, false);
+	Adjacency[IndexB].RemoveSingleSwap(IndexA, false);
+
+	// The parts are still directly connected if they were attached by more than one pair of points.
+	if (!Adjacency[IndexA].Contains(IndexB))
+	{
+		bComponentsDirty = true;
+	}
+}
+
+bool FShipAssemblyGraph::IsAttached(const AShipPart* ShipPart) const
+{
+	return (Adjacency[GetIndexChecked(ShipPart)].Num() > 0);
+}
+
+bool FShipAssemblyGraph::AreConnected(const AShipPart* A, const AShipPart* B) const
+{
+	return (GetComponentId(A) == GetComponentId(B));
+}
+
+int32 FShipAssemblyGraph::GetComponentId(const AShipPart* ShipPart) const
+{
+	if (!ShipPart || !Parts.IsValidIndex(ShipPart->AssemblyIndex) || Parts[ShipPart->AssemblyIndex] != ShipPart)
+	{
+		return INDEX_NONE;
+	}
+
+	RebuildComponentsIfDirty();
+	return FindRoot(ShipPart->AssemblyIndex);
+}
+
+void FShipAssemblyGraph::GetConnectedParts(const AShipPart* ShipPart, TArray<AShipPart*>& OutParts) const
+{
+	ShipUtils::ClearArray(OutParts);
+
+	// Breadth first search from the part. OutParts doubles as the queue.
+	TBitArray<> Visited(false, Parts.Num());
+	const int32 StartIndex = GetIndexChecked(ShipPart);
+	Visited[StartIndex] = true;
+	OutParts.Add(Parts[StartIndex]);
+	for (int32 QueueIndex = 0; QueueIndex < OutParts.Num(); ++QueueIndex)
+	{
+		for (const int32 Neighbour : Adjacency[OutParts[QueueIndex]->AssemblyIndex])
+		{
+			if (!Visited[Neighbour])
+			{
+				Visited[Neighbour] = true;
+				OutParts.Add(Parts[Neighbour]);
+			}
+		}
+	}
+}
+
+int32 FShipAssemblyGraph::GetNumComponents() const
+{
+	RebuildComponentsIfDirty();
+	return NumComponents;
+}
+
+int32 FShipAssemblyGraph::GetIndexChecked(const AShipPart* ShipPart) const
+{
+	check(ShipPart);
+	const int32 Index = ShipPart->AssemblyIndex;
+	checkf(Parts.IsValidIndex(Index) && Parts[Index] == ShipPart, TEXT("%s is not in this assembly graph."), *GetNameSafe(ShipPart));
+	return Index;
+}
+
+int32 FShipAssemblyGraph::FindRoot(int32 Index) const
+{
+	int32 Root = Index;
+	while (ComponentParents[Root] != Root)
+	{
+		Root = ComponentParents[Root];
+	}
+
+	// Path compression.
+	while (ComponentParents[Index] != Root)
+	{
+		const int32 Next = ComponentParents[Index];
+		ComponentParents[Index] = Root;
+		Index = Next;
+	}
+	return Root;
+}
+
+void FShipAssemblyGraph::Union(int32 A, int32 B) const
+{
+	const int32 RootA = FindRoot(A);
+	const int32 RootB = FindRoot(B);
+	if (RootA != RootB)
+	{
+		// Attach the higher root under the lower one so roots stay deterministic.
+		ComponentParents[FMath::Max(RootA, RootB)] = FMath::Min(RootA, RootB);
+		--NumComponents;
+	}
+}
+
+void FShipAssemblyGraph::RebuildComponentsIfDirty() const
+{
+	if (!bComponentsDirty)
+	{
+		return;
+	}
+
+	NumComponents = Parts.Num();
+	for (int32 i = 0; i < ComponentParents.Num(); ++i)
+	{
+		ComponentParents[i] = i;
+	}
+
+	for (int32 i = 0; i < Adjacency.Num(); ++i)
+	{
+		for (const int32 Neighbour : Adjacency[i])
+		{
+			if (i < Neighbour)
+			{
+				Union(i, Neighbour);
+			}
+		}
+	}
+	bComponentsDirty = false;
+}
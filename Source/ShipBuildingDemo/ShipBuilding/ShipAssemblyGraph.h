@@ -0,0 +1,98 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ShipAttachPointData.h"
+
+class AShipPart;
+
+/**
+ *	Graph of which ship parts are attached to each other. Parts are stored by a dense index kept on the part itself.
+ *	Connected components are tracked with a union-find which is rebuilt lazily the first time they're queried after a detach.
+ *	The owner is responsible for keeping it current when parts are spawned, destroyed, attached or detached.
+ */
+class SHIPBUILDINGDEMO_API FShipAssemblyGraph
+{
+public:
+	FShipAssemblyGraph();
+
+	/**
+	 *	Resets the graph to contain the given parts, along with any attachments they already have.
+	 *
+	 *	@param InParts: The parts to build the graph from.
+	 */
+	void Build(const TArray<AShipPart*>& InParts);
+
+	// Removes all parts and edges but keeps the memory.
+	void Reset();
+
+	/**
+	 *	Adds a part with no attachments.
+	 *
+	 *	@param ShipPart: The part to add. Must not already be in a graph.
+	 */
+	void AddPart(AShipPart* ShipPart);
+
+	/**
+	 *	Removes a part and any edges it still has. The last part is moved into its index.
+	 *
+	 *	@param ShipPart: The part to remove.
+	 */
+	void RemovePart(AShipPart* ShipPart);
+
+	// Add/Remove an edge between the parts owning two points that were attached/detached.
+	void AddEdge(const FShipAttachPointRef& A, const FShipAttachPointRef& B);
+	void RemoveEdge(const FShipAttachPointRef& A, const FShipAttachPointRef& B);
+
+	// Returns true if the part is attached to any other part. O(1).
+	bool IsAttached(const AShipPart* ShipPart) const;
+
+	// Returns true if the two parts are in the same connected component.
+	bool AreConnected(const AShipPart* A, const AShipPart* B) const;
+
+	/**
+	 *	Gets the ID of the connected component the part belongs to. IDs are only stable until the graph next changes.
+	 *
+	 *	@param ShipPart: The part to look up.
+	 *	@return: The component ID or INDEX_NONE if the part isn't in the graph.
+	 */
+	int32 GetComponentId(const AShipPart* ShipPart) const;
+
+	/**
+	 *	Gathers all the parts connected to a part, including the part itself.
+	 *
+	 *	@param ShipPart: The part to start from.
+	 *	@param OutParts: The connected parts. Cleared before adding.
+	 */
+	void GetConnectedParts(const AShipPart* ShipPart, TArray<AShipPart*>& OutParts) const;
+
+	// Gets the number of separate pieces the ship is in.
+	int32 GetNumComponents() const;
+
+	// Returns true if every part is connected.
+	FORCEINLINE bool IsOnePiece() const { return (Parts.Num() <= 1 || GetNumComponents() == 1); }
+	FORCEINLINE int32 Num() const { return Parts.Num(); }
+	FORCEINLINE const TArray<AShipPart*>& GetParts() const { return Parts; }
+
+private:
+	// Gets the index of a part, checking that it belongs to this graph.
+	int32 GetIndexChecked(const AShipPart* ShipPart) const;
+
+	// Union-find helpers.
+	int32 FindRoot(int32 Index) const;
+	void Union(int32 A, int32 B) const;
+	void RebuildComponentsIfDirty() const;
+
+	// Parts by their index.
+	TArray<AShipPart*> Parts;
+
+	// Indices of the parts each part is attached to. Contains a neighbour once per attached pair of points.
+	TArray<TArray<int32>> Adjacency;
+
+	// Union-find parent of each part and the number of roots. Only valid when bComponentsDirty is false.
+	mutable TArray<int32> ComponentParents;
+	mutable int32 NumComponents;
+
+	// Set when something happens that union-find can't handle (detaching/removing) so the components get rebuilt on next query.
+	mutable bool bComponentsDirty;
+};
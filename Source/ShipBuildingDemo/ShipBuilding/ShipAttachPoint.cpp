@@ -2,153 +2,78 @@
 
 #include "ShipBuildingDemo.h"
 #include "ShipAttachPoint.h"
-#include "ShipPart.h"
-
-void UShipAttachPoint::AttachPoints(UShipAttachPoint* A, UShipAttachPoint* B)
-{
-	A->AttachToPoint(B);
-	B->AttachToPoint(A);
-}
-
-void UShipAttachPoint::DetachPoints(UShipAttachPoint* A, UShipAttachPoint* B)
-{
-	if (A->IsAttachedToPoint(B))
-	{
-		check(B->IsAttachedToPoint(A));
-		A->DetachFromPoint();
-		B->DetachFromPoint();
-	}
-}
-
-//////////////////////////////////////////////////////////////////////////
 
 // Sets default values for this component's properties
 UShipAttachPoint::UShipAttachPoint()
-: OwningShipPart(nullptr)
-, bIsHighlighted(false)
-, AttachedToPoint(nullptr)
 {
-	bWantsBeginPlay = true;
 	PrimaryComponentTick.bCanEverTick = false;
 
-	DirectionArrow = CreateDefaultSubobject<UArrowComponent>(TEXT("Normal"));
-	DirectionArrow->SetupAttachment(this);
-	DirectionArrow->bHiddenInGame = false;
-	DirectionArrow->ArrowSize = 0.5f;
-
-	AttachPointSphere = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("AttachSphere"));
-	AttachPointSphere->SetupAttachment(this);
-	AttachPointSphere->SetCollisionEnabled(ECollisionEnabled::NoCollision);
-	AttachPointSphere->bHiddenInGame = false;
+	// Baked into the owning part, so cooked builds don't need them.
+	bIsEditorOnly = true;
 
-	// Load the sphere mesh.
-	static ConstructorHelpers::FObjectFinder<UStaticMesh> SphereVisualAsset(TEXT("/Engine/BasicShapes/Sphere.Sphere"));
-	if (SphereVisualAsset.Succeeded())
+#if WITH_EDITORONLY_DATA
+	DirectionArrow = CreateEditorOnlyDefaultSubobject<UArrowComponent>(TEXT("Normal"));
+	if (DirectionArrow)
 	{
-		AttachPointSphere->SetStaticMesh(SphereVisualAsset.Object);
-		AttachPointSphere->SetWorldScale3D({ 0.25f, 0.25f, 0.25f });
-	}
-
-	// Load the material instance for the sphere.
-	static ConstructorHelpers::FObjectFinder<UMaterialInstance> SphereMaterialAsset(TEXT("/Game/Materials/MATINST_AttachPointNode.MATINST_AttachPointNode"));
-	if (SphereMaterialAsset.Succeeded())
-	{
-		AttachPointSphere->SetMaterial(0, SphereMaterialAsset.Object);
+		DirectionArrow->SetupAttachment(this);
+		DirectionArrow->ArrowSize = 0.5f;
 	}
-}
-
-void UShipAttachPoint::InitializeComponent()
-{
-	Super::InitializeComponent();
+#endif
 }
 
 void UShipAttachPoint::PostInitProperties()
 {
 	Super::PostInitProperties();
 
-	// Use owner defaults if we have no compatible parts set.
-	// TODO: Move this somewhere that the changes get reflected in the editor.
-	OwningShipPart = Cast<AShipPart>(GetOwner());
-	if (OwningShipPart && CompatibleParts.Num() == 0)
-	{
-		CompatibleParts = OwningShipPart->GetDefaultCompatibleParts();
-	}
+#if WITH_EDITORONLY_DATA
+	UpdateCompatibleMask();
+#endif
 }
 
-void UShipAttachPoint::BeginPlay()
+void UShipAttachPoint::PostLoad()
 {
-	Super::BeginPlay();	
+	Super::PostLoad();
 
-	// Create a DMI of the sphere material so we can dynamically change the color param.
-	// Doing this in beginplay to avoid the material disappearing when hot-reloading.
-	if (!SphereDMI)
-	{
-		SphereDMI = AttachPointSphere->CreateAndSetMaterialInstanceDynamic(0);
-	}
+#if WITH_EDITORONLY_DATA
+	// Assets saved before the mask existed only have the array.
+	UpdateCompatibleMask();
+#endif
 }
 
-void UShipAttachPoint::TickComponent( float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction )
+#if WITH_EDITOR
+void UShipAttachPoint::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
 {
-	Super::TickComponent( DeltaTime, TickType, ThisTickFunction );
-}
+	Super::PostEditChangeProperty(PropertyChangedEvent);
 
-bool UShipAttachPoint::IsCompatibleWith(EPartType PartType) const
-{
-	return CompatibleParts.Contains(PartType);
+	if (PropertyChangedEvent.GetPropertyName() == GET_MEMBER_NAME_CHECKED(UShipAttachPoint, CompatibleParts))
+	{
+		UpdateCompatibleMask();
+	}
 }
+#endif
 
-bool UShipAttachPoint::IsAttached() const noexcept
+#if WITH_EDITORONLY_DATA
+void UShipAttachPoint::UpdateCompatibleMask()
 {
-	return (AttachedToPoint != nullptr);
+	CompatibleMask = FShipPartTypeMask(CompatibleParts);
 }
+#endif
 
-void UShipAttachPoint::AttachToPoint(UShipAttachPoint* PointToAttachTo)
+void UShipAttachPoint::OnComponentDestroyed(bool bDestroyingHierarchy)
 {
-	checkf(!IsAttached(), TEXT("Already attached to another point. Must detach first."));
-	AttachedToPoint = PointToAttachTo;
-	//UE_LOG(LogTemp, Log, TEXT("%s Attached to %s"), *GetNameSafe(this), *GetNameSafe(AttachedToPoint));
-
-	// Hide highlight, sphere and arrow once we've been attached to something.
-	if (bIsHighlighted)
+#if WITH_EDITORONLY_DATA
+	// The arrow would otherwise be left behind when the owning part strips its points.
+	if (DirectionArrow && !bDestroyingHierarchy)
 	{
-		SetHighlighted(false);
-		DirectionArrow->SetVisibility(false);
-		AttachPointSphere->SetVisibility(false);
+		DirectionArrow->DestroyComponent();
+		DirectionArrow = nullptr;
 	}
-}
+#endif
 
-void UShipAttachPoint::DetachFromPoint()
-{
-	//UE_LOG(LogTemp, Log, TEXT("%s Detatched from %s"), *GetNameSafe(this), *GetNameSafe(AttachedToPoint));
-	AttachedToPoint = nullptr;
-
-	// Show them again once we're free.
-	DirectionArrow->SetVisibility(true);
-	AttachPointSphere->SetVisibility(true);
-}
-
-bool UShipAttachPoint::IsAttachedToPoint(const UShipAttachPoint* OtherPoint) const noexcept
-{
-	return (AttachedToPoint != nullptr && AttachedToPoint == OtherPoint);
+	Super::OnComponentDestroyed(bDestroyingHierarchy);
 }
 
 FVector UShipAttachPoint::GetNormal() const
 {
-	checkf(GetComponentRotation() == DirectionArrow->GetComponentRotation(), L"Comp and arrow rots don't match");
 	return GetComponentRotation().Vector();
 }
-
-void UShipAttachPoint::SetHighlighted(bool bHighlighted)
-{
-	if (bHighlighted == bIsHighlighted || !ensureMsgf(SphereDMI != nullptr, L"SphereDMI not set"))
-	{
-		return;
-	}
-
-	// Change the color param to green or white depending on if we're highlighting or not.
-	// 'Color' param is exposed via the material instance.
-	const FLinearColor NewColor = bHighlighted ? FLinearColor::Green : FLinearColor::White;
-	SphereDMI->SetVectorParameterValue(TEXT("Color"), MoveTemp(NewColor));
-
-	bIsHighlighted = bHighlighted;
-}
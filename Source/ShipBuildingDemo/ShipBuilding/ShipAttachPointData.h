@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ShipBuildingTypes.h"
+#include "ShipAttachPointData.generated.h"
+
+class AShipPart;
+
+/**
+ *	A point on a ShipPart that other ShipParts can attach to, stored directly on the part rather than as a component.
+ *	The authored values are baked from the part's UShipAttachPoint components, which are only kept around for placing the points in the editor.
+ */
+USTRUCT()
+struct SHIPBUILDINGDEMO_API FShipAttachPointData
+{
+	GENERATED_BODY()
+
+	// Where the point is relative to its part.
+	UPROPERTY()
+	FTransform LocalTransform;
+
+	// Direction of the point's X axis relative to its part.
+	UPROPERTY()
+	FVector LocalNormal;
+
+	// The part types this point is compatible with.
+	UPROPERTY()
+	FShipPartTypeMask CompatibleMask;
+
+	// The part and index of the point this is attached to. Null if it's free.
+	// A property so the garbage collector sees it, and nulls it if the part is destroyed without being detached first.
+	UPROPERTY(Transient)
+	AShipPart* AttachedToPart;
+	int32 AttachedToIndex;
+
+	// Index of the point's marker in AShipAttachPointMarkers. INDEX_NONE if it doesn't have one.
+	int32 MarkerIndex;
+
+	// Is this point currently highlighted. Changes requested through AShipPart::SetPointHighlighted are applied at the end of the frame.
+	bool bHighlighted;
+
+	FShipAttachPointData()
+	: LocalTransform(FTransform::Identity)
+	, LocalNormal(FVector::ForwardVector)
+	, AttachedToPart(nullptr)
+	, AttachedToIndex(INDEX_NONE)
+	, MarkerIndex(INDEX_NONE)
+	, bHighlighted(false)
+	{
+	}
+
+	FORCEINLINE bool IsAttached() const { return (AttachedToPart != nullptr); }
+};
+
+/**
+ *	Handle to an attach point: the part it's on and its index in the part's AShipPart::GetAttachPoints.
+ *	Used wherever a single point is passed around. The accessors need the full AShipPart so they're defined in ShipPart.h.
+ */
+USTRUCT()
+struct SHIPBUILDINGDEMO_API FShipAttachPointRef
+{
+	GENERATED_BODY()
+
+	// A property so refs kept by UObjects are visible to the garbage collector.
+	UPROPERTY(Transient)
+	AShipPart* ShipPart;
+	int32 Index;
+
+	FShipAttachPointRef() : ShipPart(nullptr), Index(INDEX_NONE) {}
+	FShipAttachPointRef(AShipPart* InShipPart, int32 InIndex) : ShipPart(InShipPart), Index(InIndex) {}
+
+	FORCEINLINE bool IsValid() const { return (ShipPart != nullptr); }
+	FORCEINLINE bool operator==(const FShipAttachPointRef& Other) const { return (ShipPart == Other.ShipPart && Index == Other.Index); }
+	FORCEINLINE bool operator!=(const FShipAttachPointRef& Other) const { return !(*this == Other); }
+
+	// Arbitrary but consistent order. Used to visit each attached pair once and to compare sorted lists of points.
+	FORCEINLINE bool operator<(const FShipAttachPointRef& Other) const { return (ShipPart != Other.ShipPart) ? (ShipPart < Other.ShipPart) : (Index < Other.Index); }
+
+	friend FORCEINLINE uint32 GetTypeHash(const FShipAttachPointRef& Point) { return HashCombine(::GetTypeHash(Point.ShipPart), ::GetTypeHash(Point.Index)); }
+
+	FORCEINLINE AShipPart* GetOwningShipPart() const { return ShipPart; }
+	inline const FShipAttachPointData& GetData() const;
+	inline FVector GetLocation() const;
+	inline FVector GetNormal() const;
+	inline const FShipPartTypeMask& GetCompatibleParts() const;
+	inline bool IsAttached() const;
+	inline bool IsAttachedToPoint(const FShipAttachPointRef& OtherPoint) const;
+	inline FShipAttachPointRef GetAttachedToPoint() const;
+	inline AShipPart* GetAttachedToShipPart() const;
+	inline bool IsHighlighted() const;
+	inline void SetHighlighted(bool bHighlighted) const;
+};
@@ -0,0 +1,126 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipAttachPointGrid.h"
+#include "ShipPart.h"
+
+
+FShipAttachPointGrid::FShipAttachPointGrid(float InCellSize /*= 100.f*/)
+: CellSize(FMath::Max(InCellSize, 1.f))
+, InvCellSize(1.f / CellSize)
+{
+}
+
+void FShipAttachPointGrid::AddPoint(const FShipAttachPointRef& Point)
+{
+	check(Point.IsValid());
+	if (Point.IsAttached() || PointToCell.Contains(Point))
+	{
+		return;
+	}
+
+	const FVector Location = Point.GetLocation();
+	const FIntVector Cell = GetCell(Location);
+	Cells.FindOrAdd(Cell).Add({ Point, Location, Point.GetCompatibleParts(), FShipPartTypeMask{ Point.ShipPart->GetPartType() } });
+	PointToCell.Add(Point, Cell);
+}
+
+void FShipAttachPointGrid::RemovePoint(const FShipAttachPointRef& Point)
+{
+	FIntVector Cell;
+	if (!PointToCell.RemoveAndCopyValue(Point, Cell))
+	{
+		return;
+	}
+
+	TArray<FEntry>* Entries = Cells.Find(Cell);
+	if (ensureMsgf(Entries, TEXT("Point %d of %s is missing its grid cell"), Point.Index, *GetNameSafe(Point.ShipPart)))
+	{
+		const int32 Index = Entries->IndexOfByPredicate([&Point](const FEntry& Entry) { return Entry.Point == Point; });
+		if (Index != INDEX_NONE)
+		{
+			Entries->RemoveAtSwap(Index, 1, false);
+		}
+	}
+}
+
+void FShipAttachPointGrid::AddShipPart(AShipPart* ShipPart)
+{
+	check(ShipPart);
+	for (int32 PointIndex = 0; PointIndex < ShipPart->GetNumAttachPoints(); ++PointIndex)
+	{
+		AddPoint(FShipAttachPointRef(ShipPart, PointIndex));
+	}
+}
+
+void FShipAttachPointGrid::RemoveShipPart(AShipPart* ShipPart)
+{
+	check(ShipPart);
+	for (int32 PointIndex = 0; PointIndex < ShipPart->GetNumAttachPoints(); ++PointIndex)
+	{
+		RemovePoint(FShipAttachPointRef(ShipPart, PointIndex));
+	}
+}
+
+void FShipAttachPointGrid::QueryBox(const FBox& Box, TArray<FEntry>& OutEntries) const
+{
+	const FIntVector MinCell = GetCell(Box.Min);
+	const FIntVector MaxCell = GetCell(Box.Max);
+
+	// If the box covers more cells than there are occupied ones it's cheaper to just check them all.
+	const int64 NumCellsInBox = int64(MaxCell.X - MinCell.X + 1) * int64(MaxCell.Y - MinCell.Y + 1) * int64(MaxCell.Z - MinCell.Z + 1);
+	if (NumCellsInBox > Cells.Num())
+	{
+		for (const auto& Pair : Cells)
+		{
+			for (const FEntry& Entry : Pair.Value)
+			{
+				if (Box.IsInside(Entry.Location))
+				{
+					OutEntries.Add(Entry);
+				}
+			}
+		}
+		return;
+	}
+
+	for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+		{
+			for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+			{
+				const TArray<FEntry>* Entries = Cells.Find(FIntVector(X, Y, Z));
+				if (!Entries)
+				{
+					continue;
+				}
+
+				for (const FEntry& Entry : *Entries)
+				{
+					if (Box.IsInside(Entry.Location))
+					{
+						OutEntries.Add(Entry);
+					}
+				}
+			}
+		}
+	}
+}
+
+void FShipAttachPointGrid::Reset()
+{
+	for (auto& Pair : Cells)
+	{
+		ShipUtils::ClearArray(Pair.Value);
+	}
+	PointToCell.Empty(PointToCell.Num());
+}
+
+FIntVector FShipAttachPointGrid::GetCell(const FVector& Location) const
+{
+	return FIntVector(
+		FMath::FloorToInt(Location.X * InvCellSize),
+		FMath::FloorToInt(Location.Y * InvCellSize),
+		FMath::FloorToInt(Location.Z * InvCellSize));
+}
@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ShipAttachPointData.h"
+
+class AShipPart;
+
+/**
+ *	Uniform grid of all the attach points that aren't attached to anything, keyed by their world position.
+ *	Used to limit snapping queries to the points near the held part instead of every point on the ship.
+ *	The owner is responsible for keeping it current when parts are spawned, destroyed, attached, detached or moved.
+ */
+class SHIPBUILDINGDEMO_API FShipAttachPointGrid
+{
+public:
+	// A free point stored in a cell. Caches what the queries need so they don't have to touch the part.
+	struct FEntry
+	{
+		FShipAttachPointRef Point;
+		FVector Location;
+
+		// The types the point is compatible with, and the type of the part it belongs to.
+		FShipPartTypeMask CompatibleParts;
+		FShipPartTypeMask OwnerPartType;
+	};
+
+	explicit FShipAttachPointGrid(float InCellSize = 100.f);
+
+	/**
+	 *	Adds a point to the grid if it isn't already in it. Attached points are ignored.
+	 *
+	 *	@param Point: The point to add.
+	 */
+	void AddPoint(const FShipAttachPointRef& Point);
+
+	/**
+	 *	Removes a point from the grid if it's in it.
+	 *
+	 *	@param Point: The point to remove.
+	 */
+	void RemovePoint(const FShipAttachPointRef& Point);
+
+	// Add/Remove all the points on a ship part.
+	void AddShipPart(AShipPart* ShipPart);
+	void RemoveShipPart(AShipPart* ShipPart);
+
+	/**
+	 *	Gathers all the points inside a box.
+	 *
+	 *	@param Box: The world space box to search.
+	 *	@param OutEntries: The entries of the points inside the box. Not cleared before adding.
+	 */
+	void QueryBox(const FBox& Box, TArray<FEntry>& OutEntries) const;
+
+	// Removes all points but keeps the memory for the cells.
+	void Reset();
+
+	FORCEINLINE int32 Num() const { return PointToCell.Num(); }
+	FORCEINLINE bool Contains(const FShipAttachPointRef& Point) const { return PointToCell.Contains(Point); }
+	FORCEINLINE float GetCellSize() const { return CellSize; }
+
+private:
+	FIntVector GetCell(const FVector& Location) const;
+
+	// Size in uu of each cell along all axes.
+	float CellSize;
+	float InvCellSize;
+
+	// Points in each cell. Empty cells are kept around as parts tend to be moved back and forth over the same area.
+	TMap<FIntVector, TArray<FEntry>> Cells;
+
+	// The cell each point is currently stored in.
+	TMap<FShipAttachPointRef, FIntVector> PointToCell;
+};
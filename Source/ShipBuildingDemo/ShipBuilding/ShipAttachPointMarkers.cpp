@@ -0,0 +1,208 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipAttachPointMarkers.h"
+#include "ShipPart.h"
+
+const float AShipAttachPointMarkers::SphereSize = 25.f;
+const float AShipAttachPointMarkers::ArrowLength = 40.f;
+
+TWeakObjectPtr<AShipAttachPointMarkers> AShipAttachPointMarkers::CurrentMarkers;
+
+namespace
+{
+	UHierarchicalInstancedStaticMeshComponent* CreateMarkerInstances(AActor* Owner, FName Name, UStaticMesh* Mesh)
+	{
+		UHierarchicalInstancedStaticMeshComponent* Instances = Owner->CreateDefaultSubobject<UHierarchicalInstancedStaticMeshComponent>(Name);
+		Instances->SetupAttachment(Owner->GetRootComponent());
+		Instances->SetStaticMesh(Mesh);
+		Instances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		Instances->SetMobility(EComponentMobility::Movable);
+		Instances->bCastDynamicShadow = false;
+		Instances->CastShadow = false;
+		return Instances;
+	}
+}
+
+AShipAttachPointMarkers::AShipAttachPointMarkers()
+: NumDirtyMarkers(0)
+, bFlushScheduled(false)
+, SphereMaterial(nullptr)
+, HighlightedSphereMaterial(nullptr)
+{
+	// Flush after everything's moved for the frame. Only enabled on frames with something to flush, see ScheduleFlush.
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+
+	static ConstructorHelpers::FObjectFinder<UStaticMesh> SphereMeshAsset(TEXT("/Engine/BasicShapes/Sphere.Sphere"));
+	static ConstructorHelpers::FObjectFinder<UStaticMesh> ArrowMeshAsset(TEXT("/Engine/BasicShapes/Cone.Cone"));
+	static ConstructorHelpers::FObjectFinder<UMaterialInstance> SphereMaterialAsset(TEXT("/Game/Materials/MATINST_AttachPointNode.MATINST_AttachPointNode"));
+
+	SphereInstances = CreateMarkerInstances(this, TEXT("Spheres"), SphereMeshAsset.Object);
+	HighlightedSphereInstances = CreateMarkerInstances(this, TEXT("HighlightedSpheres"), SphereMeshAsset.Object);
+	ArrowInstances = CreateMarkerInstances(this, TEXT("Arrows"), ArrowMeshAsset.Object);
+
+	if (SphereMaterialAsset.Succeeded())
+	{
+		SphereInstances->SetMaterial(0, SphereMaterialAsset.Object);
+		HighlightedSphereInstances->SetMaterial(0, SphereMaterialAsset.Object);
+	}
+}
+
+void AShipAttachPointMarkers::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// One DMI per colour rather than one per point.
+	// 'Color' param is exposed via the material instance.
+	SphereMaterial = SphereInstances->CreateAndSetMaterialInstanceDynamic(0);
+	if (SphereMaterial)
+	{
+		SphereMaterial->SetVectorParameterValue(TEXT("Color"), FLinearColor::White);
+	}
+
+	HighlightedSphereMaterial = HighlightedSphereInstances->CreateAndSetMaterialInstanceDynamic(0);
+	if (HighlightedSphereMaterial)
+	{
+		HighlightedSphereMaterial->SetVectorParameterValue(TEXT("Color"), FLinearColor::Green);
+	}
+}
+
+void AShipAttachPointMarkers::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (NumDirtyMarkers > 0 || Highlights.Num() > 0)
+	{
+		FlushMarkers();
+	}
+
+	// Anything marked after this will schedule it again.
+	bFlushScheduled = false;
+	SetActorTickEnabled(false);
+}
+
+AShipAttachPointMarkers* AShipAttachPointMarkers::Get(UWorld* World)
+{
+	if (!World || !World->IsGameWorld())
+	{
+		return nullptr;
+	}
+
+	if (CurrentMarkers.IsValid() && CurrentMarkers->GetWorld() == World)
+	{
+		return CurrentMarkers.Get();
+	}
+
+	// Only the first lookup in each world has to search for them.
+	for (TActorIterator<AShipAttachPointMarkers> It(World); It; ++It)
+	{
+		if (!It->IsPendingKill())
+		{
+			CurrentMarkers = *It;
+			return *It;
+		}
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	CurrentMarkers = World->SpawnActor<AShipAttachPointMarkers>(SpawnParams);
+	return CurrentMarkers.Get();
+}
+
+int32 AShipAttachPointMarkers::AddMarker(const FShipAttachPointRef& AttachPoint)
+{
+	check(AttachPoint.IsValid());
+
+	int32 MarkerIndex = INDEX_NONE;
+	if (FreeMarkers.Num() > 0)
+	{
+		MarkerIndex = FreeMarkers.Pop(false);
+		MarkerPoints[MarkerIndex] = AttachPoint;
+	}
+	else
+	{
+		// New markers start hidden until they're flushed.
+		const FTransform Hidden{ FQuat::Identity, AttachPoint.GetLocation(), FVector::ZeroVector };
+		MarkerIndex = MarkerPoints.Add(AttachPoint);
+		SphereInstances->AddInstanceWorldSpace(Hidden);
+		HighlightedSphereInstances->AddInstanceWorldSpace(Hidden);
+		ArrowInstances->AddInstanceWorldSpace(Hidden);
+		DirtyMarkers.Add(false);
+	}
+
+	MarkDirty(MarkerIndex);
+	return MarkerIndex;
+}
+
+void AShipAttachPointMarkers::RemoveMarker(int32 MarkerIndex)
+{
+	check(MarkerPoints.IsValidIndex(MarkerIndex) && MarkerPoints[MarkerIndex].IsValid());
+	MarkerPoints[MarkerIndex] = FShipAttachPointRef();
+	FreeMarkers.Add(MarkerIndex);
+	Highlights.Cancel(MarkerIndex);
+
+	// Hides the instances when it's flushed.
+	MarkDirty(MarkerIndex);
+}
+
+void AShipAttachPointMarkers::FlushMarkers()
+{
+	// Marks the markers of any points that changed as dirty.
+	Highlights.Apply([this](int32 MarkerIndex, bool bHighlighted)
+	{
+		const FShipAttachPointRef& AttachPoint = MarkerPoints[MarkerIndex];
+		if (AttachPoint.IsValid())
+		{
+			AttachPoint.ShipPart->ApplyPointHighlight(AttachPoint.Index, bHighlighted);
+		}
+	});
+
+	if (NumDirtyMarkers == 0)
+	{
+		return;
+	}
+
+	for (TConstSetBitIterator<> It(DirtyMarkers); It; ++It)
+	{
+		const int32 MarkerIndex = It.GetIndex();
+		const FShipAttachPointRef& AttachPoint = MarkerPoints[MarkerIndex];
+		const FTransform Hidden{ FQuat::Identity, AttachPoint.IsValid() ? AttachPoint.GetLocation() : FVector::ZeroVector, FVector::ZeroVector };
+
+		// Markers are only shown for free points on parts that are in use.
+		const AShipPart* ShipPart = AttachPoint.GetOwningShipPart();
+		if (!ShipPart || ShipPart->bHidden || AttachPoint.IsAttached())
+		{
+			UpdateMarkerInstances(MarkerIndex, Hidden, Hidden, Hidden);
+			continue;
+		}
+
+		const FVector Location = AttachPoint.GetLocation();
+		const FVector Normal = AttachPoint.GetNormal();
+		const FTransform Sphere{ FQuat::Identity, Location, FVector(SphereSize / 100.f) };
+
+		// The cone mesh is 100uu tall, centered on its origin and points up Z.
+		const FQuat ArrowRotation = FRotationMatrix::MakeFromZ(Normal).ToQuat();
+		const FTransform Arrow{ ArrowRotation, Location + Normal * (ArrowLength * 0.5f), FVector(0.1f, 0.1f, ArrowLength / 100.f) };
+
+		const bool bHighlighted = AttachPoint.IsHighlighted();
+		UpdateMarkerInstances(MarkerIndex, bHighlighted ? Hidden : Sphere, bHighlighted ? Sphere : Hidden, Arrow);
+	}
+
+	DirtyMarkers.Init(false, DirtyMarkers.Num());
+	NumDirtyMarkers = 0;
+
+	SphereInstances->MarkRenderStateDirty();
+	HighlightedSphereInstances->MarkRenderStateDirty();
+	ArrowInstances->MarkRenderStateDirty();
+}
+
+void AShipAttachPointMarkers::UpdateMarkerInstances(int32 MarkerIndex, const FTransform& SphereTransform, const FTransform& HighlightedTransform, const FTransform& ArrowTransform)
+{
+	SphereInstances->UpdateInstanceTransform(MarkerIndex, SphereTransform, true, false, true);
+	HighlightedSphereInstances->UpdateInstanceTransform(MarkerIndex, HighlightedTransform, true, false, true);
+	ArrowInstances->UpdateInstanceTransform(MarkerIndex, ArrowTransform, true, false, true);
+}
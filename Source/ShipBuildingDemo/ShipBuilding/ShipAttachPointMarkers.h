@@ -0,0 +1,138 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/Actor.h"
+#include "ShipAttachPointData.h"
+#include "ShipHighlightBatch.h"
+#include "ShipAttachPointMarkers.generated.h"
+class UHierarchicalInstancedStaticMeshComponent;
+
+/**
+ *	Draws the sphere and arrow of every attach point in the world as instances of a few instanced meshes, rather than each point having its own components and DMI.
+ *	Parts mark their points' markers dirty when they move, attach/detach or are highlighted, and the instances of all the dirty markers are updated in one batch at the end of the frame.
+ *	Each point keeps the same instance index in every mesh; markers that aren't shown are scaled to zero rather than removed so the indices never change.
+ *	Highlighted spheres are instances of a second sphere mesh using the highlight material, so highlighting only moves the instance between meshes.
+ *	Highlight changes are batched as well and applied just before the markers are flushed.
+ *	This is the only per-frame update for the parts, and it only ticks on frames where something has changed.
+ */
+UCLASS(NotPlaceable, Transient)
+class SHIPBUILDINGDEMO_API AShipAttachPointMarkers : public AActor
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	UHierarchicalInstancedStaticMeshComponent* SphereInstances;
+
+	UPROPERTY()
+	UHierarchicalInstancedStaticMeshComponent* HighlightedSphereInstances;
+
+	UPROPERTY()
+	UHierarchicalInstancedStaticMeshComponent* ArrowInstances;
+
+	// The point each marker is for. Invalid if the marker is free. Parts remove their markers when they're destroyed.
+	UPROPERTY(Transient)
+	TArray<FShipAttachPointRef> MarkerPoints;
+
+	// Markers that need their instances updated.
+	TBitArray<> DirtyMarkers;
+	int32 NumDirtyMarkers;
+
+	// Markers that can be reused.
+	TArray<int32> FreeMarkers;
+
+	// Highlight changes requested since the last flush.
+	FShipHighlightBatch Highlights;
+
+	// Is the tick enabled to flush the markers this frame.
+	bool bFlushScheduled;
+
+public:
+	AShipAttachPointMarkers();
+
+	// Begin AActor Interface.
+	void BeginPlay() override;
+	void Tick(float DeltaSeconds) override;
+	// End AActor Interface.
+
+	/**
+	 *	Gets the markers for a world, spawning them if they don't exist yet.
+	 *
+	 *	@param World: The world the attach points are in.
+	 *	@return: The markers or nullptr if the world isn't a game world.
+	 */
+	static AShipAttachPointMarkers* Get(UWorld* World);
+
+	/**
+	 *	Adds a marker for a point.
+	 *
+	 *	@param AttachPoint: The point to draw.
+	 *	@return: The index of the point's marker.
+	 */
+	int32 AddMarker(const FShipAttachPointRef& AttachPoint);
+
+	/**
+	 *	Hides a point's marker and frees it up for another point.
+	 *
+	 *	@param MarkerIndex: The index from AddMarker.
+	 */
+	void RemoveMarker(int32 MarkerIndex);
+
+	/**
+	 *	Flags a marker to be updated from its point at the end of the frame.
+	 *
+	 *	@param MarkerIndex: The index from AddMarker.
+	 */
+	FORCEINLINE void MarkDirty(int32 MarkerIndex)
+	{
+		if (!DirtyMarkers[MarkerIndex])
+		{
+			DirtyMarkers[MarkerIndex] = true;
+			++NumDirtyMarkers;
+			ScheduleFlush();
+		}
+	}
+
+	/**
+	 *	Requests a point's highlight state, to be applied with the rest at the end of the frame.
+	 *
+	 *	@param MarkerIndex: The index from AddMarker.
+	 *	@param bHighlighted: If the point should be highlighted.
+	 */
+	FORCEINLINE void RequestHighlight(int32 MarkerIndex, bool bHighlighted)
+	{
+		Highlights.Request(MarkerIndex, bHighlighted);
+		ScheduleFlush();
+	}
+
+	// Applies the requested highlights then updates the instances of all the dirty markers.
+	void FlushMarkers();
+
+	// Size of the sphere and length of the arrow in uu.
+	static const float SphereSize;
+	static const float ArrowLength;
+
+private:
+	// Enables the tick so the markers get flushed at the end of the frame. It's disabled again once there's nothing left to flush.
+	FORCEINLINE void ScheduleFlush()
+	{
+		if (!bFlushScheduled)
+		{
+			bFlushScheduled = true;
+			SetActorTickEnabled(true);
+		}
+	}
+
+	// Sets the transforms of a marker's instances in each mesh, without updating the render state.
+	void UpdateMarkerInstances(int32 MarkerIndex, const FTransform& SphereTransform, const FTransform& HighlightedTransform, const FTransform& ArrowTransform);
+
+	// Colour of the sphere materials.
+	UPROPERTY(Transient)
+	class UMaterialInstanceDynamic* SphereMaterial;
+
+	UPROPERTY(Transient)
+	class UMaterialInstanceDynamic* HighlightedSphereMaterial;
+
+	// The markers for the world most recently asked for.
+	static TWeakObjectPtr<AShipAttachPointMarkers> CurrentMarkers;
+};
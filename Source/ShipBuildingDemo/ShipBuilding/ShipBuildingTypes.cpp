@@ -1,2 +1,24 @@
 #include "ShipBuildingDemo.h"
-#include "ShipBuildingTypes.h"
\ No newline at end of file
+#include "ShipBuildingTypes.h"
+
+FShipPartTypeMask::FShipPartTypeMask(const TArray<EPartType>& PartTypes)
+: Bits(0)
+{
+	for (const EPartType PartType : PartTypes)
+	{
+		Add(PartType);
+	}
+}
+
+TArray<EPartType> FShipPartTypeMask::ToArray() const
+{
+	TArray<EPartType> PartTypes;
+	for (int32 i = 0; i < ShipPartTypes::MaxPartTypes; ++i)
+	{
+		if (Bits & (uint64(1) << i))
+		{
+			PartTypes.Add(EPartType(i));
+		}
+	}
+	return PartTypes;
+}
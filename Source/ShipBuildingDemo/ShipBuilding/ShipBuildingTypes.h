@@ -13,3 +13,50 @@ enum class EPartType : uint8
 	PT_Accessory	UMETA(DisplayName = "Accessory"), // Antenna etc.
 	PT_MAX
 };
+
+namespace ShipPartTypes
+{
+	// Max number of part types a FShipPartTypeMask can hold. EPartType can grow until it reaches this.
+	static const int32 MaxPartTypes = 64;
+
+	// Gets the dense ID of a part type, which is its bit index in FShipPartTypeMask.
+	FORCEINLINE int32 GetTypeId(EPartType PartType) { return (int32)PartType; }
+}
+
+static_assert((int32)EPartType::PT_MAX <= ShipPartTypes::MaxPartTypes, "EPartType has outgrown FShipPartTypeMask.");
+
+/**
+ *	Fixed size bitset of part types, indexed by the part type ID.
+ *	Used for compatibility checks so they're a single AND rather than searching an array.
+ */
+USTRUCT()
+struct SHIPBUILDINGDEMO_API FShipPartTypeMask
+{
+	GENERATED_BODY()
+
+	FShipPartTypeMask() : Bits(0) {}
+	explicit FShipPartTypeMask(EPartType PartType) : Bits(MakeBit(PartType)) {}
+	explicit FShipPartTypeMask(const TArray<EPartType>& PartTypes);
+
+	FORCEINLINE void Add(EPartType PartType) { Bits |= MakeBit(PartType); }
+	FORCEINLINE void Remove(EPartType PartType) { Bits &= ~MakeBit(PartType); }
+	FORCEINLINE bool Contains(EPartType PartType) const { return (Bits & MakeBit(PartType)) != 0; }
+	FORCEINLINE bool Intersects(const FShipPartTypeMask& Other) const { return (Bits & Other.Bits) != 0; }
+	FORCEINLINE bool IsEmpty() const { return Bits == 0; }
+	FORCEINLINE uint64 GetBits() const { return Bits; }
+
+	// Gets the part types in the mask. Only intended for UI/debugging.
+	TArray<EPartType> ToArray() const;
+
+	FORCEINLINE bool operator==(const FShipPartTypeMask& Other) const { return Bits == Other.Bits; }
+	FORCEINLINE bool operator!=(const FShipPartTypeMask& Other) const { return Bits != Other.Bits; }
+
+	// Binary serialization for custom file formats.
+	friend FArchive& operator<<(FArchive& Ar, FShipPartTypeMask& Mask) { return Ar << Mask.Bits; }
+
+private:
+	FORCEINLINE static uint64 MakeBit(EPartType PartType) { return uint64(1) << ShipPartTypes::GetTypeId(PartType); }
+
+	UPROPERTY()
+	uint64 Bits;
+};
@@ -0,0 +1,183 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipCompatibilityCache.h"
+#include "ShipPart.h"
+
+DECLARE_LOG_CATEGORY_CLASS(LogShipCompatibilityCache, Log, All);
+
+namespace
+{
+	// Orders entries so two caches can be compared regardless of the order pairs were added in.
+	static bool EntryLess(const FShipCompatibilityCache::FEntry& A, const FShipCompatibilityCache::FEntry& B)
+	{
+		return (A.OwnedPoint != B.OwnedPoint) ? (A.OwnedPoint < B.OwnedPoint) : (A.OtherPoint < B.OtherPoint);
+	}
+}
+
+FShipCompatibilityCache::FShipCompatibilityCache()
+: QueryBox(ForceInit)
+, bSnapCandidatesDirty(true)
+{
+}
+
+void FShipCompatibilityCache::Reset(const FShipPartGroup& InHeldGroup, const FBox& InQueryBox, TArray<FEntry>&& InEntries)
+{
+	check(InHeldGroup.IsValid());
+	HeldGroup = InHeldGroup;
+	QueryBox = InQueryBox;
+	Entries = MoveTemp(InEntries);
+	bSnapCandidatesDirty = true;
+}
+
+void FShipCompatibilityCache::Invalidate()
+{
+	HeldGroup.Reset();
+	QueryBox.Init();
+	ShipUtils::ClearArray(Entries);
+	bSnapCandidatesDirty = true;
+}
+
+bool FShipCompatibilityCache::IsValidFor(const AShipPart* InShipPart, const FBox& RequiredBox) const
+{
+	return (IsValid() && !HeldGroup.IsGroup() && HeldGroup.GetShipPart() == InShipPart && QueryBox.IsInside(RequiredBox));
+}
+
+int32 FShipCompatibilityCache::AddFreePoint(const FShipAttachPointRef& Point)
+{
+	check(Point.IsValid());
+	if (!IsValid() || Point.IsAttached() || HeldGroup.Contains(Point.GetOwningShipPart()) || !QueryBox.IsInside(Point.GetLocation()))
+	{
+		return 0;
+	}
+
+	int32 NumAdded = 0;
+	for (const FShipAttachPointRef& AttachPoint : HeldGroup.GetPoints())
+	{
+		if (IsCompatiblePair(AttachPoint, Point))
+		{
+			Entries.Add({ AttachPoint, Point });
+			++NumAdded;
+		}
+	}
+
+	bSnapCandidatesDirty |= (NumAdded > 0);
+	return NumAdded;
+}
+
+void FShipCompatibilityCache::RemoveFreePoint(const FShipAttachPointRef& Point)
+{
+	// The held points are kept regardless of whether they're attached.
+	if (!IsValid() || HeldGroup.Contains(Point.GetOwningShipPart()))
+	{
+		return;
+	}
+
+	const int32 NumRemoved = Entries.RemoveAllSwap([&Point](const FEntry& Entry) { return Entry.OtherPoint == Point; }, false);
+	bSnapCandidatesDirty |= (NumRemoved > 0);
+}
+
+int32 FShipCompatibilityCache::AddShipPart(AShipPart* InShipPart)
+{
+	check(InShipPart);
+	int32 NumAdded = 0;
+	for (int32 PointIndex = 0; PointIndex < InShipPart->GetNumAttachPoints(); ++PointIndex)
+	{
+		NumAdded += AddFreePoint(FShipAttachPointRef(InShipPart, PointIndex));
+	}
+	return NumAdded;
+}
+
+void FShipCompatibilityCache::RemoveShipPart(AShipPart* InShipPart)
+{
+	if (HeldGroup.Contains(InShipPart))
+	{
+		Invalidate();
+		return;
+	}
+
+	for (int32 PointIndex = 0; PointIndex < InShipPart->GetNumAttachPoints(); ++PointIndex)
+	{
+		RemoveFreePoint(FShipAttachPointRef(InShipPart, PointIndex));
+	}
+}
+
+bool FShipCompatibilityCache::Validate(const TArray<AShipPart*>& ShipParts) const
+{
+	if (!IsValid())
+	{
+		return true;
+	}
+
+	// Same as collecting from the grid, but brute force through every part so it doesn't rely on anything else being up to date.
+	TArray<FEntry> Expected;
+	for (AShipPart* OtherPart : ShipParts)
+	{
+		if (HeldGroup.Contains(OtherPart))
+		{
+			continue;
+		}
+
+		for (int32 PointIndex = 0; PointIndex < OtherPart->GetNumAttachPoints(); ++PointIndex)
+		{
+			const FShipAttachPointRef OtherPoint(OtherPart, PointIndex);
+			if (OtherPoint.IsAttached() || !QueryBox.IsInside(OtherPoint.GetLocation()))
+			{
+				continue;
+			}
+
+			for (const FShipAttachPointRef& AttachPoint : HeldGroup.GetPoints())
+			{
+				if (IsCompatiblePair(AttachPoint, OtherPoint))
+				{
+					Expected.Add({ AttachPoint, OtherPoint });
+				}
+			}
+		}
+	}
+
+	TArray<FEntry> Actual = Entries;
+	Expected.Sort(&EntryLess);
+	Actual.Sort(&EntryLess);
+
+	bool bMatches = (Expected.Num() == Actual.Num());
+	for (int32 i = 0; bMatches && i < Actual.Num(); ++i)
+	{
+		bMatches = (Expected[i].OwnedPoint == Actual[i].OwnedPoint && Expected[i].OtherPoint == Actual[i].OtherPoint);
+	}
+
+	if (!bMatches)
+	{
+		UE_LOG(LogShipCompatibilityCache, Error, TEXT("Compatibility cache for %s is out of date. Cached %d pairs, full recompute found %d."),
+			*GetNameSafe(HeldGroup.GetShipPart()), Actual.Num(), Expected.Num());
+	}
+	return bMatches;
+}
+
+bool FShipCompatibilityCache::IsCompatiblePair(const FShipAttachPointRef& OwnedPoint, const FShipAttachPointRef& OtherPoint)
+{
+	const FShipPartTypeMask OwnedPartType{ OwnedPoint.ShipPart->GetPartType() };
+	const FShipPartTypeMask OtherPartType{ OtherPoint.ShipPart->GetPartType() };
+	if (!OtherPoint.GetCompatibleParts().Intersects(OwnedPartType) || !OwnedPoint.GetCompatibleParts().Intersects(OtherPartType))
+	{
+		return false;
+	}
+
+	// If the normals aren't within the allowed range then ignore them.
+	const float Dot = FVector::DotProduct(OwnedPoint.GetNormal(), OtherPoint.GetNormal());
+	return FMath::IsNearlyEqual(Dot, -1.f, THRESH_NORMALS_ARE_PARALLEL);
+}
+
+const FShipSnapCandidates& FShipCompatibilityCache::GetSnapCandidates()
+{
+	if (bSnapCandidatesDirty && IsValid())
+	{
+		SnapCandidates.Reset(HeldGroup);
+		for (const FEntry& Entry : Entries)
+		{
+			SnapCandidates.Add(Entry.OwnedPoint, Entry.OtherPoint);
+		}
+		bSnapCandidatesDirty = false;
+	}
+	return SnapCandidates;
+}
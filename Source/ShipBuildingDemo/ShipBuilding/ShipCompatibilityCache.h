@@ -0,0 +1,106 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ShipSnapCandidates.h"
+#include "ShipPartGroup.h"
+
+class AShipPart;
+
+/**
+ *	Pairs of points that a ship part (or group of parts being moved together) could snap to within an area around it.
+ *	Persists after the part is released and is updated as points are attached, detached, spawned and destroyed, so grabbing the same part again doesn't need a re-collect.
+ */
+class SHIPBUILDINGDEMO_API FShipCompatibilityCache
+{
+public:
+	struct FEntry
+	{
+		FShipAttachPointRef OwnedPoint;
+		FShipAttachPointRef OtherPoint;
+
+		bool IsValid() const noexcept { return (OwnedPoint.IsValid() && OtherPoint.IsValid()); }
+	};
+
+	FShipCompatibilityCache();
+
+	/**
+	 *	Replaces the contents of the cache with a full collection of pairs.
+	 *
+	 *	@param InHeldGroup: The part(s) the pairs were collected for.
+	 *	@param InQueryBox: The area the pairs were collected from.
+	 *	@param InEntries: The collected pairs.
+	 */
+	void Reset(const FShipPartGroup& InHeldGroup, const FBox& InQueryBox, TArray<FEntry>&& InEntries);
+
+	// Empties the cache so it isn't valid for any part.
+	void Invalidate();
+
+	/**
+	 *	Checks if the cache can be used for a single part without re-collecting.
+	 *
+	 *	@param InShipPart: The part to check.
+	 *	@param RequiredBox: The area the pairs need to cover.
+	 *	@return: True if the cache was collected for just the part and covers the area.
+	 */
+	bool IsValidFor(const AShipPart* InShipPart, const FBox& RequiredBox) const;
+
+	/**
+	 *	Adds pairs for a point that has just become free (spawned or detached).
+	 *	Does nothing if the point belongs to the cached part(s) or is outside of the area.
+	 *
+	 *	@param Point: The free point.
+	 *	@return: The number of pairs added. New pairs are always added to the end.
+	 */
+	int32 AddFreePoint(const FShipAttachPointRef& Point);
+
+	/**
+	 *	Removes any pairs with a point that is no longer free (attached or destroyed).
+	 *
+	 *	@param Point: The point to remove.
+	 */
+	void RemoveFreePoint(const FShipAttachPointRef& Point);
+
+	// Add/Remove the free points of a whole part. Removing a cached part invalidates the cache.
+	int32 AddShipPart(AShipPart* InShipPart);
+	void RemoveShipPart(AShipPart* InShipPart);
+
+	/**
+	 *	Compares the cache against a full recompute from every part. Used for debugging the incremental updates.
+	 *
+	 *	@param ShipParts: All the parts of the ship.
+	 *	@return: True if the cache matches.
+	 */
+	bool Validate(const TArray<AShipPart*>& ShipParts) const;
+
+	/**
+	 *	Checks if two points could be snapped together, ignoring where they are.
+	 *
+	 *	@param OwnedPoint: A point on the part being moved.
+	 *	@param OtherPoint: A point on another part.
+	 *	@return: True if the part types are compatible both ways and the normals face each other.
+	 */
+	static bool IsCompatiblePair(const FShipAttachPointRef& OwnedPoint, const FShipAttachPointRef& OtherPoint);
+
+	// Gets the snapshot of the pairs used for finding points to snap. Rebuilt if the pairs have changed.
+	const FShipSnapCandidates& GetSnapCandidates();
+
+	FORCEINLINE bool IsValid() const noexcept { return HeldGroup.IsValid(); }
+	FORCEINLINE AShipPart* GetShipPart() const noexcept { return HeldGroup.GetShipPart(); }
+	FORCEINLINE const FShipPartGroup& GetHeldGroup() const noexcept { return HeldGroup; }
+	FORCEINLINE const FBox& GetQueryBox() const noexcept { return QueryBox; }
+	FORCEINLINE const TArray<FEntry>& GetEntries() const noexcept { return Entries; }
+
+private:
+	// The part(s) the cache was collected for.
+	FShipPartGroup HeldGroup;
+
+	// The area the pairs were collected from.
+	FBox QueryBox;
+
+	TArray<FEntry> Entries;
+
+	// Snapshot of Entries, indices match.
+	FShipSnapCandidates SnapCandidates;
+	bool bSnapCandidatesDirty;
+};
@@ -0,0 +1,36 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipHighlightBatch.h"
+
+
+FShipHighlightBatch::FShipHighlightBatch()
+: NumRequested(0)
+{
+}
+
+void FShipHighlightBatch::Request(int32 MarkerIndex, bool bHighlighted)
+{
+	check(MarkerIndex >= 0);
+	while (Requested.Num() <= MarkerIndex)
+	{
+		Requested.Add(false);
+		States.Add(false);
+	}
+
+	if (!Requested[MarkerIndex])
+	{
+		Requested[MarkerIndex] = true;
+		++NumRequested;
+	}
+	States[MarkerIndex] = bHighlighted;
+}
+
+void FShipHighlightBatch::Cancel(int32 MarkerIndex)
+{
+	if (MarkerIndex < Requested.Num() && Requested[MarkerIndex])
+	{
+		Requested[MarkerIndex] = false;
+		--NumRequested;
+	}
+}
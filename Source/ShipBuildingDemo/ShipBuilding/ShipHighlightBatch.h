@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/**
+ *	Highlight changes for attach points, collected over a frame and applied together. Points are identified by their marker index.
+ *	A point is only stored once however many times it's requested (ie. when it's in several snapping pairs), with the last request winning,
+ *	so applying the batch touches each point at most once.
+ */
+class SHIPBUILDINGDEMO_API FShipHighlightBatch
+{
+public:
+	FShipHighlightBatch();
+
+	/**
+	 *	Requests a point's highlight state. Replaces any earlier request for the same point.
+	 *
+	 *	@param MarkerIndex: The marker index of the point.
+	 *	@param bHighlighted: The state to apply.
+	 */
+	void Request(int32 MarkerIndex, bool bHighlighted);
+
+	// Drops any request for a point, ie. when its marker is removed.
+	void Cancel(int32 MarkerIndex);
+
+	/**
+	 *	Calls a function with each requested point and state, then clears the requests.
+	 *
+	 *	@param Func: Called as Func(int32 MarkerIndex, bool bHighlighted) once per requested point, in index order.
+	 */
+	template<typename FunctorType>
+	void Apply(FunctorType&& Func)
+	{
+		if (NumRequested == 0)
+		{
+			return;
+		}
+
+		for (TConstSetBitIterator<> It(Requested); It; ++It)
+		{
+			const int32 MarkerIndex = It.GetIndex();
+			Func(MarkerIndex, (bool)States[MarkerIndex]);
+		}
+
+		Requested.Init(false, Requested.Num());
+		NumRequested = 0;
+	}
+
+	FORCEINLINE int32 Num() const { return NumRequested; }
+
+private:
+	// Which points have a request, and the state requested for each. Indexed by marker index.
+	TBitArray<> Requested;
+	TBitArray<> States;
+	int32 NumRequested;
+};
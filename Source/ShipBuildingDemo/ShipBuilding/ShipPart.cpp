@@ -3,14 +3,188 @@
 #include "ShipBuildingDemo.h"
 #include "ShipPart.h"
 #include "ShipAttachPoint.h"
+#include "ShipAttachPointMarkers.h"
+#include "ShipPartInstances.h"
 
+#if WITH_EDITOR
+#include "Engine/BlueprintGeneratedClass.h"
+#include "Engine/SimpleConstructionScript.h"
+#include "Engine/SCS_Node.h"
+#endif
+
+FOnShipAttachPointsChanged AShipPart::OnPointsAttached;
+FOnShipAttachPointsChanged AShipPart::OnPointsDetached;
+
+void AShipPart::AttachPointPair(const FShipAttachPointRef& A, const FShipAttachPointRef& B)
+{
+	RestoreAttachment(A, B);
+	OnPointsAttached.Broadcast(A, B);
+}
+
+void AShipPart::RestoreAttachment(const FShipAttachPointRef& A, const FShipAttachPointRef& B)
+{
+	check(A.IsValid() && B.IsValid());
+	FShipAttachPointData& DataA = A.ShipPart->AttachPoints[A.Index];
+	FShipAttachPointData& DataB = B.ShipPart->AttachPoints[B.Index];
+	checkf(!DataA.IsAttached() && !DataB.IsAttached(), TEXT("Already attached to another point. Must detach first."));
+
+	DataA.AttachedToPart = B.ShipPart;
+	DataA.AttachedToIndex = B.Index;
+	DataB.AttachedToPart = A.ShipPart;
+	DataB.AttachedToIndex = A.Index;
+
+	// Hide highlight, sphere and arrow once we've been attached to something.
+	A.ShipPart->SetPointHighlighted(A.Index, false);
+	B.ShipPart->SetPointHighlighted(B.Index, false);
+	A.ShipPart->MarkPointMarkerDirty(A.Index);
+	B.ShipPart->MarkPointMarkerDirty(B.Index);
+}
+
+void AShipPart::DetachPointPair(const FShipAttachPointRef& A, const FShipAttachPointRef& B)
+{
+	if (A.IsAttachedToPoint(B))
+	{
+		check(B.IsAttachedToPoint(A));
+		A.ShipPart->UnlinkPoint(A.Index);
+		B.ShipPart->UnlinkPoint(B.Index);
+		OnPointsDetached.Broadcast(A, B);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
 
 // Sets default values
 AShipPart::AShipPart()
 : ShipPartMesh(nullptr)
+, AssemblyIndex(INDEX_NONE)
+, bIsPooled(false)
+, InstanceClassIndex(INDEX_NONE)
+, InstanceIndex(INDEX_NONE)
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
+	// Parts don't need to do anything per frame; marker and highlight updates are batched by AShipAttachPointMarkers.
+	// Blueprints that need Tick can still enable it.
 	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+}
+
+void AShipPart::PostInitProperties()
+{
+	Super::PostInitProperties();
+
+#if WITH_EDITORONLY_DATA
+	// Must be set before any attach points are created as they copy it.
+	UpdateDefaultCompatibleMask();
+#endif
+}
+
+void AShipPart::PostLoad()
+{
+	Super::PostLoad();
+
+#if WITH_EDITORONLY_DATA
+	// Assets saved before the mask existed only have the array.
+	UpdateDefaultCompatibleMask();
+#endif
+}
+
+#if WITH_EDITOR
+void AShipPart::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	if (PropertyChangedEvent.GetPropertyName() == GET_MEMBER_NAME_CHECKED(AShipPart, DefaultCompatibleParts))
+	{
+		UpdateDefaultCompatibleMask();
+	}
+}
+#endif
+
+#if WITH_EDITORONLY_DATA
+void AShipPart::UpdateDefaultCompatibleMask()
+{
+	DefaultCompatibleMask = FShipPartTypeMask(DefaultCompatibleParts);
+}
+#endif
+
+#if WITH_EDITOR
+void AShipPart::PreSave(const class ITargetPlatform* TargetPlatform)
+{
+	Super::PreSave(TargetPlatform);
+
+	// Blueprint components only exist as templates until the part is spawned, so the class defaults are baked from those.
+	// Cooked builds don't load the point components at all and rely on this.
+	if (HasAnyFlags(RF_ClassDefaultObject))
+	{
+		BakeAttachPointTemplates();
+	}
+}
+
+void AShipPart::BakeAttachPointTemplates()
+{
+	// Parent blueprints' components are created first, so bake them first to match the order of the spawned components.
+	TArray<const UBlueprintGeneratedClass*> BlueprintClasses;
+	for (const UClass* Class = GetClass(); Class; Class = Class->GetSuperClass())
+	{
+		if (const UBlueprintGeneratedClass* BlueprintClass = Cast<UBlueprintGeneratedClass>(Class))
+		{
+			BlueprintClasses.Insert(BlueprintClass, 0);
+		}
+	}
+
+	TArray<UShipAttachPoint*> Templates;
+	TArray<FTransform> TemplateTransforms;
+	for (const UBlueprintGeneratedClass* BlueprintClass : BlueprintClasses)
+	{
+		USimpleConstructionScript* SCS = BlueprintClass->SimpleConstructionScript;
+		if (!SCS)
+		{
+			continue;
+		}
+
+		// All nodes are listed depth first, the same order the construction script creates them in.
+		for (USCS_Node* Node : SCS->GetAllNodes())
+		{
+			UShipAttachPoint* Template = Cast<UShipAttachPoint>(Node->ComponentTemplate);
+			if (!Template)
+			{
+				continue;
+			}
+
+			// Accumulate up to, but not including, the root node whose transform is replaced by the part's.
+			// NOTE: components attached to a parent blueprint's component are treated as if they're attached to the root.
+			FTransform Transform = Template->GetRelativeTransform();
+			for (USCS_Node* Parent = SCS->FindParentNode(Node); Parent && SCS->FindParentNode(Parent); Parent = SCS->FindParentNode(Parent))
+			{
+				if (const USceneComponent* ParentTemplate = Cast<USceneComponent>(Parent->ComponentTemplate))
+				{
+					Transform = Transform * ParentTemplate->GetRelativeTransform();
+				}
+			}
+
+			Templates.Add(Template);
+			TemplateTransforms.Add(Transform);
+		}
+	}
+
+	BakeAttachPoints(Templates, TemplateTransforms);
+}
+#endif
+
+void AShipPart::BakeAttachPoints(const TArray<UShipAttachPoint*>& Components, const TArray<FTransform>& ComponentTransforms)
+{
+	check(Components.Num() == ComponentTransforms.Num());
+
+	AttachPoints.Reset(Components.Num());
+	for (int32 i = 0; i < Components.Num(); ++i)
+	{
+		FShipAttachPointData& Point = AttachPoints[AttachPoints.AddDefaulted()];
+		Point.LocalTransform = ComponentTransforms[i];
+		Point.LocalNormal = ComponentTransforms[i].GetUnitAxis(EAxis::X);
+
+		// Use our defaults if the point has no compatible parts set.
+		const FShipPartTypeMask& CompatibleMask = Components[i]->GetCompatibleParts();
+		Point.CompatibleMask = CompatibleMask.IsEmpty() ? DefaultCompatibleMask : CompatibleMask;
+	}
 }
 
 void AShipPart::PostInitializeComponents()
@@ -24,23 +198,83 @@ void AShipPart::PostInitializeComponents()
 		ShipPartMesh->SetCollisionResponseToChannel(ECC_Camera, ECR_Ignore);
 	}
 
-	// Store the attach point components.
-	auto Components = GetComponentsByClass(UShipAttachPoint::StaticClass());
-	AttachPoints.Reserve(Components.Num());
-	for (auto* Component : Components)
+	// Editor builds still have the attach point components, so re-bake in case they've changed since the class was saved.
+	TArray<UShipAttachPoint*> Components;
+	GetComponents(Components);
+	if (Components.Num() > 0)
 	{
-		AttachPoints.Add(Cast<UShipAttachPoint>(Component));
+		TArray<FTransform> ComponentTransforms;
+		ComponentTransforms.Reserve(Components.Num());
+		for (const UShipAttachPoint* Component : Components)
+		{
+			ComponentTransforms.Add(Component->GetComponentToWorld().GetRelativeTransform(GetActorTransform()));
+		}
+		BakeAttachPoints(Components, ComponentTransforms);
+
+		// Nothing uses them in game.
+		UWorld* World = GetWorld();
+		if (World && World->IsGameWorld())
+		{
+			for (UShipAttachPoint* Component : Components)
+			{
+				Component->DestroyComponent();
+			}
+		}
 	}
 }
 
 void AShipPart::BeginPlay()
 {
 	Super::BeginPlay();
+
+	Markers = AShipAttachPointMarkers::Get(GetWorld());
+	if (Markers.IsValid())
+	{
+		for (int32 PointIndex = 0; PointIndex < AttachPoints.Num(); ++PointIndex)
+		{
+			AttachPoints[PointIndex].MarkerIndex = Markers->AddMarker(FShipAttachPointRef(this, PointIndex));
+		}
+	}
+
+	if (USceneComponent* Root = GetRootComponent())
+	{
+		Root->TransformUpdated.AddUObject(this, &AShipPart::HandleRootTransformUpdated);
+	}
 }
 
-void AShipPart::Tick(float DeltaTime)
+void AShipPart::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	Super::Tick(DeltaTime);
+	if (USceneComponent* Root = GetRootComponent())
+	{
+		Root->TransformUpdated.RemoveAll(this);
+	}
+
+	// The markers may have already gone if the whole world is being torn down.
+	for (FShipAttachPointData& Point : AttachPoints)
+	{
+		if (Markers.IsValid() && Point.MarkerIndex != INDEX_NONE)
+		{
+			Markers->RemoveMarker(Point.MarkerIndex);
+		}
+		Point.MarkerIndex = INDEX_NONE;
+	}
+	Markers.Reset();
+
+	// Don't leave an instance behind for a part that's gone.
+	if (!IsMaterialized() && PartInstances.IsValid())
+	{
+		PartInstances->RemovePart(this);
+	}
+	InstanceClassIndex = INDEX_NONE;
+	InstanceIndex = INDEX_NONE;
+	PartInstances.Reset();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AShipPart::HandleRootTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	MarkPointMarkersDirty();
 }
 
 void AShipPart::Select()
@@ -58,52 +292,201 @@ void AShipPart::Deselect()
 
 bool AShipPart::IsAttached() const noexcept
 {
-	return AttachPoints.ContainsByPredicate([](UShipAttachPoint* P) { return P->IsAttached(); });
+	return AttachPoints.ContainsByPredicate([](const FShipAttachPointData& P) { return P.IsAttached(); });
 }
 
 void AShipPart::DetatchAllPoints()
 {
-	for (auto* AttachPoint : AttachPoints)
+	for (int32 PointIndex = 0; PointIndex < AttachPoints.Num(); ++PointIndex)
+	{
+		const FShipAttachPointRef AttachPoint(this, PointIndex);
+		if (AttachPoint.IsAttached())
+		{
+			const FShipAttachPointRef AttachedTo = AttachPoint.GetAttachedToPoint();
+			DetachPointPair(AttachPoint, AttachedTo);
+			UE_LOG(LogTemp, Log, TEXT("Detaching %s point %d from %s point %d"), *GetNameSafe(this), PointIndex, *GetNameSafe(AttachedTo.ShipPart), AttachedTo.Index);
+		}
+	}
+}
+
+void AShipPart::Deactivate()
+{
+	ensureMsgf(AssemblyIndex == INDEX_NONE, TEXT("%s is being pooled while still in an assembly graph."), *GetNameSafe(this));
+
+	// Pooled parts are hidden through their own mesh.
+	Materialize();
+
+	// Any parts this is still attached to are being pooled along with it, so just clear the links.
+	for (int32 PointIndex = 0; PointIndex < AttachPoints.Num(); ++PointIndex)
+	{
+		SetPointHighlighted(PointIndex, false);
+		UnlinkPoint(PointIndex);
+	}
+
+	// In case it was being dragged along with another part.
+	DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+
+	ResetSaveGameProperties();
+
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+	SetActorTickEnabled(false);
+	bIsPooled = true;
+
+	// Hidden parts don't get markers, see AShipAttachPointMarkers::FlushMarkers.
+	MarkPointMarkersDirty();
+}
+
+void AShipPart::ResetSaveGameProperties()
+{
+	const UObject* Defaults = GetClass()->GetDefaultObject();
+	for (TFieldIterator<UProperty> It(GetClass()); It; ++It)
 	{
-		if (AttachPoint->IsAttached())
+		// Instanced objects (ie. components) belong to this part, so they can't be shared with the defaults.
+		const UProperty* Property = *It;
+		if (Property->HasAnyPropertyFlags(CPF_SaveGame) && !Property->HasAnyPropertyFlags(CPF_InstancedReference | CPF_ContainsInstancedReference))
 		{
-			auto* AttachedTo = AttachPoint->GetAttachedToPoint();
-			AttachPoint->DetachFromPoint();
-			AttachedTo->DetachFromPoint();
-			UE_LOG(LogTemp, Log, TEXT("Detaching %s from %s"), *GetNameSafe(AttachPoint), *GetNameSafe(AttachedTo));
+			Property->CopyCompleteValue_InContainer(this, Defaults);
 		}
 	}
 }
 
+void AShipPart::Reactivate(const FTransform& Transform)
+{
+	check(bIsPooled);
+	SetActorTransform(Transform, false, nullptr, ETeleportType::TeleportPhysics);
+	SetActorHiddenInGame(false);
+	SetActorEnableCollision(true);
+	SetActorTickEnabled(PrimaryActorTick.bStartWithTickEnabled);
+	bIsPooled = false;
+
+	MarkPointMarkersDirty();
+}
+
+bool AShipPart::Dematerialize()
+{
+	if (!IsMaterialized())
+	{
+		return true;
+	}
+
+	// Parts being dragged along with another part move every frame, so they're not worth instancing.
+	if (bIsPooled || !ShipPartMesh || !ShipPartMesh->StaticMesh || GetAttachParentActor())
+	{
+		return false;
+	}
+
+	PartInstances = AShipPartInstances::Get(GetWorld());
+	if (!PartInstances.IsValid() || !PartInstances->AddPart(this))
+	{
+		return false;
+	}
+
+	ShipPartMesh->UnregisterComponent();
+	return true;
+}
+
+void AShipPart::Materialize()
+{
+	if (IsMaterialized())
+	{
+		return;
+	}
+
+	// Register before freeing the instance so the part is never missing for a frame.
+	ShipPartMesh->RegisterComponent();
+	if (PartInstances.IsValid())
+	{
+		PartInstances->RemovePart(this);
+	}
+	InstanceClassIndex = INDEX_NONE;
+	InstanceIndex = INDEX_NONE;
+}
+
 void AShipPart::SetAllPointsHighlighted(bool bHighlighted)
 {
-	for (auto* AttachPoint : AttachPoints)
+	for (int32 PointIndex = 0; PointIndex < AttachPoints.Num(); ++PointIndex)
+	{
+		SetPointHighlighted(PointIndex, bHighlighted);
+	}
+}
+
+void AShipPart::SetPointHighlighted(int32 PointIndex, bool bHighlighted)
+{
+	// Points without a marker have nothing to draw, so there's no need to wait.
+	const int32 MarkerIndex = AttachPoints[PointIndex].MarkerIndex;
+	if (MarkerIndex != INDEX_NONE && Markers.IsValid())
 	{
-		AttachPoint->SetHighlighted(bHighlighted);
+		Markers->RequestHighlight(MarkerIndex, bHighlighted);
 	}
+	else
+	{
+		ApplyPointHighlight(PointIndex, bHighlighted);
+	}
+}
+
+void AShipPart::ApplyPointHighlight(int32 PointIndex, bool bHighlighted)
+{
+	FShipAttachPointData& Point = AttachPoints[PointIndex];
+	if (bHighlighted == Point.bHighlighted)
+	{
+		return;
+	}
+
+	// The markers move the sphere to the green or white instances when they're flushed.
+	Point.bHighlighted = bHighlighted;
+	MarkPointMarkerDirty(PointIndex);
+}
+
+void AShipPart::MarkPointMarkersDirty()
+{
+	for (int32 PointIndex = 0; PointIndex < AttachPoints.Num(); ++PointIndex)
+	{
+		MarkPointMarkerDirty(PointIndex);
+	}
+}
+
+void AShipPart::MarkPointMarkerDirty(int32 PointIndex)
+{
+	const int32 MarkerIndex = AttachPoints[PointIndex].MarkerIndex;
+	if (MarkerIndex != INDEX_NONE && Markers.IsValid())
+	{
+		Markers->MarkDirty(MarkerIndex);
+	}
+}
+
+void AShipPart::UnlinkPoint(int32 PointIndex)
+{
+	FShipAttachPointData& Point = AttachPoints[PointIndex];
+	Point.AttachedToPart = nullptr;
+	Point.AttachedToIndex = INDEX_NONE;
+
+	// Show the marker again once we're free.
+	MarkPointMarkerDirty(PointIndex);
 }
 
-TArray<UShipAttachPoint*> AShipPart::GetPointsCompatibleWith(EPartType Type) const
+TArray<FShipAttachPointRef> AShipPart::GetPointsCompatibleWith(EPartType Type)
 {
-	TArray<UShipAttachPoint*> Points;
-	for (auto* AttachPoint : AttachPoints)
+	TArray<FShipAttachPointRef> Points;
+	for (int32 PointIndex = 0; PointIndex < AttachPoints.Num(); ++PointIndex)
 	{
-		if (!AttachPoint->IsAttached() && AttachPoint->IsCompatibleWith(Type))
+		const FShipAttachPointData& AttachPoint = AttachPoints[PointIndex];
+		if (!AttachPoint.IsAttached() && AttachPoint.CompatibleMask.Contains(Type))
 		{
-			Points.Add(AttachPoint);
+			Points.Emplace(this, PointIndex);
 		}
 	}
 	return Points;
 }
 
-TArray<UShipAttachPoint*> AShipPart::GetAvailableAttachPoints() const
+TArray<FShipAttachPointRef> AShipPart::GetAvailableAttachPoints()
 {
-	TArray<UShipAttachPoint*> Points;
-	for (auto* AttachPoint : AttachPoints)
+	TArray<FShipAttachPointRef> Points;
+	for (int32 PointIndex = 0; PointIndex < AttachPoints.Num(); ++PointIndex)
 	{
-		if (!AttachPoint->IsAttached())
+		if (!AttachPoints[PointIndex].IsAttached())
 		{
-			Points.Add(AttachPoint);
+			Points.Emplace(this, PointIndex);
 		}
 	}
 	return Points;
@@ -4,10 +4,14 @@
 
 #include "GameFramework/Actor.h"
 #include "ShipBuildingTypes.h"
+#include "ShipAttachPointData.h"
 #include "ShipPart.generated.h"
 
 class UShipAttachPoint;
 
+// Broadcast when two points are attached to or detached from each other.
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnShipAttachPointsChanged, const FShipAttachPointRef& /*A*/, const FShipAttachPointRef& /*B*/);
+
 /**
  * Base class for all ship parts. This class is what the blueprints for new ship parts is based on. This manages it's attach points, static mesh, and part type.
  */
@@ -16,22 +20,44 @@ class SHIPBUILDINGDEMO_API AShipPart : public AActor
 {
 	GENERATED_BODY()
 
-	// Cached attach point components
-	UPROPERTY(Transient)
-	TArray<UShipAttachPoint*> AttachPoints;
+	// The part's attach points. Baked from the UShipAttachPoint components, which are removed once the part is spawned in game.
+	UPROPERTY()
+	TArray<FShipAttachPointData> AttachPoints;
+
+	// Where the attach points' spheres and arrows are drawn.
+	TWeakObjectPtr<class AShipAttachPointMarkers> Markers;
 
 	// Cached mesh component
 	UPROPERTY(Transient)
 	UStaticMeshComponent* ShipPartMesh;
 
+	// Index of this part in the assembly graph it belongs to. INDEX_NONE if it isn't in one.
+	int32 AssemblyIndex;
+	friend class FShipAssemblyGraph;
+
+	// Is this part sitting in a UShipPartPool.
+	bool bIsPooled;
+
+	// Where the part is drawn while it's dematerialized. The indices are INDEX_NONE while it has its own mesh.
+	TWeakObjectPtr<class AShipPartInstances> PartInstances;
+	int32 InstanceClassIndex;
+	int32 InstanceIndex;
+	friend class AShipPartInstances;
+
 protected:
 	// The type of part. TODO: make config or SaveGame depending on how we serialize the parts.
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="PartSettings")
 	EPartType PartType;
 
+#if WITH_EDITORONLY_DATA
 	// What other parts this part is compatible with. Attach components will use this as the default configuration.
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="PartSettings")
+	UPROPERTY(EditAnywhere, Category="PartSettings")
 	TArray<EPartType> DefaultCompatibleParts;
+#endif
+
+	// Packed version of DefaultCompatibleParts that's handed to the attach points.
+	UPROPERTY()
+	FShipPartTypeMask DefaultCompatibleMask;
 
 	// How close in uu the point must be to another valid point before they snap together.
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, AdvancedDisplay, Category="PartSettings")
@@ -41,20 +67,62 @@ public:
 	AShipPart();
 
 	// Begin AActor Interface.
+	void PostInitProperties() override;
+	void PostLoad() override;
+#if WITH_EDITOR
+	void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+	void PreSave(const class ITargetPlatform* TargetPlatform) override;
+#endif
 	void PostInitializeComponents() override;
 	void BeginPlay() override;
-	void Tick(float DeltaSeconds) override;
+	void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	// End AActor Interface.
 
 	void Select();
 	void Deselect();
 
+	static void AttachPointPair(const FShipAttachPointRef& A, const FShipAttachPointRef& B);
+	static void DetachPointPair(const FShipAttachPointRef& A, const FShipAttachPointRef& B);
+
+	// Links two points like AttachPointPair but without firing OnPointsAttached. Used when restoring saved ships, where anything tracking the points is built afterwards.
+	static void RestoreAttachment(const FShipAttachPointRef& A, const FShipAttachPointRef& B);
+
+	// Events fired after AttachPointPair/DetachPointPair link or unlink two points.
+	// Used to keep anything indexing the free points (ie. the snapping grid) up to date.
+	static FOnShipAttachPointsChanged OnPointsAttached;
+	static FOnShipAttachPointsChanged OnPointsDetached;
+
 	// Returns true if any of this part's attach points are attached to anything
 	bool IsAttached() const noexcept;
 
 	// Detatches from any other ship parts
 	void DetatchAllPoints();
 
+	/**
+	 *	Puts the part to sleep when it's returned to the pool: hidden, no collision and no ticking, with its attach points and saved properties reset.
+	 *	Attach points are reset without firing the detach events, so the part must already be removed from anything tracking them.
+	 */
+	void Deactivate();
+
+	/**
+	 *	Wakes the part back up when it's taken from the pool.
+	 *
+	 *	@param Transform: Where to put the part.
+	 */
+	void Reactivate(const FTransform& Transform);
+
+	/**
+	 *	Hands the part's mesh over to AShipPartInstances so it's drawn as an instance, and unregisters its own mesh component.
+	 *	Used for parts that aren't being edited so that large ships don't pay for a render and physics state per part.
+	 *	The part must not move while it's dematerialized; call Materialize first.
+	 *
+	 *	@return: True if the part is now drawn as an instance.
+	 */
+	bool Dematerialize();
+
+	// Gives the part its own mesh component back, ie. when it's picked up. Does nothing if it's already materialized.
+	void Materialize();
+
 	/**
 	 *	Enables/Disables highlighting on all attach points associated with this part.
 	 *
@@ -62,24 +130,100 @@ public:
 	 */
 	void SetAllPointsHighlighted(bool bHighlighted);
 
+	/**
+	 *	Changes a point's sphere color to indicate it's highlighted.
+	 *	The change is batched with the rest and applied at the end of the frame, so the point's state doesn't change straight away.
+	 *
+	 *	@param PointIndex: The index of the point.
+	 *	@param bHighlighted: if we should enable or disable highlighting.
+	 */
+	void SetPointHighlighted(int32 PointIndex, bool bHighlighted);
+
+	// Sets a point's highlight state immediately. Used by AShipAttachPointMarkers to apply the batched highlights.
+	void ApplyPointHighlight(int32 PointIndex, bool bHighlighted);
+
+	// Flags all the points' markers to be redrawn, ie. when the part moves or is hidden or shown.
+	void MarkPointMarkersDirty();
+
 	/**
 	 *	Gets all attach points that aren't attached to anything and are compatible with the given type.
 	 *
 	 *	@Type: The part type to check for compatibility with.
 	 *	@return: A list of this part's attach points that are compatible with the type.
 	 */
-	TArray<UShipAttachPoint*> GetPointsCompatibleWith(EPartType Type) const;
+	TArray<FShipAttachPointRef> GetPointsCompatibleWith(EPartType Type);
 
 	/**
 	 *	Gets all attach points that aren't attached to anything.
 	 */
-	TArray<UShipAttachPoint*> GetAvailableAttachPoints() const;
+	TArray<FShipAttachPointRef> GetAvailableAttachPoints();
+
+	// World space location and normal (the direction of its X axis) of a point.
+	FORCEINLINE FVector GetPointLocation(int32 PointIndex) const { return GetActorTransform().TransformPosition(AttachPoints[PointIndex].LocalTransform.GetLocation()); }
+	FORCEINLINE FVector GetPointNormal(int32 PointIndex) const { return GetActorQuat().RotateVector(AttachPoints[PointIndex].LocalNormal); }
 
 	// Accessors
 	FORCEINLINE EPartType GetPartType() const { return PartType; }
-	FORCEINLINE TArray<EPartType> GetDefaultCompatibleParts() const { return DefaultCompatibleParts; }
-	FORCEINLINE TArray<UShipAttachPoint*>& GetAttachPoints() { return AttachPoints; }
-	FORCEINLINE const TArray<UShipAttachPoint*>& GetAttachPoints() const { return AttachPoints; }
+	FORCEINLINE const FShipPartTypeMask& GetDefaultCompatibleMask() const { return DefaultCompatibleMask; }
+	FORCEINLINE const TArray<FShipAttachPointData>& GetAttachPoints() const { return AttachPoints; }
+	FORCEINLINE int32 GetNumAttachPoints() const { return AttachPoints.Num(); }
 	FORCEINLINE float GetMinSnapDistance() const { return MinSnapDistance; }
+	FORCEINLINE int32 GetAssemblyIndex() const { return AssemblyIndex; }
+	FORCEINLINE bool IsPooled() const { return bIsPooled; }
+	FORCEINLINE bool IsMaterialized() const { return (InstanceIndex == INDEX_NONE); }
+	FORCEINLINE UStaticMeshComponent* GetShipPartMesh() const { return ShipPartMesh; }
 	FORCEINLINE FBoxSphereBounds GetSnapBounds() const { return ShipPartMesh->Bounds.ExpandBy(MinSnapDistance); }
+
+private:
+#if WITH_EDITORONLY_DATA
+	// Bakes the authored DefaultCompatibleParts into DefaultCompatibleMask.
+	void UpdateDefaultCompatibleMask();
+#endif
+
+#if WITH_EDITOR
+	// Bakes AttachPoints on the class defaults from the blueprint's attach point component templates.
+	void BakeAttachPointTemplates();
+#endif
+
+	/**
+	 *	Replaces AttachPoints with the values of a set of attach point components.
+	 *
+	 *	@param Components: The components, in the order they were created.
+	 *	@param ComponentTransforms: The transform of each component relative to the part.
+	 */
+	void BakeAttachPoints(const TArray<UShipAttachPoint*>& Components, const TArray<FTransform>& ComponentTransforms);
+
+	/**
+	 *	Copies the SaveGame properties back from the class defaults so a pooled part doesn't carry state over from its last use.
+	 *	Loading only writes the properties that differ from the defaults, so anything left over would end up in the loaded ship.
+	 */
+	void ResetSaveGameProperties();
+
+	// Clears a point's link to the point it's attached to and flags its marker.
+	void UnlinkPoint(int32 PointIndex);
+
+	// Flags a point's marker to be redrawn at the end of the frame.
+	void MarkPointMarkerDirty(int32 PointIndex);
+
+	// Redraws the markers when the part is moved, including when it's moved along with a part it's attached to.
+	void HandleRootTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
 };
+
+//////////////////////////////////////////////////////////////////////////
+// FShipAttachPointRef
+
+inline const FShipAttachPointData& FShipAttachPointRef::GetData() const { return ShipPart->GetAttachPoints()[Index]; }
+inline FVector FShipAttachPointRef::GetLocation() const { return ShipPart->GetPointLocation(Index); }
+inline FVector FShipAttachPointRef::GetNormal() const { return ShipPart->GetPointNormal(Index); }
+inline const FShipPartTypeMask& FShipAttachPointRef::GetCompatibleParts() const { return GetData().CompatibleMask; }
+inline bool FShipAttachPointRef::IsAttached() const { return GetData().IsAttached(); }
+inline FShipAttachPointRef FShipAttachPointRef::GetAttachedToPoint() const { return FShipAttachPointRef(GetData().AttachedToPart, GetData().AttachedToIndex); }
+inline AShipPart* FShipAttachPointRef::GetAttachedToShipPart() const { return GetData().AttachedToPart; }
+inline bool FShipAttachPointRef::IsHighlighted() const { return GetData().bHighlighted; }
+inline void FShipAttachPointRef::SetHighlighted(bool bHighlighted) const { ShipPart->SetPointHighlighted(Index, bHighlighted); }
+
+inline bool FShipAttachPointRef::IsAttachedToPoint(const FShipAttachPointRef& OtherPoint) const
+{
+	const FShipAttachPointData& Data = GetData();
+	return (Data.AttachedToPart != nullptr && Data.AttachedToPart == OtherPoint.ShipPart && Data.AttachedToIndex == OtherPoint.Index);
+}
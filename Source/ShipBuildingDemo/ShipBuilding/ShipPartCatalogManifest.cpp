@@ -0,0 +1,113 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipPartCatalogManifest.h"
+
+DECLARE_LOG_CATEGORY_CLASS(LogShipPartCatalogManifest, Log, All);
+
+const uint32 FShipPartCatalogManifest::Magic = 0x53504346; // 'SPCF'
+const uint32 FShipPartCatalogManifest::Version = 1;
+
+FArchive& operator<<(FArchive& Ar, FShipPartCatalogManifest::FEntry& Entry)
+{
+	// Names are written as strings as FName indices aren't stable between runs.
+	FString Name = Entry.Name.ToString();
+	uint8 PartType = (uint8)Entry.PartType;
+	uint8 bCompatiblePartsKnown = Entry.bCompatiblePartsKnown ? 1 : 0;
+
+	Ar << Name << PartType << Entry.ClassPath << Entry.CompatibleParts << bCompatiblePartsKnown;
+
+	if (Ar.IsLoading())
+	{
+		Entry.Name = *Name;
+		Entry.PartType = (PartType <= (uint8)EPartType::PT_MAX) ? (EPartType)PartType : EPartType::PT_MAX;
+		Entry.bCompatiblePartsKnown = (bCompatiblePartsKnown != 0);
+	}
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FShipPartCatalogManifest& Manifest)
+{
+	return Ar << Manifest.SourceHash << Manifest.Entries;
+}
+
+bool FShipPartCatalogManifest::Load(const FString& Filename)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *Filename, FILEREAD_Silent))
+	{
+		return false;
+	}
+
+	FMemoryReader Reader{ Bytes, true };
+	uint32 FileMagic = 0;
+	uint32 FileVersion = 0;
+	Reader << FileMagic << FileVersion;
+	if (FileMagic != Magic || FileVersion != Version)
+	{
+		UE_LOG(LogShipPartCatalogManifest, Log, TEXT("Ignoring ship part manifest %s as it's from a different version."), *Filename);
+		return false;
+	}
+
+	Reader << *this;
+	if (Reader.IsError())
+	{
+		UE_LOG(LogShipPartCatalogManifest, Warning, TEXT("Ship part manifest %s is corrupt."), *Filename);
+		Entries.Empty();
+		return false;
+	}
+	return true;
+}
+
+bool FShipPartCatalogManifest::Save(const FString& Filename) const
+{
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer{ Bytes, true };
+	uint32 FileMagic = Magic;
+	uint32 FileVersion = Version;
+	Writer << FileMagic << FileVersion;
+	Writer << const_cast<FShipPartCatalogManifest&>(*this);
+
+	if (!FFileHelper::SaveArrayToFile(Bytes, *Filename))
+	{
+		UE_LOG(LogShipPartCatalogManifest, Warning, TEXT("Failed to write ship part manifest %s."), *Filename);
+		return false;
+	}
+	return true;
+}
+
+uint32 FShipPartCatalogManifest::ComputeSourceHash(const FString& RootShipPartPath)
+{
+	struct FStatVisitor : public IPlatformFile::FDirectoryStatVisitor
+	{
+		TArray<FString> Lines;
+
+		bool Visit(const TCHAR* FilenameOrDirectory, const FFileStatData& StatData) final
+		{
+			if (!StatData.bIsDirectory)
+			{
+				Lines.Add(FString::Printf(TEXT("%s|%lld|%s"), FilenameOrDirectory, StatData.FileSize, *StatData.ModificationTime.ToString()));
+			}
+			return true;
+		}
+	};
+
+	const FString ContentDir = FPackageName::LongPackageNameToFilename(RootShipPartPath / TEXT(""));
+	FStatVisitor Visitor;
+	FPlatformFileManager::Get().GetPlatformFile().IterateDirectoryStatRecursively(*ContentDir, Visitor);
+
+	// Directory iteration order isn't guaranteed.
+	Visitor.Lines.Sort();
+
+	uint32 Hash = FCrc::StrCrc32(*RootShipPartPath, Version);
+	for (const FString& Line : Visitor.Lines)
+	{
+		Hash = FCrc::StrCrc32(*Line, Hash);
+	}
+	return Hash;
+}
+
+FString FShipPartCatalogManifest::GetDefaultFilename()
+{
+	return FPaths::Combine(*FPaths::GameSavedDir(), TEXT("ShipPartCatalog.bin"));
+}
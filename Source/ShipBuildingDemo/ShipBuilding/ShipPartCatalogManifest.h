@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ShipBuildingTypes.h"
+
+/**
+ *	Compact binary cache of the ship part catalog so UShipPartFactory::Init doesn't need to scan the asset registry on every launch.
+ *	Stamped with a hash of the ship part content files so it can tell when it's stale.
+ */
+struct SHIPBUILDINGDEMO_API FShipPartCatalogManifest
+{
+	struct FEntry
+	{
+		// Clean name of the part.
+		FName Name;
+
+		EPartType PartType;
+
+		// Object path of the part's generated class.
+		FString ClassPath;
+
+		// Only meaningful if bCompatiblePartsKnown is set, as it comes from the class which may not have been loaded when the manifest was written.
+		FShipPartTypeMask CompatibleParts;
+		bool bCompatiblePartsKnown;
+
+		friend FArchive& operator<<(FArchive& Ar, FEntry& Entry);
+	};
+
+	// Hash of the content the manifest was built from. See ComputeSourceHash.
+	uint32 SourceHash = 0;
+
+	TArray<FEntry> Entries;
+
+	/**
+	 *	Reads the manifest from disk.
+	 *
+	 *	@param Filename: The file to read.
+	 *	@return: True if the file exists and is a manifest of the current version.
+	 */
+	bool Load(const FString& Filename);
+
+	/**
+	 *	Writes the manifest to disk.
+	 *
+	 *	@param Filename: The file to write.
+	 *	@return: True if it was written successfully.
+	 */
+	bool Save(const FString& Filename) const;
+
+	/**
+	 *	Hashes the names, sizes and timestamps of the files under a content path. Only stats the files rather than loading anything.
+	 *
+	 *	@param RootShipPartPath: The path to the root ship part directory, relative to /Game (ie. /Game/ShipParts).
+	 *	@return: The hash, which changes if any part is added, removed or re-saved.
+	 */
+	static uint32 ComputeSourceHash(const FString& RootShipPartPath);
+
+	// Where the manifest is cached.
+	static FString GetDefaultFilename();
+
+	friend FArchive& operator<<(FArchive& Ar, FShipPartCatalogManifest& Manifest);
+
+private:
+	// Identifies the file and its layout. Bump the version when changing what's serialized.
+	static const uint32 Magic;
+	static const uint32 Version;
+};
@@ -3,6 +3,8 @@
 #include "ShipBuildingDemo.h"
 #include "ShipPartFactory.h"
 #include "ShipPart.h"
+#include "ShipPartPool.h"
+#include "ShipPartCatalogManifest.h"
 
 DECLARE_LOG_CATEGORY_CLASS(LogShipPartFactory, Log, All);
 
@@ -31,46 +33,93 @@ namespace
 const FString FShipPartData::Prefix = "BLU_";
 
 FShipPartData::FShipPartData(const FAssetData& Data)
-: AssetData(Data)
 {
-	FullName = Data.AssetName;
-
 	// Verify asset name
-	if (!FullName.ToString().StartsWith(Prefix))
+	if (!Data.AssetName.ToString().StartsWith(Prefix))
 	{
-		UE_LOG(LogShipPartFactory, Warning, TEXT("Asset name for ship part %s does not contain the prefix: %s."), *FullName.ToString(), *Prefix);
+		UE_LOG(LogShipPartFactory, Warning, TEXT("Asset name for ship part %s does not contain the prefix: %s."), *Data.AssetName.ToString(), *Prefix);
 	}
-}
 
-FString FShipPartData::GetGeneratedClassName(const FShipPartData& ShipPartData)
-{
 	// We need the generated class name as it's the fully qualified name for the part.
 	// This is the only way I know of to get the actual class of a blueprint to spawn it since Data.GetClass() just returns UBlueprint.
+	// The tag is in export text form (ie. BlueprintGeneratedClass'/Game/...'), so strip the class name and quotes.
 	FString GeneratedClassName;
-	ShipPartData.AssetData.GetTagValue("GeneratedClass", GeneratedClassName);
-	return GeneratedClassName;
+	Data.GetTagValue("GeneratedClass", GeneratedClassName);
+	ClassReference = FStringAssetReference(FPackageName::ExportTextPathToObjectPath(GeneratedClassName));
 }
 
 //////////////////////////////////////////////////////////////////////////
 
 UShipPartFactory::UShipPartFactory()
-: bAssetDataLoaded(false)
+: ShipPartLibrary(nullptr)
+, NumClassesToPreload(0)
+, NumClassesPreloaded(0)
+, ManifestSourceHash(0)
+, bManifestDirty(false)
+, bAssetDataLoaded(false)
 {
+	ShipPartPool = CreateDefaultSubobject<UShipPartPool>(TEXT("ShipPartPool"));
 }
 
-void UShipPartFactory::Init(const FString& RootShipPartPath)
+void UShipPartFactory::Init(const FString& RootShipPartPath, bool bPreloadClasses /*= false*/)
 {
 	if (bAssetDataLoaded)
 	{
 		return;
 	}
 
+	SCOPE_CYCLE_COUNTER(STAT_ShipPartFactoryInit);
+	PartsByType.SetNum((int32)EPartType::PT_MAX + 1);
+	PartsCompatibleWithType.SetNum((int32)EPartType::PT_MAX);
+
+	// Use the cached manifest if nothing has changed since it was written, otherwise fall back to scanning for the parts.
+	ManifestSourceHash = FShipPartCatalogManifest::ComputeSourceHash(RootShipPartPath);
+	FShipPartCatalogManifest Manifest;
+	if (Manifest.Load(FShipPartCatalogManifest::GetDefaultFilename()) && Manifest.SourceHash == ManifestSourceHash)
+	{
+		LoadCatalogFromManifest(Manifest);
+		bManifestDirty = false;
+	}
+	else
+	{
+		UE_LOG(LogShipPartFactory, Log, TEXT("Ship part manifest is missing or out of date, scanning %s."), *RootShipPartPath);
+		LoadCatalogFromAssetRegistry(RootShipPartPath);
+		bManifestDirty = true;
+	}
+
+	if (ShipPartData.Num() == 0)
+	{
+		UE_LOG(LogShipPartFactory, Warning, TEXT("No ship parts were loaded."));
+		return;
+	}
+
+	bAssetDataLoaded = true;
+	SaveManifestIfDirty();
+
+	if (bPreloadClasses)
+	{
+		// Request each class separately so progress can be tracked as they come in.
+		for (const FShipPartData& Data : ShipPartData)
+		{
+			if (!Data.ClassReference.IsValid())
+			{
+				UE_LOG(LogShipPartFactory, Warning, TEXT("Can't preload part %s as it has no generated class."), *Data.Name.ToString());
+				continue;
+			}
+
+			++NumClassesToPreload;
+			StreamableManager.RequestAsyncLoad(Data.ClassReference, FStreamableDelegate::CreateUObject(this, &UShipPartFactory::OnShipPartClassPreloaded, Data.Name));
+		}
+	}
+}
+
+void UShipPartFactory::LoadCatalogFromAssetRegistry(const FString& RootShipPartPath)
+{
 	// Create an object library for the ship parts and load the asset data for all of them.
 	ShipPartLibrary = UObjectLibrary::CreateLibrary(AShipPart::StaticClass(), true, false);
 	const int32 NumLoaded = ShipPartLibrary->LoadBlueprintAssetDataFromPath(RootShipPartPath);
 	if (NumLoaded == 0)
 	{
-		UE_LOG(LogShipPartFactory, Warning, TEXT("No ship parts were loaded."));
 		return;
 	}
 
@@ -79,6 +128,7 @@ void UShipPartFactory::Init(const FString& RootShipPartPath)
 	TArray<FAssetData> ShipPartAssetData;
 	ShipPartLibrary->GetAssetDataList(ShipPartAssetData);
 	ShipPartData.Reserve(NumLoaded);
+	PartIndices.Reserve(NumLoaded);
 	for (const FAssetData& Data : ShipPartAssetData)
 	{
 		FShipPartData PartData{ Data };
@@ -88,35 +138,118 @@ void UShipPartFactory::Init(const FString& RootShipPartPath)
 		const FString Path = DirName(Data.ObjectPath.ToString());
 		PartData.PartType = ShipPartPaths.Contains(Path) ? ShipPartPaths[Path] : EPartType::PT_MAX;
 
-		ShipPartData.Add(MoveTemp(PartData));
+		if (PartIndices.Contains(PartData.Name))
+		{
+			UE_LOG(LogShipPartFactory, Warning, TEXT("Found more than one ship part named %s, ignoring %s."), *PartData.Name.ToString(), *Data.ObjectPath.ToString());
+			continue;
+		}
+		AddShipPartData(MoveTemp(PartData));
 	}
 
-	bAssetDataLoaded = true;
+	// The asset data has been copied out so the library doesn't need to hang on to it.
+	ShipPartLibrary->ClearLoaded();
+}
+
+void UShipPartFactory::LoadCatalogFromManifest(const FShipPartCatalogManifest& Manifest)
+{
+	ShipPartData.Reserve(Manifest.Entries.Num());
+	PartIndices.Reserve(Manifest.Entries.Num());
+	for (const FShipPartCatalogManifest::FEntry& Entry : Manifest.Entries)
+	{
+		FShipPartData PartData;
+		PartData.Name = Entry.Name;
+		PartData.PartType = Entry.PartType;
+		PartData.ClassReference = FStringAssetReference(Entry.ClassPath);
+
+		const int32 PartIndex = AddShipPartData(MoveTemp(PartData));
+		if (Entry.bCompatiblePartsKnown)
+		{
+			SetCompatibleParts(PartIndex, Entry.CompatibleParts);
+		}
+	}
+}
+
+int32 UShipPartFactory::AddShipPartData(FShipPartData&& PartData)
+{
+	const int32 PartIndex = ShipPartData.Add(MoveTemp(PartData));
+	PartIndices.Add(ShipPartData[PartIndex].Name, PartIndex);
+	PartsByType[ShipPartTypes::GetTypeId(ShipPartData[PartIndex].PartType)].Add(PartIndex);
+	return PartIndex;
+}
+
+void UShipPartFactory::SetCompatibleParts(int32 PartIndex, const FShipPartTypeMask& CompatibleParts)
+{
+	FShipPartData& Data = ShipPartData[PartIndex];
+	if (Data.bCompatiblePartsKnown && Data.CompatibleParts == CompatibleParts)
+	{
+		return;
+	}
+
+	// Take it out of the reverse lookup for the old types if it's changed.
+	if (Data.bCompatiblePartsKnown)
+	{
+		for (const EPartType CompatibleType : Data.CompatibleParts.ToArray())
+		{
+			if (PartsCompatibleWithType.IsValidIndex(ShipPartTypes::GetTypeId(CompatibleType)))
+			{
+				PartsCompatibleWithType[ShipPartTypes::GetTypeId(CompatibleType)].Remove(PartIndex);
+			}
+		}
+	}
+
+	Data.CompatibleParts = CompatibleParts;
+	Data.bCompatiblePartsKnown = true;
+	bManifestDirty = true;
+
+	for (const EPartType CompatibleType : Data.CompatibleParts.ToArray())
+	{
+		if (PartsCompatibleWithType.IsValidIndex(ShipPartTypes::GetTypeId(CompatibleType)))
+		{
+			PartsCompatibleWithType[ShipPartTypes::GetTypeId(CompatibleType)].Add(PartIndex);
+		}
+	}
+}
+
+void UShipPartFactory::SaveManifestIfDirty()
+{
+	if (!bManifestDirty)
+	{
+		return;
+	}
+
+	FShipPartCatalogManifest Manifest;
+	Manifest.SourceHash = ManifestSourceHash;
+	Manifest.Entries.Reserve(ShipPartData.Num());
+	for (const FShipPartData& Data : ShipPartData)
+	{
+		Manifest.Entries.Add({ Data.Name, Data.PartType, Data.ClassReference.ToString(), Data.CompatibleParts, Data.bCompatiblePartsKnown });
+	}
+
+	if (Manifest.Save(FShipPartCatalogManifest::GetDefaultFilename()))
+	{
+		bManifestDirty = false;
+	}
 }
 
 AShipPart* UShipPartFactory::MakeShipPart(UObject* WorldContext, FName PartName, FVector SpawnLocation /*= FVector(0.f, 0.f, 30.f)*/)
 {
+	SCOPE_CYCLE_COUNTER(STAT_ShipMakeShipPart);
 	checkf(HasLoadedAssetData(), TEXT("Asset data has not been loaded, ensure that Init() has been called first."));
 
-	const FShipPartData* Data = ShipPartData.FindByPredicate([&PartName](auto&& Data) { return Data.Name == PartName; });
-	if (!Data)
+	const int32* PartIndex = PartIndices.Find(PartName);
+	if (!PartIndex)
 	{
 		UE_LOG(LogShipPartFactory, Error, TEXT("Failed to find data for part: %s"), *PartName.ToString());
 		return nullptr;
 	}
 
-	const FString GeneratedClassName = FShipPartData::GetGeneratedClassName(*Data);
-	if (GeneratedClassName.IsEmpty())
+	UClass* PartClass = nullptr;
 	{
-		UE_LOG(LogShipPartFactory, Error, TEXT("Failed to get generated class name for part: %s"), *PartName.ToString());
-		return nullptr;
+		SCOPE_CYCLE_COUNTER(STAT_ShipMakeShipPartClassLoad);
+		PartClass = ResolveShipPartClass(*PartIndex);
 	}
-
-	// TODO: cache class?
-	UClass* PartClass = LoadClass<AShipPart>(nullptr, *GeneratedClassName);
 	if (!PartClass)
 	{
-		UE_LOG(LogShipPartFactory, Error, TEXT("Failed to load class for part: %s"), *PartName.ToString());
 		return nullptr;
 	}
 
@@ -125,6 +258,13 @@ AShipPart* UShipPartFactory::MakeShipPart(UObject* WorldContext, FName PartName,
 	{
 		return nullptr;
 	}
+
+	SCOPE_CYCLE_COUNTER(STAT_ShipMakeShipPartSpawn);
+
+	if (AShipPart* PooledShipPart = ShipPartPool->Acquire(PartClass, FTransform(SpawnLocation)))
+	{
+		return PooledShipPart;
+	}
 	
 	// TODO: Maybe spawn the part where the mouse is (drag and drop)
 	FActorSpawnParameters SpawnParams;
@@ -140,6 +280,110 @@ AShipPart* UShipPartFactory::MakeShipPart(UObject* WorldContext, FName PartName,
 	return ShipPart;
 }
 
+UClass* UShipPartFactory::GetShipPartClass(FName PartName)
+{
+	checkf(HasLoadedAssetData(), TEXT("Asset data has not been loaded, ensure that Init() has been called first."));
+
+	const int32* PartIndex = PartIndices.Find(PartName);
+	return PartIndex ? ResolveShipPartClass(*PartIndex) : nullptr;
+}
+
+float UShipPartFactory::GetClassPreloadProgress() const
+{
+	return (NumClassesToPreload > 0) ? (float)NumClassesPreloaded / (float)NumClassesToPreload : 1.f;
+}
+
+const FShipPartData* UShipPartFactory::FindShipPartData(FName PartName) const
+{
+	const int32* PartIndex = PartIndices.Find(PartName);
+	return PartIndex ? &ShipPartData[*PartIndex] : nullptr;
+}
+
+const TArray<int32>& UShipPartFactory::GetShipPartsOfType(EPartType PartType) const
+{
+	checkf(HasLoadedAssetData(), TEXT("Asset data has not been loaded, ensure that Init() has been called first."));
+	return PartsByType[ShipPartTypes::GetTypeId(PartType)];
+}
+
+const TArray<int32>& UShipPartFactory::GetShipPartsCompatibleWith(EPartType PartType) const
+{
+	checkf(HasLoadedAssetData(), TEXT("Asset data has not been loaded, ensure that Init() has been called first."));
+	check(PartType != EPartType::PT_MAX);
+	return PartsCompatibleWithType[ShipPartTypes::GetTypeId(PartType)];
+}
+
+UClass* UShipPartFactory::ResolveShipPartClass(int32 PartIndex)
+{
+	const FShipPartData& Data = ShipPartData[PartIndex];
+	if (UClass* const* CachedClass = ShipPartClasses.Find(Data.Name))
+	{
+		return *CachedClass;
+	}
+
+	if (!Data.ClassReference.IsValid())
+	{
+		UE_LOG(LogShipPartFactory, Error, TEXT("Failed to get generated class name for part: %s"), *Data.Name.ToString());
+		return nullptr;
+	}
+
+	// Use the class if it's already in memory, otherwise we have to wait for it.
+	UClass* PartClass = Cast<UClass>(Data.ClassReference.ResolveObject());
+	if (!PartClass)
+	{
+		if (IsPreloadingClasses())
+		{
+			UE_LOG(LogShipPartFactory, Log, TEXT("Part %s was spawned before it finished preloading, loading it synchronously."), *Data.Name.ToString());
+		}
+		PartClass = LoadClass<AShipPart>(nullptr, *Data.ClassReference.ToString());
+	}
+
+	if (!PartClass || !PartClass->IsChildOf(AShipPart::StaticClass()))
+	{
+		UE_LOG(LogShipPartFactory, Error, TEXT("Failed to load class for part: %s"), *Data.Name.ToString());
+		return nullptr;
+	}
+
+	CacheShipPartClass(PartIndex, PartClass);
+	return PartClass;
+}
+
+void UShipPartFactory::CacheShipPartClass(int32 PartIndex, UClass* PartClass)
+{
+	check(PartClass);
+	ShipPartClasses.Add(ShipPartData[PartIndex].Name, PartClass);
+
+	// Now that we know what the part can attach to it can be added to the reverse lookup.
+	SetCompatibleParts(PartIndex, PartClass->GetDefaultObject<AShipPart>()->GetDefaultCompatibleMask());
+}
+
+void UShipPartFactory::OnShipPartClassPreloaded(FName PartName)
+{
+	++NumClassesPreloaded;
+
+	// It may have already been loaded synchronously if it was spawned while streaming in.
+	const int32* PartIndex = PartIndices.Find(PartName);
+	if (PartIndex && !ShipPartClasses.Contains(PartName))
+	{
+		UClass* PartClass = Cast<UClass>(ShipPartData[*PartIndex].ClassReference.ResolveObject());
+		if (PartClass && PartClass->IsChildOf(AShipPart::StaticClass()))
+		{
+			CacheShipPartClass(*PartIndex, PartClass);
+		}
+		else
+		{
+			UE_LOG(LogShipPartFactory, Error, TEXT("Failed to preload class for part: %s"), *PartName.ToString());
+		}
+	}
+
+	if (!IsPreloadingClasses())
+	{
+		UE_LOG(LogShipPartFactory, Log, TEXT("Finished preloading %d ship part classes."), NumClassesPreloaded);
+
+		// Every part's compatibility is known now, so write it out for next time.
+		SaveManifestIfDirty();
+	}
+}
+
 TMap<FString, EPartType> UShipPartFactory::MakeShipPartPathsToTypes(const FString& RootPath) const
 {
 	TMap<FString, EPartType> PathToTypes;
@@ -4,6 +4,7 @@
 
 #include "Object.h"
 #include "AssetData.h"
+#include "Engine/StreamableManager.h"
 #include "ShipBuildingTypes.h"
 #include "ShipPartFactory.generated.h"
 
@@ -25,6 +26,10 @@ struct FShipPartData
 	UPROPERTY(BlueprintReadOnly, Category = FShipPartData)
 	EPartType PartType;
 
+	// The types this part's attach points are compatible with by default. Filled in once the part's class has been loaded (or from the manifest).
+	UPROPERTY()
+	FShipPartTypeMask CompatibleParts;
+
 	// Default constructor
 	FShipPartData() = default;
 
@@ -32,20 +37,18 @@ private:
 	friend class UShipPartFactory;
 
 	// Constructor that should be used internally.
-	// Verifies the asset name contains the prefix.
+	// Verifies the asset name contains the prefix and pulls out the generated class.
 	explicit FShipPartData(const FAssetData& Data);
 
 	// The prefix used in the asset name.
 	static const FString Prefix;
 
-	// Full name of the asset including the prefix. Used for doing lookups.
-	FName FullName;
+	// Object path of the blueprint's generated class (ie. /Game/ShipParts/Cockpit/BLU_Cockpit.BLU_Cockpit_C).
+	// This is the only thing needed from the asset data, so the rest of it isn't kept around.
+	FStringAssetReference ClassReference;
 
-	// The asset data for this ship part.
-	FAssetData AssetData;
-
-	// Gets the GeneratedClassName from the AssetData.
-	static FString GetGeneratedClassName(const FShipPartData& ShipPartData);
+	// Has CompatibleParts been filled in.
+	bool bCompatiblePartsKnown = false;
 };
 
 /**
@@ -59,10 +62,41 @@ class SHIPBUILDINGDEMO_API UShipPartFactory : public UObject
 	UPROPERTY()
 	class UObjectLibrary* ShipPartLibrary;
 
+	// Parts that have been removed from the ship, handed back out by MakeShipPart before spawning new ones.
+	UPROPERTY()
+	class UShipPartPool* ShipPartPool;
+
 	// Custom ship part data struct for handing off to the UI. Populated during Init.
 	UPROPERTY()
 	TArray<FShipPartData> ShipPartData;
 
+	// Index into ShipPartData of each part by name.
+	TMap<FName, int32> PartIndices;
+
+	// Indices into ShipPartData of the parts of each type. Indexed by EPartType, with an extra bucket for parts of an unknown type (PT_MAX).
+	TArray<TArray<int32>> PartsByType;
+
+	// Indices into ShipPartData of the parts that can attach to each type, indexed by EPartType.
+	// Parts are added as their compatibility becomes known, either from the manifest or when their classes are resolved.
+	TArray<TArray<int32>> PartsCompatibleWithType;
+
+	// Part classes that have been loaded, keyed by part name. Also keeps the classes from being garbage collected.
+	UPROPERTY()
+	TMap<FName, UClass*> ShipPartClasses;
+
+	// Streams in the part classes in the background when Init is asked to preload them.
+	FStreamableManager StreamableManager;
+
+	// Number of part classes requested and finished during preloading.
+	int32 NumClassesToPreload;
+	int32 NumClassesPreloaded;
+
+	// Hash of the ship part content the catalog was built from, written to the manifest.
+	uint32 ManifestSourceHash;
+
+	// Has the catalog changed since the manifest was last written (ie. a part's compatibility was learnt from its class).
+	bool bManifestDirty;
+
 	// Has Init been called and has the asset data been loaded.
 	bool bAssetDataLoaded;
 
@@ -71,14 +105,16 @@ public:
 
 	/**
 	 *	Loads the asset data for the ship parts and populates ShipPartData.
+	 *	Reads the cached catalog manifest if it's up to date, otherwise scans the asset registry and writes a new one.
 	 *	Note: Must be called before using MakeShipPart or GetShipPartData.
 	 *
 	 *	@param RootShipPartPath: The path to the root ship part directory, relative to /Game (ie. /Game/ShipParts).
+	 *	@param bPreloadClasses: Whether to start streaming in all the part classes in the background so spawning them later doesn't hitch.
 	 */
-	void Init(const FString& RootShipPartPath);
+	void Init(const FString& RootShipPartPath, bool bPreloadClasses = false);
 
 	/**
-	 *	Creates an instance of a ship part in the world using the name.
+	 *	Creates an instance of a ship part in the world using the name. Reuses a pooled part of the same class if there is one.
 	 *
 	 *	@param WorldContext: An object instance that has a valid reference to the world.
 	 *	@param PartName: The name of the part to spawn.
@@ -87,9 +123,51 @@ public:
 	 */
 	AShipPart* MakeShipPart(UObject* WorldContext, FName PartName, FVector SpawnLocation = FVector(0.f, 0.f, 200.f));
 
+	/**
+	 *	Gets the class of a part, loading it if it isn't already.
+	 *
+	 *	@param PartName: The name of the part.
+	 *	@return: The part's class or nullptr if there's no part with the name or it failed to load.
+	 */
+	UClass* GetShipPartClass(FName PartName);
+
+	/**
+	 *	Gets how far through preloading the part classes the factory is.
+	 *
+	 *	@return: Fraction of the part classes that have finished loading, 0-1. 1 if nothing is being preloaded.
+	 */
+	float GetClassPreloadProgress() const;
+
+	/**
+	 *	Looks up the data of a part by name.
+	 *
+	 *	@param PartName: The name of the part.
+	 *	@return: The part's data or nullptr if there's no part with the name.
+	 */
+	const FShipPartData* FindShipPartData(FName PartName) const;
+
+	/**
+	 *	Gets the parts of a type.
+	 *
+	 *	@param PartType: The type of part. PT_MAX gets the parts whose type couldn't be determined.
+	 *	@return: Indices into GetShipPartData() of the parts.
+	 */
+	const TArray<int32>& GetShipPartsOfType(EPartType PartType) const;
+
+	/**
+	 *	Gets the parts that can attach to a type of part.
+	 *	Only contains parts whose compatibility is known (from the manifest or once their class is loaded), which is all of them once preloading has finished.
+	 *
+	 *	@param PartType: The type of part to attach to.
+	 *	@return: Indices into GetShipPartData() of the parts.
+	 */
+	const TArray<int32>& GetShipPartsCompatibleWith(EPartType PartType) const;
+
 	// Accessors
 	FORCEINLINE bool HasLoadedAssetData() const noexcept { return bAssetDataLoaded; }
+	FORCEINLINE bool IsPreloadingClasses() const noexcept { return (NumClassesPreloaded < NumClassesToPreload); }
 	FORCEINLINE const TArray<FShipPartData>& GetShipPartData() const noexcept { return ShipPartData; }
+	FORCEINLINE class UShipPartPool* GetShipPartPool() const noexcept { return ShipPartPool; }
 
 private:
 	/**
@@ -99,4 +177,42 @@ private:
 	 *	@return: A map pairing the full path of the ship part (ie. /Game/ShipParts/Cockpit) to the corresponding enum (ie. PT_Cockpit).
 	 */
 	TMap<FString, EPartType> MakeShipPartPathsToTypes(const FString& RootPath) const;
+
+	// Populate the catalog by scanning the asset registry or from a manifest.
+	void LoadCatalogFromAssetRegistry(const FString& RootShipPartPath);
+	void LoadCatalogFromManifest(const struct FShipPartCatalogManifest& Manifest);
+
+	// Adds a part to ShipPartData and the name/type lookups. Returns its index.
+	int32 AddShipPartData(FShipPartData&& PartData);
+
+	/**
+	 *	Sets what a part can attach to and updates the reverse lookup.
+	 *
+	 *	@param PartIndex: Index into ShipPartData of the part.
+	 *	@param CompatibleParts: The types the part can attach to.
+	 */
+	void SetCompatibleParts(int32 PartIndex, const FShipPartTypeMask& CompatibleParts);
+
+	// Writes the catalog manifest if anything has changed since it was loaded or last written.
+	void SaveManifestIfDirty();
+
+	/**
+	 *	Gets the class for a part, loading it if it isn't already cached.
+	 *	Only blocks if the class isn't in memory yet (ie. it wasn't preloaded or is still streaming in).
+	 *
+	 *	@param PartIndex: Index into ShipPartData of the part to get the class for. CompatibleParts is filled in the first time the class is resolved.
+	 *	@return: The part's class or nullptr if it failed to load.
+	 */
+	UClass* ResolveShipPartClass(int32 PartIndex);
+
+	/**
+	 *	Adds a loaded class to the cache and fills in the data that comes from its CDO.
+	 *
+	 *	@param PartIndex: Index into ShipPartData of the part the class is for.
+	 *	@param PartClass: The loaded class.
+	 */
+	void CacheShipPartClass(int32 PartIndex, UClass* PartClass);
+
+	// Called by the streamable manager once a preloaded part class has finished loading.
+	void OnShipPartClassPreloaded(FName PartName);
 };
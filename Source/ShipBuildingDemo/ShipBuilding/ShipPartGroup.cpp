@@ -0,0 +1,117 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipPartGroup.h"
+#include "ShipPart.h"
+
+
+FShipPartGroup::FShipPartGroup()
+: ShipPart(nullptr)
+, MinSnapDistance(0.f)
+, LocalSnapBounds(ForceInit)
+, LocalSnapQueryBox(ForceInit)
+{
+}
+
+void FShipPartGroup::Init(AShipPart* InShipPart)
+{
+	check(InShipPart);
+	Reset();
+
+	ShipPart = InShipPart;
+	Parts.Add(InShipPart);
+	PartSet.Add(InShipPart);
+
+	// Everything a single part is attached to is outside of the group, so all of its points are included.
+	Points.Reserve(InShipPart->GetNumAttachPoints());
+	for (int32 PointIndex = 0; PointIndex < InShipPart->GetNumAttachPoints(); ++PointIndex)
+	{
+		Points.Emplace(InShipPart, PointIndex);
+	}
+
+	UpdateLocalBounds();
+}
+
+void FShipPartGroup::Init(AShipPart* InShipPart, const TArray<AShipPart*>& InParts)
+{
+	check(InShipPart);
+	checkf(InParts.Contains(InShipPart), TEXT("The grabbed part must be part of the group."));
+	Reset();
+
+	ShipPart = InShipPart;
+	Parts = InParts;
+	PartSet.Append(InParts);
+
+	for (AShipPart* Part : Parts)
+	{
+		for (int32 PointIndex = 0; PointIndex < Part->GetNumAttachPoints(); ++PointIndex)
+		{
+			const FShipAttachPointRef AttachPoint(Part, PointIndex);
+			if (!AttachPoint.IsAttached() || !Contains(AttachPoint.GetAttachedToShipPart()))
+			{
+				Points.Add(AttachPoint);
+			}
+		}
+	}
+
+	UpdateLocalBounds();
+}
+
+void FShipPartGroup::Reset()
+{
+	ShipPart = nullptr;
+	ShipUtils::ClearArray(Parts);
+	PartSet.Empty(PartSet.Num());
+	ShipUtils::ClearArray(Points);
+	LocalSnapBounds.Init();
+	LocalSnapQueryBox.Init();
+}
+
+bool FShipPartGroup::IsAttachedToOthers() const
+{
+	return Points.ContainsByPredicate([this](const FShipAttachPointRef& P) { return P.IsAttached() && !Contains(P.GetAttachedToShipPart()); });
+}
+
+void FShipPartGroup::DetachFromOthers()
+{
+	for (const FShipAttachPointRef& AttachPoint : Points)
+	{
+		const FShipAttachPointRef AttachedTo = AttachPoint.GetAttachedToPoint();
+		if (AttachedTo.IsValid() && !Contains(AttachedTo.GetOwningShipPart()))
+		{
+			AShipPart::DetachPointPair(AttachPoint, AttachedTo);
+		}
+	}
+}
+
+FBox FShipPartGroup::GetSnapBounds() const
+{
+	check(IsValid());
+	return LocalSnapBounds.ShiftBy(ShipPart->GetActorLocation());
+}
+
+FBox FShipPartGroup::GetSnapQueryBox() const
+{
+	check(IsValid());
+	return LocalSnapQueryBox.ShiftBy(ShipPart->GetActorLocation());
+}
+
+void FShipPartGroup::UpdateLocalBounds()
+{
+	const FVector Origin = ShipPart->GetActorLocation();
+	MinSnapDistance = ShipPart->GetMinSnapDistance();
+
+	LocalSnapBounds.Init();
+	for (const AShipPart* Part : Parts)
+	{
+		LocalSnapBounds += Part->GetSnapBounds().GetBox().ShiftBy(-Origin);
+	}
+
+	// Points within snapping range of the group's points may lie slightly outside of its snap bounds.
+	LocalSnapQueryBox = LocalSnapBounds;
+	const FVector SnapExtent{ MinSnapDistance };
+	for (const FShipAttachPointRef& AttachPoint : Points)
+	{
+		LocalSnapQueryBox += FBox::BuildAABB(AttachPoint.GetLocation() - Origin, SnapExtent);
+	}
+}
@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ShipAttachPointData.h"
+
+class AShipPart;
+
+/**
+ *	A ship part being moved along with any parts being dragged with it. The group is moved as one by moving the grabbed part.
+ *	Bounds are stored relative to the grabbed part so they don't need to be recomputed as the group moves.
+ */
+class SHIPBUILDINGDEMO_API FShipPartGroup
+{
+public:
+	FShipPartGroup();
+
+	/**
+	 *	Sets up the group for moving a single part. All of the part's points can snap to other parts.
+	 *
+	 *	@param InShipPart: The part to move.
+	 */
+	void Init(AShipPart* InShipPart);
+
+	/**
+	 *	Sets up the group for moving a part along with other parts. Only the points not attached within the group can snap to other parts.
+	 *
+	 *	@param InShipPart: The part that was grabbed.
+	 *	@param InParts: All the parts to move, including InShipPart.
+	 */
+	void Init(AShipPart* InShipPart, const TArray<AShipPart*>& InParts);
+
+	// Empties the group but keeps the memory.
+	void Reset();
+
+	// Returns true if any of the group's points are attached to a part outside of the group.
+	bool IsAttachedToOthers() const;
+
+	// Detaches the group's points from any parts outside of the group.
+	void DetachFromOthers();
+
+	// World space bounds of the group expanded by the snap distance.
+	FBox GetSnapBounds() const;
+
+	// World space area that points must be in to be within snapping range of the group.
+	FBox GetSnapQueryBox() const;
+
+	FORCEINLINE bool IsValid() const { return (ShipPart != nullptr); }
+	FORCEINLINE bool IsGroup() const { return (Parts.Num() > 1); }
+	FORCEINLINE bool Contains(const AShipPart* InShipPart) const { return PartSet.Contains(InShipPart); }
+	FORCEINLINE AShipPart* GetShipPart() const { return ShipPart; }
+	FORCEINLINE const TArray<AShipPart*>& GetParts() const { return Parts; }
+	FORCEINLINE const TArray<FShipAttachPointRef>& GetPoints() const { return Points; }
+	FORCEINLINE float GetMinSnapDistance() const { return MinSnapDistance; }
+
+private:
+	// Computes the local bounds once the parts and points have been set.
+	void UpdateLocalBounds();
+
+	// The part that was grabbed.
+	AShipPart* ShipPart;
+
+	// All the parts in the group, including ShipPart.
+	TArray<AShipPart*> Parts;
+	TSet<const AShipPart*> PartSet;
+
+	// The points that can snap to other parts.
+	TArray<FShipAttachPointRef> Points;
+
+	// Snap distance of the grabbed part, used for the whole group.
+	float MinSnapDistance;
+
+	// GetSnapBounds and GetSnapQueryBox relative to ShipPart's location.
+	FBox LocalSnapBounds;
+	FBox LocalSnapQueryBox;
+};
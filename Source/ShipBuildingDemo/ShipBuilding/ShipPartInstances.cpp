@@ -0,0 +1,146 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipPartInstances.h"
+#include "ShipPart.h"
+
+TWeakObjectPtr<AShipPartInstances> AShipPartInstances::CurrentInstances;
+
+AShipPartInstances::AShipPartInstances()
+: NumParts(0)
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+}
+
+AShipPartInstances* AShipPartInstances::Get(UWorld* World)
+{
+	if (!World || !World->IsGameWorld())
+	{
+		return nullptr;
+	}
+
+	if (CurrentInstances.IsValid() && CurrentInstances->GetWorld() == World)
+	{
+		return CurrentInstances.Get();
+	}
+
+	// Only the first lookup in each world has to search for them.
+	for (TActorIterator<AShipPartInstances> It(World); It; ++It)
+	{
+		if (!It->IsPendingKill())
+		{
+			CurrentInstances = *It;
+			return *It;
+		}
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	CurrentInstances = World->SpawnActor<AShipPartInstances>(SpawnParams);
+	return CurrentInstances.Get();
+}
+
+bool AShipPartInstances::AddPart(AShipPart* ShipPart)
+{
+	check(ShipPart);
+	checkf(ShipPart->InstanceIndex == INDEX_NONE, TEXT("%s is already instanced."), *GetNameSafe(ShipPart));
+
+	const UStaticMeshComponent* PartMesh = ShipPart->GetShipPartMesh();
+	if (!PartMesh || !PartMesh->StaticMesh)
+	{
+		return false;
+	}
+
+	const int32 ClassIndex = FindOrAddClass(ShipPart);
+	FClassInstances& Instances = Classes[ClassIndex];
+	const FTransform& Transform = PartMesh->GetComponentToWorld();
+
+	int32 InstanceIndex = INDEX_NONE;
+	if (Instances.FreeInstances.Num() > 0)
+	{
+		InstanceIndex = Instances.FreeInstances.Pop(false);
+		Instances.Parts[InstanceIndex] = ShipPart;
+		Instances.Mesh->UpdateInstanceTransform(InstanceIndex, Transform, true, true, true);
+	}
+	else
+	{
+		InstanceIndex = Instances.Parts.Add(ShipPart);
+		Instances.Mesh->AddInstanceWorldSpace(Transform);
+	}
+
+	ShipPart->InstanceClassIndex = ClassIndex;
+	ShipPart->InstanceIndex = InstanceIndex;
+	++NumParts;
+	return true;
+}
+
+void AShipPartInstances::RemovePart(AShipPart* ShipPart)
+{
+	check(ShipPart);
+	const int32 ClassIndex = ShipPart->InstanceClassIndex;
+	const int32 InstanceIndex = ShipPart->InstanceIndex;
+	checkf(Classes.IsValidIndex(ClassIndex) && Classes[ClassIndex].Parts.IsValidIndex(InstanceIndex) && Classes[ClassIndex].Parts[InstanceIndex] == ShipPart,
+		TEXT("%s is not instanced."), *GetNameSafe(ShipPart));
+
+	FClassInstances& Instances = Classes[ClassIndex];
+	Instances.Parts[InstanceIndex] = nullptr;
+	Instances.FreeInstances.Add(InstanceIndex);
+
+	const FTransform Hidden{ FQuat::Identity, ShipPart->GetActorLocation(), FVector::ZeroVector };
+	Instances.Mesh->UpdateInstanceTransform(InstanceIndex, Hidden, true, true, true);
+
+	ShipPart->InstanceClassIndex = INDEX_NONE;
+	ShipPart->InstanceIndex = INDEX_NONE;
+	--NumParts;
+}
+
+AShipPart* AShipPartInstances::GetPartFromHit(const FHitResult& Hit) const
+{
+	const UHierarchicalInstancedStaticMeshComponent* HitMesh = Cast<UHierarchicalInstancedStaticMeshComponent>(Hit.GetComponent());
+	if (!HitMesh || Hit.GetActor() != this)
+	{
+		return nullptr;
+	}
+
+	// Instanced mesh hits report the instance in Item.
+	for (const FClassInstances& Instances : Classes)
+	{
+		if (Instances.Mesh == HitMesh)
+		{
+			return Instances.Parts.IsValidIndex(Hit.Item) ? Instances.Parts[Hit.Item] : nullptr;
+		}
+	}
+	return nullptr;
+}
+
+int32 AShipPartInstances::FindOrAddClass(const AShipPart* ShipPart)
+{
+	UClass* PartClass = ShipPart->GetClass();
+	if (const int32* ClassIndex = ClassIndices.Find(PartClass))
+	{
+		return *ClassIndex;
+	}
+
+	// Looks and collides the same as the part's own mesh, aside from only being used for queries.
+	const UStaticMeshComponent* PartMesh = ShipPart->GetShipPartMesh();
+	UHierarchicalInstancedStaticMeshComponent* Mesh = NewObject<UHierarchicalInstancedStaticMeshComponent>(this);
+	Mesh->SetupAttachment(RootComponent);
+	Mesh->SetMobility(EComponentMobility::Movable);
+	Mesh->SetStaticMesh(PartMesh->StaticMesh);
+	for (int32 MaterialIndex = 0; MaterialIndex < PartMesh->GetNumMaterials(); ++MaterialIndex)
+	{
+		Mesh->SetMaterial(MaterialIndex, PartMesh->GetMaterial(MaterialIndex));
+	}
+	Mesh->SetCollisionProfileName(PartMesh->GetCollisionProfileName());
+	Mesh->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
+	Mesh->SetCollisionResponseToChannel(ECC_Camera, ECR_Ignore);
+	Mesh->RegisterComponent();
+	ClassMeshes.Add(Mesh);
+
+	const int32 ClassIndex = Classes.Num();
+	Classes.Add({ PartClass, Mesh, TArray<AShipPart*>(), TArray<int32>() });
+	ClassIndices.Add(PartClass, ClassIndex);
+	return ClassIndex;
+}
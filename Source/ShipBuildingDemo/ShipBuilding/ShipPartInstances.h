@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/Actor.h"
+#include "ShipPartInstances.generated.h"
+
+class AShipPart;
+class UHierarchicalInstancedStaticMeshComponent;
+
+/**
+ *	Draws the ship parts that aren't being edited as instances of one instanced mesh per part class, rather than each part having its own mesh component.
+ *	A part handed to it (see AShipPart::Dematerialize) unregisters its mesh so it has no render state or physics body of its own,
+ *	and gets its mesh back when it's picked or edited (AShipPart::Materialize). The part actor stays around as the handle everything else uses.
+ *	Instances are query only so parts can still be clicked on; GetPartFromHit maps the hit instance back to its part.
+ *	Like AShipAttachPointMarkers, removed instances are scaled to zero and reused rather than removed so indices never change.
+ */
+UCLASS(NotPlaceable, Transient)
+class SHIPBUILDINGDEMO_API AShipPartInstances : public AActor
+{
+	GENERATED_BODY()
+
+	// The instances of a single part class.
+	struct FClassInstances
+	{
+		UClass* PartClass;
+		UHierarchicalInstancedStaticMeshComponent* Mesh;
+
+		// The part each instance is for. Null if the instance is free.
+		TArray<AShipPart*> Parts;
+
+		// Instances that can be reused.
+		TArray<int32> FreeInstances;
+	};
+
+	// Instances of each part class, by the index stored on the parts.
+	TArray<FClassInstances> Classes;
+
+	// Index into Classes of each part class.
+	TMap<const UClass*, int32> ClassIndices;
+
+	// Instanced mesh components, kept here so they're referenced.
+	UPROPERTY()
+	TArray<UHierarchicalInstancedStaticMeshComponent*> ClassMeshes;
+
+public:
+	AShipPartInstances();
+
+	/**
+	 *	Gets the instances for a world, spawning them if they don't exist yet.
+	 *
+	 *	@param World: The world the parts are in.
+	 *	@return: The instances or nullptr if the world isn't a game world.
+	 */
+	static AShipPartInstances* Get(UWorld* World);
+
+	/**
+	 *	Adds an instance for a part at its mesh's current transform. The part is expected to unregister its own mesh.
+	 *
+	 *	@param ShipPart: The part to draw. Must have a static mesh and not already be instanced.
+	 *	@return: True if the instance was added.
+	 */
+	bool AddPart(AShipPart* ShipPart);
+
+	/**
+	 *	Hides a part's instance and frees it up for another part of the same class.
+	 *
+	 *	@param ShipPart: The part to remove.
+	 */
+	void RemovePart(AShipPart* ShipPart);
+
+	/**
+	 *	Finds the part whose instance was hit by a trace.
+	 *
+	 *	@param Hit: The hit result.
+	 *	@return: The part or nullptr if the hit wasn't on one of the instances.
+	 */
+	AShipPart* GetPartFromHit(const FHitResult& Hit) const;
+
+	// Number of parts currently drawn as instances.
+	FORCEINLINE int32 Num() const { return NumParts; }
+
+private:
+	// Gets the instances for a part's class, creating the instanced mesh from the part's mesh if it's the first of its class.
+	int32 FindOrAddClass(const AShipPart* ShipPart);
+
+	int32 NumParts;
+
+	// The instances for the world most recently asked for.
+	static TWeakObjectPtr<AShipPartInstances> CurrentInstances;
+};
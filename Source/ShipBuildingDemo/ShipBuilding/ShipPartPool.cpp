@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipPartPool.h"
+#include "ShipPart.h"
+
+DECLARE_LOG_CATEGORY_CLASS(LogShipPartPool, Log, All);
+
+AShipPart* UShipPartPool::Acquire(UClass* PartClass, const FTransform& Transform)
+{
+	FShipPartPoolBucket* Bucket = Buckets.Find(PartClass);
+	while (Bucket && Bucket->Parts.Num() > 0)
+	{
+		// Take the most recently released so the older ones can be trimmed.
+		AShipPart* ShipPart = Bucket->Parts.Pop(false);
+		Bucket->ReleaseTimes.Pop(false);
+		--Stats.NumPooled;
+
+		// Pooled parts can still be destroyed out from under us (ie. the level being unloaded).
+		if (ShipPart && !ShipPart->IsPendingKillPending())
+		{
+			ShipPart->Reactivate(Transform);
+			++Stats.NumReused;
+			return ShipPart;
+		}
+	}
+
+	++Stats.NumMissed;
+	return nullptr;
+}
+
+void UShipPartPool::Release(AShipPart* ShipPart)
+{
+	check(ShipPart);
+	++Stats.NumReleased;
+
+	FShipPartPoolBucket& Bucket = Buckets.FindOrAdd(ShipPart->GetClass());
+	if (Bucket.Parts.Num() >= Settings.MaxPooledPerClass)
+	{
+		ShipPart->Destroy();
+		++Stats.NumDestroyed;
+		return;
+	}
+
+	ShipPart->Deactivate();
+	Bucket.Parts.Add(ShipPart);
+	Bucket.ReleaseTimes.Add(FPlatformTime::Seconds());
+
+	++Stats.NumPooled;
+	Stats.PeakPooled = FMath::Max(Stats.PeakPooled, Stats.NumPooled);
+}
+
+void UShipPartPool::ReleaseArray(TArray<AShipPart*>& ShipParts, bool bRetainSlack /*= false*/)
+{
+	const int32 Count = bRetainSlack ? ShipParts.Num() : 0;
+	for (int32 i = ShipParts.Num() - 1; i >= 0; --i)
+	{
+		Release(ShipParts[i]);
+	}
+	ShipParts.Empty(Count);
+}
+
+int32 UShipPartPool::Trim()
+{
+	const double Now = FPlatformTime::Seconds();
+	int32 NumTrimmed = 0;
+	for (auto& Pair : Buckets)
+	{
+		// Parts are in the order they were released, so stop at the first one that hasn't expired.
+		FShipPartPoolBucket& Bucket = Pair.Value;
+		int32 NumExpired = 0;
+		while (NumExpired < Bucket.Parts.Num() && NumTrimmed < Settings.MaxTrimmedPerCall && (Now - Bucket.ReleaseTimes[NumExpired]) > Settings.MaxIdleTime)
+		{
+			if (AShipPart* ShipPart = Bucket.Parts[NumExpired])
+			{
+				ShipPart->Destroy();
+			}
+			++NumExpired;
+			++NumTrimmed;
+		}
+
+		if (NumExpired > 0)
+		{
+			Bucket.Parts.RemoveAt(0, NumExpired, false);
+			Bucket.ReleaseTimes.RemoveAt(0, NumExpired, false);
+		}
+	}
+
+	Stats.NumPooled -= NumTrimmed;
+	Stats.NumDestroyed += NumTrimmed;
+	if (NumTrimmed > 0)
+	{
+		UE_LOG(LogShipPartPool, Verbose, TEXT("Trimmed %d idle ship parts, %d left in the pool."), NumTrimmed, Stats.NumPooled);
+	}
+	return NumTrimmed;
+}
+
+void UShipPartPool::Empty()
+{
+	for (auto& Pair : Buckets)
+	{
+		for (AShipPart* ShipPart : Pair.Value.Parts)
+		{
+			if (ShipPart)
+			{
+				ShipPart->Destroy();
+				++Stats.NumDestroyed;
+			}
+		}
+	}
+	Buckets.Empty();
+	Stats.NumPooled = 0;
+}
+
+void UShipPartPool::LogStats() const
+{
+	UE_LOG(LogShipPartPool, Log, TEXT("Ship part pool: %d pooled (peak %d) across %d classes. %d reused, %d missed, %d released, %d destroyed."),
+		Stats.NumPooled, Stats.PeakPooled, Buckets.Num(), Stats.NumReused, Stats.NumMissed, Stats.NumReleased, Stats.NumDestroyed);
+}
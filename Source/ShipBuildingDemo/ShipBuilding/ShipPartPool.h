@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Object.h"
+#include "ShipPartPool.generated.h"
+
+class AShipPart;
+
+/**
+ *	Controls how many parts the pool keeps around.
+ */
+USTRUCT(BlueprintType)
+struct FShipPartPoolSettings
+{
+	GENERATED_BODY()
+
+	// Most parts of a single class to keep. Parts released once this is reached are destroyed.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pooling")
+	int32 MaxPooledPerClass = 1024;
+
+	// How long in seconds a part can sit in the pool before it's destroyed when trimming.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pooling")
+	float MaxIdleTime = 60.f;
+
+	// How often in seconds to trim the pool.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pooling")
+	float TrimInterval = 5.f;
+
+	// Most parts to destroy in a single trim, so trimming a large pool is spread over a few frames.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pooling")
+	int32 MaxTrimmedPerCall = 64;
+};
+
+/**
+ *	Counters for how the pool is being used.
+ */
+USTRUCT(BlueprintType)
+struct FShipPartPoolStats
+{
+	GENERATED_BODY()
+
+	// Parts currently sitting in the pool.
+	UPROPERTY(BlueprintReadOnly, Category = "Pooling")
+	int32 NumPooled = 0;
+
+	// Most parts that have been in the pool at once.
+	UPROPERTY(BlueprintReadOnly, Category = "Pooling")
+	int32 PeakPooled = 0;
+
+	// Parts handed back out of the pool rather than being spawned.
+	UPROPERTY(BlueprintReadOnly, Category = "Pooling")
+	int32 NumReused = 0;
+
+	// Requests that found nothing in the pool, so a new part had to be spawned.
+	UPROPERTY(BlueprintReadOnly, Category = "Pooling")
+	int32 NumMissed = 0;
+
+	// Parts returned to the pool.
+	UPROPERTY(BlueprintReadOnly, Category = "Pooling")
+	int32 NumReleased = 0;
+
+	// Parts destroyed by trimming or because the pool for their class was full.
+	UPROPERTY(BlueprintReadOnly, Category = "Pooling")
+	int32 NumDestroyed = 0;
+};
+
+/**
+ *	Pooled parts of a single class, oldest first.
+ */
+USTRUCT()
+struct FShipPartPoolBucket
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<AShipPart*> Parts;
+
+	// FPlatformTime::Seconds() when each part was released. Matches Parts.
+	TArray<double> ReleaseTimes;
+};
+
+/**
+ *	Keeps ship parts that have been removed from the ship so they can be handed out again instead of spawning new ones.
+ *	Pooled parts are hidden, have no collision and don't tick.
+ */
+UCLASS()
+class SHIPBUILDINGDEMO_API UShipPartPool : public UObject
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TMap<UClass*, FShipPartPoolBucket> Buckets;
+
+	UPROPERTY()
+	FShipPartPoolSettings Settings;
+
+	UPROPERTY()
+	FShipPartPoolStats Stats;
+
+public:
+	/**
+	 *	Takes a part out of the pool and wakes it back up.
+	 *
+	 *	@param PartClass: The class of part to get.
+	 *	@param Transform: Where to put the part.
+	 *	@return: The part or nullptr if there are none of the class in the pool.
+	 */
+	AShipPart* Acquire(UClass* PartClass, const FTransform& Transform);
+
+	/**
+	 *	Returns a part to the pool. Destroys it instead if the pool for its class is full.
+	 *	The part must already be removed from anything tracking it (ie. the assembly graph) and detached from any parts that aren't also being released.
+	 *
+	 *	@param ShipPart: The part to release.
+	 */
+	void Release(AShipPart* ShipPart);
+
+	/**
+	 *	Returns an array of parts to the pool and empties it. Pooling version of ShipUtils::DestroyActorArray.
+	 *
+	 *	@param ShipParts: The parts to release.
+	 *	@param bRetainSlack: Should the memory be left allocated.
+	 */
+	void ReleaseArray(TArray<AShipPart*>& ShipParts, bool bRetainSlack = false);
+
+	/**
+	 *	Destroys parts that have been in the pool longer than the max idle time, up to the max per call.
+	 *
+	 *	@return: The number of parts destroyed.
+	 */
+	int32 Trim();
+
+	// Destroys everything in the pool.
+	void Empty();
+
+	// Writes the stats to the log.
+	void LogStats() const;
+
+	FORCEINLINE void SetSettings(const FShipPartPoolSettings& InSettings) { Settings = InSettings; }
+	FORCEINLINE const FShipPartPoolSettings& GetSettings() const noexcept { return Settings; }
+	FORCEINLINE const FShipPartPoolStats& GetStats() const noexcept { return Stats; }
+};
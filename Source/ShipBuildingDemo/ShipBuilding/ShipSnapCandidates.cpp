@@ -0,0 +1,202 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipSnapCandidates.h"
+#include "ShipPart.h"
+#include "ShipPartGroup.h"
+
+namespace
+{
+	// Position used for padding pairs so they're never in range. Small enough that squaring it won't overflow.
+	static const float PaddingPosition = 1.e15f;
+}
+
+FShipSnapCandidates::FShipSnapCandidates()
+: NumPairs(0)
+, MaxDistSq(0.f)
+, AnchorLocation(ForceInitToZero)
+, HeldBoundsMin(ForceInitToZero)
+, HeldBoundsMax(ForceInitToZero)
+{
+}
+
+void FShipSnapCandidates::Reset(const FShipPartGroup& HeldGroup)
+{
+	check(HeldGroup.IsValid());
+	Reset(HeldGroup.GetShipPart()->GetActorLocation(), HeldGroup.GetSnapBounds(), HeldGroup.GetMinSnapDistance());
+}
+
+void FShipSnapCandidates::Reset(const FVector& HeldPartLocation, const FBox& HeldBounds, float MinSnapDistance)
+{
+	NumPairs = 0;
+	for (TArray<float>* Arr : { &OwnedX, &OwnedY, &OwnedZ, &OtherX, &OtherY, &OtherZ, &OtherMinX, &OtherMinY, &OtherMinZ, &OtherMaxX, &OtherMaxY, &OtherMaxZ })
+	{
+		ShipUtils::ClearArray(*Arr);
+	}
+
+	AnchorLocation = HeldPartLocation;
+	HeldBoundsMin = HeldBounds.Min - AnchorLocation;
+	HeldBoundsMax = HeldBounds.Max - AnchorLocation;
+	MaxDistSq = FMath::Square(MinSnapDistance);
+}
+
+void FShipSnapCandidates::Add(const FShipAttachPointRef& OwnedPoint, const FShipAttachPointRef& OtherPoint)
+{
+	check(OwnedPoint.IsValid() && OtherPoint.IsValid());
+	Add(OwnedPoint.GetLocation(), OtherPoint.GetLocation(), OtherPoint.ShipPart->GetSnapBounds().GetBox());
+}
+
+void FShipSnapCandidates::Add(const FVector& OwnedLocation, const FVector& OtherLocation, const FBox& OtherBounds)
+{
+	if (NumPairs == OwnedX.Num())
+	{
+		// Grow by a whole vector of padding pairs which get overwritten as pairs are added.
+		const FVector Padding{ PaddingPosition };
+		const FBox EmptyBounds{ Padding, -Padding };
+		const int32 FirstIndex = OwnedX.Num();
+		for (TArray<float>* Arr : { &OwnedX, &OwnedY, &OwnedZ, &OtherX, &OtherY, &OtherZ, &OtherMinX, &OtherMinY, &OtherMinZ, &OtherMaxX, &OtherMaxY, &OtherMaxZ })
+		{
+			Arr->AddUninitialized(VectorWidth);
+		}
+		for (int32 i = 0; i < VectorWidth; ++i)
+		{
+			SetPair(FirstIndex + i, FVector::ZeroVector, Padding, EmptyBounds);
+		}
+	}
+
+	SetPair(NumPairs, OwnedLocation - AnchorLocation, OtherLocation, OtherBounds);
+	++NumPairs;
+}
+
+int32 FShipSnapCandidates::FindBestPair(const FVector& HeldPartLocation) const
+{
+	if (NumPairs == 0)
+	{
+		return INDEX_NONE;
+	}
+
+	// Move the held bounds to where the part is now. Done before broadcasting so it matches the scalar version exactly.
+	const FVector HeldMin = HeldBoundsMin + HeldPartLocation;
+	const FVector HeldMax = HeldBoundsMax + HeldPartLocation;
+
+	const VectorRegister HeldX = VectorLoadFloat1(&HeldPartLocation.X);
+	const VectorRegister HeldY = VectorLoadFloat1(&HeldPartLocation.Y);
+	const VectorRegister HeldZ = VectorLoadFloat1(&HeldPartLocation.Z);
+	const VectorRegister HeldMinX = VectorLoadFloat1(&HeldMin.X);
+	const VectorRegister HeldMinY = VectorLoadFloat1(&HeldMin.Y);
+	const VectorRegister HeldMinZ = VectorLoadFloat1(&HeldMin.Z);
+	const VectorRegister HeldMaxX = VectorLoadFloat1(&HeldMax.X);
+	const VectorRegister HeldMaxY = VectorLoadFloat1(&HeldMax.Y);
+	const VectorRegister HeldMaxZ = VectorLoadFloat1(&HeldMax.Z);
+	const VectorRegister MaxDist = VectorLoadFloat1(&MaxDistSq);
+	const VectorRegister IndexStep = MakeVectorRegister(float(VectorWidth), float(VectorWidth), float(VectorWidth), float(VectorWidth));
+
+	// Each lane tracks the best pair it's seen. Indices are stored as floats which is exact well past any realistic pair count.
+	VectorRegister Indices = MakeVectorRegister(0.f, 1.f, 2.f, 3.f);
+	VectorRegister BestDistSq = MakeVectorRegister(FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX);
+	VectorRegister BestIndices = MakeVectorRegister(-1.f, -1.f, -1.f, -1.f);
+
+	const int32 NumPadded = OwnedX.Num();
+#if STATS
+	int32 NumBroadPhaseRejects = 0;
+#endif
+	for (int32 i = 0; i < NumPadded; i += VectorWidth)
+	{
+		// Distance between the points, with the owned point offset to where the held part is now.
+		const VectorRegister DX = VectorSubtract(VectorLoad(&OtherX[i]), VectorAdd(VectorLoad(&OwnedX[i]), HeldX));
+		const VectorRegister DY = VectorSubtract(VectorLoad(&OtherY[i]), VectorAdd(VectorLoad(&OwnedY[i]), HeldY));
+		const VectorRegister DZ = VectorSubtract(VectorLoad(&OtherZ[i]), VectorAdd(VectorLoad(&OwnedZ[i]), HeldZ));
+		const VectorRegister DistSq = VectorMultiplyAdd(DZ, DZ, VectorMultiplyAdd(DY, DY, VectorMultiply(DX, DX)));
+
+		// Broad phase; the snap bounds of both parts must overlap.
+		VectorRegister Mask = VectorBitwiseAnd(VectorCompareGE(VectorLoad(&OtherMaxX[i]), HeldMinX), VectorCompareGE(HeldMaxX, VectorLoad(&OtherMinX[i])));
+		Mask = VectorBitwiseAnd(Mask, VectorBitwiseAnd(VectorCompareGE(VectorLoad(&OtherMaxY[i]), HeldMinY), VectorCompareGE(HeldMaxY, VectorLoad(&OtherMinY[i]))));
+		Mask = VectorBitwiseAnd(Mask, VectorBitwiseAnd(VectorCompareGE(VectorLoad(&OtherMaxZ[i]), HeldMinZ), VectorCompareGE(HeldMaxZ, VectorLoad(&OtherMinZ[i]))));
+#if STATS
+		const int32 BroadPhaseBits = VectorMaskBits(Mask);
+		NumBroadPhaseRejects += VectorWidth - ((BroadPhaseBits & 1) + ((BroadPhaseBits >> 1) & 1) + ((BroadPhaseBits >> 2) & 1) + ((BroadPhaseBits >> 3) & 1));
+#endif
+
+		// Within snapping distance and closer than the lane's current best.
+		Mask = VectorBitwiseAnd(Mask, VectorCompareGE(MaxDist, DistSq));
+		Mask = VectorBitwiseAnd(Mask, VectorCompareGT(BestDistSq, DistSq));
+
+		BestDistSq = VectorSelect(Mask, DistSq, BestDistSq);
+		BestIndices = VectorSelect(Mask, Indices, BestIndices);
+		Indices = VectorAdd(Indices, IndexStep);
+	}
+
+	// The padding pairs' bounds are empty so they're always rejected, but they aren't real pairs.
+	INC_DWORD_STAT_BY(STAT_ShipSnapBroadPhaseRejects, NumBroadPhaseRejects - (NumPadded - NumPairs));
+
+	float LaneDistSq[VectorWidth];
+	float LaneIndices[VectorWidth];
+	VectorStore(BestDistSq, LaneDistSq);
+	VectorStore(BestIndices, LaneIndices);
+
+	// Reduce the lanes, preferring the lowest index on ties to match the scalar version.
+	int32 BestIndex = INDEX_NONE;
+	float BestLaneDistSq = FLT_MAX;
+	for (int32 Lane = 0; Lane < VectorWidth; ++Lane)
+	{
+		const int32 Index = FMath::TruncToInt(LaneIndices[Lane]);
+		if (Index == INDEX_NONE)
+		{
+			continue;
+		}
+
+		if (BestIndex == INDEX_NONE || LaneDistSq[Lane] < BestLaneDistSq || (LaneDistSq[Lane] == BestLaneDistSq && Index < BestIndex))
+		{
+			BestLaneDistSq = LaneDistSq[Lane];
+			BestIndex = Index;
+		}
+	}
+	return BestIndex;
+}
+
+int32 FShipSnapCandidates::FindBestPairScalar(const FVector& HeldPartLocation) const
+{
+	const FVector HeldMin = HeldBoundsMin + HeldPartLocation;
+	const FVector HeldMax = HeldBoundsMax + HeldPartLocation;
+
+	int32 BestIndex = INDEX_NONE;
+	float BestDistSq = FLT_MAX;
+	for (int32 i = 0; i < NumPairs; ++i)
+	{
+		// Broad phase check.
+		if (HeldMin.X > OtherMaxX[i] || OtherMinX[i] > HeldMax.X
+			|| HeldMin.Y > OtherMaxY[i] || OtherMinY[i] > HeldMax.Y
+			|| HeldMin.Z > OtherMaxZ[i] || OtherMinZ[i] > HeldMax.Z)
+		{
+			continue;
+		}
+
+		// Find the two nodes that are closest together and within the min snap distance.
+		const float DX = OtherX[i] - (OwnedX[i] + HeldPartLocation.X);
+		const float DY = OtherY[i] - (OwnedY[i] + HeldPartLocation.Y);
+		const float DZ = OtherZ[i] - (OwnedZ[i] + HeldPartLocation.Z);
+		const float DistSq = DX * DX + DY * DY + DZ * DZ;
+		if (DistSq <= MaxDistSq && DistSq < BestDistSq)
+		{
+			BestDistSq = DistSq;
+			BestIndex = i;
+		}
+	}
+	return BestIndex;
+}
+
+void FShipSnapCandidates::SetPair(int32 Index, const FVector& Owned, const FVector& Other, const FBox& OtherBounds)
+{
+	OwnedX[Index] = Owned.X;
+	OwnedY[Index] = Owned.Y;
+	OwnedZ[Index] = Owned.Z;
+	OtherX[Index] = Other.X;
+	OtherY[Index] = Other.Y;
+	OtherZ[Index] = Other.Z;
+	OtherMinX[Index] = OtherBounds.Min.X;
+	OtherMinY[Index] = OtherBounds.Min.Y;
+	OtherMinZ[Index] = OtherBounds.Min.Z;
+	OtherMaxX[Index] = OtherBounds.Max.X;
+	OtherMaxY[Index] = OtherBounds.Max.Y;
+	OtherMaxZ[Index] = OtherBounds.Max.Z;
+}
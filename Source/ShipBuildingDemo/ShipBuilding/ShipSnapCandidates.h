@@ -0,0 +1,105 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ShipAttachPointData.h"
+
+class FShipPartGroup;
+
+/**
+ *	Structure of arrays snapshot of the candidate point pairs for a held ship part, used to find which pair to snap together each tick.
+ *	The held points and bounds are stored relative to the held part's location so the snapshot stays valid while it's being dragged.
+ *	Normals and compatibility don't change while dragging so they're tested once when pairs are added rather than every tick.
+ */
+class SHIPBUILDINGDEMO_API FShipSnapCandidates
+{
+public:
+	FShipSnapCandidates();
+
+	/**
+	 *	Clears all pairs and sets up the snapshot for a new held part.
+	 *
+	 *	@param HeldGroup: The held part (and any parts moving with it) the owned points of each pair belong to.
+	 */
+	void Reset(const FShipPartGroup& HeldGroup);
+
+	/**
+	 *	Clears all pairs and sets up the snapshot for a held part described directly rather than by its group.
+	 *
+	 *	@param HeldPartLocation: The current location of the held part.
+	 *	@param HeldBounds: World space snap bounds of the held part and any parts moving with it.
+	 *	@param MinSnapDistance: Furthest apart two points can be and still snap.
+	 */
+	void Reset(const FVector& HeldPartLocation, const FBox& HeldBounds, float MinSnapDistance);
+
+	/**
+	 *	Adds a pair to the snapshot. Pairs keep the order they were added in.
+	 *
+	 *	@param OwnedPoint: The point on the held ship part or a part moving with it.
+	 *	@param OtherPoint: The point on another part it could snap to.
+	 */
+	void Add(const FShipAttachPointRef& OwnedPoint, const FShipAttachPointRef& OtherPoint);
+
+	/**
+	 *	Adds a pair to the snapshot from the points' world locations.
+	 *
+	 *	@param OwnedLocation: Location of the point on the held part or a part moving with it, with the held part where it was when the snapshot was reset.
+	 *	@param OtherLocation: Location of the point it could snap to.
+	 *	@param OtherBounds: World space snap bounds of the other point's part.
+	 */
+	void Add(const FVector& OwnedLocation, const FVector& OtherLocation, const FBox& OtherBounds);
+
+	/**
+	 *	Finds the closest pair whose points are within snapping distance and whose parts' snap bounds overlap.
+	 *	Evaluates 4 pairs at a time using vector registers.
+	 *
+	 *	@param HeldPartLocation: The current location of the held part.
+	 *	@return: The index of the closest pair or INDEX_NONE if none are in range.
+	 */
+	int32 FindBestPair(const FVector& HeldPartLocation) const;
+
+	/**
+	 *	Scalar version of FindBestPair. Returns the same result; used to cross check the vectorized version.
+	 */
+	int32 FindBestPairScalar(const FVector& HeldPartLocation) const;
+
+	FORCEINLINE int32 Num() const { return NumPairs; }
+
+private:
+	// Number of pairs evaluated at once by FindBestPair.
+	static const int32 VectorWidth = 4;
+
+	// Number of pairs in the arrays. The arrays are padded to a multiple of VectorWidth with pairs that can never snap.
+	int32 NumPairs;
+
+	// Squared snap distance of the held part.
+	float MaxDistSq;
+
+	// Location of the held part when the snapshot was reset.
+	FVector AnchorLocation;
+
+	// Held snap bounds relative to the held part's location.
+	FVector HeldBoundsMin;
+	FVector HeldBoundsMax;
+
+	// Owned point positions relative to the held part's location.
+	TArray<float> OwnedX;
+	TArray<float> OwnedY;
+	TArray<float> OwnedZ;
+
+	// World positions of the other points.
+	TArray<float> OtherX;
+	TArray<float> OtherY;
+	TArray<float> OtherZ;
+
+	// World space snap bounds of the other points' parts.
+	TArray<float> OtherMinX;
+	TArray<float> OtherMinY;
+	TArray<float> OtherMinZ;
+	TArray<float> OtherMaxX;
+	TArray<float> OtherMaxY;
+	TArray<float> OtherMaxZ;
+
+	// Writes a pair into all the arrays.
+	void SetPair(int32 Index, const FVector& Owned, const FVector& Other, const FBox& OtherBounds);
+};
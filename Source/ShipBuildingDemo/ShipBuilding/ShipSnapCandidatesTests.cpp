@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipSnapCandidates.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace ShipSnapCandidatesTests
+{
+	const float SnapDistance = 30.f;
+	const FBox HeldBounds{ FVector(-50.f), FVector(50.f) };
+
+	FBox MakeBounds(const FVector& Center, float Extent)
+	{
+		return FBox(Center - FVector(Extent), Center + FVector(Extent));
+	}
+
+	// Checks both versions pick the same pair, and returns it.
+	int32 FindBestPair(FAutomationTestBase& Test, const FShipSnapCandidates& Candidates, const FVector& HeldPartLocation)
+	{
+		const int32 Vectorized = Candidates.FindBestPair(HeldPartLocation);
+		const int32 Scalar = Candidates.FindBestPairScalar(HeldPartLocation);
+		Test.TestEqual(FString::Printf(TEXT("Best of %d pairs with the held part at %s"), Candidates.Num(), *HeldPartLocation.ToString()), Vectorized, Scalar);
+		return Scalar;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FShipSnapCandidatesTest, "ShipBuilding.SnapCandidates.VectorizedMatchesScalar", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FShipSnapCandidatesTest::RunTest(const FString& Parameters)
+{
+	using namespace ShipSnapCandidatesTests;
+
+	FShipSnapCandidates Candidates;
+
+	// Random pairs, some in range, some too far apart and some whose bounds don't overlap the held part's.
+	// Counts that aren't a multiple of 4 leave padding pairs in the last vector.
+	FRandomStream Random(1234);
+	const FVector HeldPartLocations[] = { FVector::ZeroVector, FVector(5.f, -3.f, 2.f), FVector(-20.f, 15.f, 0.f), FVector(400.f, 0.f, 0.f) };
+	int32 NumFound = 0;
+	for (int32 NumPairs = 0; NumPairs <= 13; ++NumPairs)
+	{
+		Candidates.Reset(FVector::ZeroVector, HeldBounds, SnapDistance);
+		for (int32 PairIndex = 0; PairIndex < NumPairs; ++PairIndex)
+		{
+			const FVector Owned = Random.GetUnitVector() * Random.FRandRange(0.f, 40.f);
+			const FVector Other = Owned + Random.GetUnitVector() * Random.FRandRange(0.f, 2.f * SnapDistance);
+			const FVector BoundsCenter = (Random.FRand() < 0.25f) ? Other + FVector(300.f, 0.f, 0.f) : Other;
+			Candidates.Add(Owned, Other, MakeBounds(BoundsCenter, Random.FRandRange(10.f, 60.f)));
+		}
+
+		for (const FVector& HeldPartLocation : HeldPartLocations)
+		{
+			NumFound += (FindBestPair(*this, Candidates, HeldPartLocation) != INDEX_NONE) ? 1 : 0;
+		}
+	}
+	TestTrue(TEXT("Some random pairs are in range"), NumFound > 0);
+
+	// Pairs 1, 4 and 5 are the same distance apart, so the lowest index wins even though pair 4 is in an earlier lane.
+	// Pair 2 is closer but its bounds don't overlap, and pair 3 is out of range.
+	Candidates.Reset(FVector::ZeroVector, HeldBounds, SnapDistance);
+	Candidates.Add(FVector::ZeroVector, FVector(20.f, 0.f, 0.f), MakeBounds(FVector(20.f, 0.f, 0.f), 10.f));
+	Candidates.Add(FVector(10.f, 0.f, 0.f), FVector(10.f, 10.f, 0.f), MakeBounds(FVector(10.f, 10.f, 0.f), 10.f));
+	Candidates.Add(FVector::ZeroVector, FVector(1.f, 0.f, 0.f), MakeBounds(FVector(500.f, 0.f, 0.f), 10.f));
+	Candidates.Add(FVector::ZeroVector, FVector(0.f, 0.f, 40.f), MakeBounds(FVector(0.f, 0.f, 40.f), 10.f));
+	Candidates.Add(FVector(10.f, 0.f, 0.f), FVector(10.f, 10.f, 0.f), MakeBounds(FVector(10.f, 10.f, 0.f), 10.f));
+	Candidates.Add(FVector(10.f, 0.f, 0.f), FVector(10.f, 10.f, 0.f), MakeBounds(FVector(10.f, 10.f, 0.f), 10.f));
+	TestEqual(TEXT("Ties go to the lowest index"), FindBestPair(*this, Candidates, FVector::ZeroVector), 1);
+
+	// Every pair is either too far apart or outside the held part's bounds.
+	Candidates.Reset(FVector::ZeroVector, HeldBounds, SnapDistance);
+	for (int32 PairIndex = 0; PairIndex < 7; ++PairIndex)
+	{
+		const FVector Other{ float(PairIndex) * 10.f, 0.f, 0.f };
+		const bool bTooFar = (PairIndex % 2) == 0;
+		Candidates.Add(bTooFar ? FVector(0.f, 0.f, -SnapDistance - 1.f) : FVector::ZeroVector, Other, MakeBounds(bTooFar ? Other : Other + FVector(0.f, 500.f, 0.f), 10.f));
+	}
+	TestEqual(TEXT("All pairs rejected"), FindBestPair(*this, Candidates, FVector::ZeroVector), (int32)INDEX_NONE);
+
+	return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -7,5 +7,6 @@ public class ShipBuildingDemo : ModuleRules
 	public ShipBuildingDemo(TargetInfo Target)
 	{
 		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "Slate", "SlateCore" });
+		PrivateDependencyModuleNames.AddRange(new string[] { "Json" });
 	}
 }
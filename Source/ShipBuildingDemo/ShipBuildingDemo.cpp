@@ -7,4 +7,23 @@ IMPLEMENT_PRIMARY_GAME_MODULE(FDefaultGameModuleImpl, ShipBuildingDemo, "ShipBui
 
 DEFINE_LOG_CATEGORY(LogFlying)
 
+DEFINE_STAT(STAT_ShipCollectCompatiblePoints);
+DEFINE_STAT(STAT_ShipCandidatePairs);
+DEFINE_STAT(STAT_ShipFindPointsToSnapTogether);
+DEFINE_STAT(STAT_ShipSnapPairsTested);
+DEFINE_STAT(STAT_ShipSnapBroadPhaseRejects);
+DEFINE_STAT(STAT_ShipSetCachedPointsHighlighted);
+DEFINE_STAT(STAT_ShipMakeShipPart);
+DEFINE_STAT(STAT_ShipMakeShipPartClassLoad);
+DEFINE_STAT(STAT_ShipMakeShipPartSpawn);
+DEFINE_STAT(STAT_ShipSaveShip);
+DEFINE_STAT(STAT_ShipEncodeShipData);
+DEFINE_STAT(STAT_ShipDataBytesEncoded);
+DEFINE_STAT(STAT_ShipSaveBytesWritten);
+DEFINE_STAT(STAT_ShipLoadShip);
+DEFINE_STAT(STAT_ShipDecodeShipData);
+DEFINE_STAT(STAT_ShipDataBytesDecoded);
+DEFINE_STAT(STAT_ShipLoadBytesRead);
+DEFINE_STAT(STAT_ShipPartFactoryInit);
+
  
\ No newline at end of file
@@ -7,6 +7,29 @@
 
 DECLARE_LOG_CATEGORY_EXTERN(LogFlying, Log, All);
 
+// Stats for the ship building hot paths. Shown with "stat ShipBuilding" and captured by "stat startfile".
+// Stats are gathered per thread, so the save and load stats can be updated from the workers that encode and write ships.
+DECLARE_STATS_GROUP(TEXT("ShipBuilding"), STATGROUP_ShipBuilding, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("CollectCompatiblePoints"), STAT_ShipCollectCompatiblePoints, STATGROUP_ShipBuilding, SHIPBUILDINGDEMO_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Candidate Pairs"), STAT_ShipCandidatePairs, STATGROUP_ShipBuilding, SHIPBUILDINGDEMO_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("FindPointsToSnapTogether"), STAT_ShipFindPointsToSnapTogether, STATGROUP_ShipBuilding, SHIPBUILDINGDEMO_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Snap Pairs Tested"), STAT_ShipSnapPairsTested, STATGROUP_ShipBuilding, SHIPBUILDINGDEMO_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Snap Broad Phase Rejects"), STAT_ShipSnapBroadPhaseRejects, STATGROUP_ShipBuilding, SHIPBUILDINGDEMO_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("SetCachedPointsHighlighted"), STAT_ShipSetCachedPointsHighlighted, STATGROUP_ShipBuilding, SHIPBUILDINGDEMO_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("MakeShipPart"), STAT_ShipMakeShipPart, STATGROUP_ShipBuilding, SHIPBUILDINGDEMO_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("MakeShipPart Class Load"), STAT_ShipMakeShipPartClassLoad, STATGROUP_ShipBuilding, SHIPBUILDINGDEMO_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("MakeShipPart Spawn"), STAT_ShipMakeShipPartSpawn, STATGROUP_ShipBuilding, SHIPBUILDINGDEMO_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("SaveShip"), STAT_ShipSaveShip, STATGROUP_ShipBuilding, SHIPBUILDINGDEMO_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("EncodeShipData"), STAT_ShipEncodeShipData, STATGROUP_ShipBuilding, SHIPBUILDINGDEMO_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Ship Data Bytes Encoded"), STAT_ShipDataBytesEncoded, STATGROUP_ShipBuilding, SHIPBUILDINGDEMO_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Save Bytes Written"), STAT_ShipSaveBytesWritten, STATGROUP_ShipBuilding, SHIPBUILDINGDEMO_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("LoadShip"), STAT_ShipLoadShip, STATGROUP_ShipBuilding, SHIPBUILDINGDEMO_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("DecodeShipData"), STAT_ShipDecodeShipData, STATGROUP_ShipBuilding, SHIPBUILDINGDEMO_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Ship Data Bytes Decoded"), STAT_ShipDataBytesDecoded, STATGROUP_ShipBuilding, SHIPBUILDINGDEMO_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Load Bytes Read"), STAT_ShipLoadBytesRead, STATGROUP_ShipBuilding, SHIPBUILDINGDEMO_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ShipPartFactory Init"), STAT_ShipPartFactoryInit, STATGROUP_ShipBuilding, SHIPBUILDINGDEMO_API);
+
 namespace ShipUtils
 {
 	/**
@@ -0,0 +1,426 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShipBuildingDemo.h"
+#include "ShipBenchCommandlet.h"
+#include "ShipEditorPlayerController.h"
+#include "ShipBuilding/ShipPart.h"
+#include "ShipBuilding/ShipPartFactory.h"
+#include "ShipBuilding/ShipPartPool.h"
+#include "Serialization/ShipSaveGame.h"
+#include "Json.h"
+
+DECLARE_LOG_CATEGORY_CLASS(LogShipBench, Log, All);
+
+namespace
+{
+	// Counts the allocations made through GMalloc while it's installed in front of the real allocator.
+	// Every thread is counted, as loading decodes the parts on worker threads.
+	class FShipBenchMallocCounter : public FMalloc
+	{
+		FMalloc* Inner;
+		FThreadSafeCounter64 NumAllocs;
+		FThreadSafeCounter64 NumBytes;
+
+	public:
+		explicit FShipBenchMallocCounter(FMalloc* InInner)
+		: Inner(InInner)
+		{
+		}
+
+		// Begin FMalloc Interface.
+		void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			NumAllocs.Increment();
+			NumBytes.Add(Count);
+			return Inner->Malloc(Count, Alignment);
+		}
+
+		void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			// A realloc to 0 is a free.
+			if (Count > 0)
+			{
+				NumAllocs.Increment();
+				NumBytes.Add(Count);
+			}
+			return Inner->Realloc(Original, Count, Alignment);
+		}
+
+		void Free(void* Original) override { Inner->Free(Original); }
+		SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+		bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+		void Trim() override { Inner->Trim(); }
+		void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+		void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+		bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+		bool ValidateHeap() override { return Inner->ValidateHeap(); }
+		const TCHAR* GetDescriptiveName() override { return TEXT("ShipBenchMallocCounter"); }
+		// End FMalloc Interface.
+
+		FORCEINLINE FMalloc* GetInner() const { return Inner; }
+		FORCEINLINE int64 GetNumAllocs() const { return NumAllocs.GetValue(); }
+		FORCEINLINE int64 GetNumBytes() const { return NumBytes.GetValue(); }
+	};
+
+	FShipBenchMallocCounter* MallocCounter = nullptr;
+
+	// The time and allocations of every call to one of the benchmarked functions.
+	struct FShipBenchOp
+	{
+		const TCHAR* Name;
+
+		// Name of a per-call value reported alongside the times (ie. the candidate pairs found). Null if there isn't one.
+		const TCHAR* CountName;
+
+		TArray<double> Milliseconds;
+		TArray<int64> Allocs;
+		TArray<int64> AllocBytes;
+		TArray<int64> Counts;
+
+		explicit FShipBenchOp(const TCHAR* InName, const TCHAR* InCountName = nullptr)
+		: Name(InName)
+		, CountName(InCountName)
+		{
+		}
+
+		// Times a call and records the allocations made during it.
+		template<typename FunctorType>
+		void Time(FunctorType&& Func)
+		{
+			const int64 StartAllocs = MallocCounter->GetNumAllocs();
+			const int64 StartBytes = MallocCounter->GetNumBytes();
+			const double StartTime = FPlatformTime::Seconds();
+
+			Func();
+
+			const double EndTime = FPlatformTime::Seconds();
+			Milliseconds.Add((EndTime - StartTime) * 1000.0);
+			Allocs.Add(MallocCounter->GetNumAllocs() - StartAllocs);
+			AllocBytes.Add(MallocCounter->GetNumBytes() - StartBytes);
+		}
+	};
+
+	// Gets the value that a fraction of the values are less than or equal to.
+	template<typename T>
+	T Percentile(TArray<T> Values, float Fraction)
+	{
+		if (Values.Num() == 0)
+		{
+			return T(0);
+		}
+
+		Values.Sort();
+		const int32 Index = FMath::Clamp(FMath::CeilToInt(Fraction * Values.Num()) - 1, 0, Values.Num() - 1);
+		return Values[Index];
+	}
+
+	void WriteOp(TJsonWriter<>& Writer, const FShipBenchOp& Op)
+	{
+		Writer.WriteObjectStart(Op.Name);
+		Writer.WriteValue(TEXT("calls"), Op.Milliseconds.Num());
+		Writer.WriteValue(TEXT("p50_ms"), Percentile(Op.Milliseconds, 0.5f));
+		Writer.WriteValue(TEXT("p99_ms"), Percentile(Op.Milliseconds, 0.99f));
+		Writer.WriteValue(TEXT("max_ms"), Percentile(Op.Milliseconds, 1.f));
+		Writer.WriteValue(TEXT("allocs_p50"), Percentile(Op.Allocs, 0.5f));
+		Writer.WriteValue(TEXT("allocs_p99"), Percentile(Op.Allocs, 0.99f));
+		Writer.WriteValue(TEXT("alloc_bytes_p50"), Percentile(Op.AllocBytes, 0.5f));
+		Writer.WriteValue(TEXT("alloc_bytes_p99"), Percentile(Op.AllocBytes, 0.99f));
+		if (Op.CountName)
+		{
+			Writer.WriteValue(FString(Op.CountName) + TEXT("_p50"), Percentile(Op.Counts, 0.5f));
+			Writer.WriteValue(FString(Op.CountName) + TEXT("_p99"), Percentile(Op.Counts, 0.99f));
+		}
+		Writer.WriteObjectEnd();
+
+		UE_LOG(LogShipBench, Display, TEXT("  %-26s p50 %9.3f ms, p99 %9.3f ms, p50 %6lld allocs"),
+			Op.Name, Percentile(Op.Milliseconds, 0.5f), Percentile(Op.Milliseconds, 0.99f), Percentile(Op.Allocs, 0.5f));
+	}
+
+	// Gets where to put a part of a synthetic ship. The parts are laid out in a cube, filling each row then each layer.
+	FVector GetSyntheticPartLocation(int32 PartIndex, int32 NumParts, float Spacing)
+	{
+		const int32 Side = FMath::Max(FMath::CeilToInt(FMath::Pow(NumParts, 1.f / 3.f)), 1);
+		return FVector(PartIndex % Side, (PartIndex / Side) % Side, PartIndex / (Side * Side)) * Spacing;
+	}
+
+	// Builds a ship of parts laid out in a cube, each saving every one of its SaveGame properties so there's something to decode.
+	FShipSnapshot MakeSyntheticShip(const TArray<UClass*>& PartClasses, int32 NumParts, float Spacing)
+	{
+		FShipSnapshot Snapshot;
+		TMap<FName, int32> PropertyIndices;
+		TArray<TArray<FShipPropertySnapshot>> TemplateProperties;
+
+		for (UClass* PartClass : PartClasses)
+		{
+			Snapshot.Templates.Add(PartClass->GetPathName());
+			TArray<FShipPropertySnapshot>& Properties = TemplateProperties[TemplateProperties.AddDefaulted()];
+
+			UObject* Defaults = PartClass->GetDefaultObject();
+			for (TFieldIterator<UProperty> It(PartClass); It; ++It)
+			{
+				UProperty* Property = *It;
+				if (!Property->HasAnyPropertyFlags(CPF_SaveGame))
+				{
+					continue;
+				}
+
+				const int32* NameIndex = PropertyIndices.Find(Property->GetFName());
+				if (!NameIndex)
+				{
+					NameIndex = &PropertyIndices.Add(Property->GetFName(), Snapshot.PropertyNames.Add(Property->GetFName()));
+				}
+
+				FShipPropertySnapshot& Saved = Properties[Properties.AddDefaulted()];
+				Saved.NameIndex = *NameIndex;
+
+				FMemoryWriter MemoryWriter{ Saved.Value };
+				FShipSaveGameArchiveProxy Archive{ MemoryWriter };
+				for (int32 i = 0; i < Property->ArrayDim; ++i)
+				{
+					Property->SerializeItem(Archive, Property->ContainerPtrToValuePtr<void>(Defaults, i), nullptr);
+				}
+			}
+		}
+
+		Snapshot.Parts.SetNum(NumParts);
+		for (int32 PartIndex = 0; PartIndex < NumParts; ++PartIndex)
+		{
+			FShipPartSnapshot& Part = Snapshot.Parts[PartIndex];
+			Part.TemplateIndex = PartIndex % PartClasses.Num();
+			Part.Transform.SetLocation(GetSyntheticPartLocation(PartIndex, NumParts, Spacing));
+			Part.Properties = TemplateProperties[Part.TemplateIndex];
+		}
+		return Snapshot;
+	}
+}
+
+UShipBenchCommandlet::UShipBenchCommandlet()
+{
+	// Nothing is rendered, so it can run with -nullrhi.
+	IsClient = false;
+	IsServer = false;
+	LogToConsole = true;
+
+	HelpDescription = TEXT("Times the ship editor's hot paths on synthetic ships and writes the p50/p99 times and allocations as JSON.");
+	HelpUsage = TEXT("-run=ShipBench -nullrhi [-Parts=100,1000,10000] [-Samples=200] [-Runs=5] [-Spacing=200] [-Output=Saved/ShipBench.json]");
+}
+
+int32 UShipBenchCommandlet::Main(const FString& Params)
+{
+	FString ShipSizesParam = TEXT("100,1000,10000");
+	FParse::Value(*Params, TEXT("Parts="), ShipSizesParam, false);
+	TArray<FString> ShipSizeStrings;
+	ShipSizesParam.ParseIntoArray(ShipSizeStrings, TEXT(","), true);
+	TArray<int32> ShipSizes;
+	for (const FString& ShipSizeString : ShipSizeStrings)
+	{
+		const int32 ShipSize = FCString::Atoi(*ShipSizeString);
+		if (ShipSize > 0)
+		{
+			ShipSizes.Add(ShipSize);
+		}
+	}
+
+	// Number of parts to grab for timing snapping, and number of times to save, clear and load each ship.
+	int32 NumSamples = 200;
+	int32 NumRuns = 5;
+	float Spacing = 200.f;
+	FString OutputPath = FPaths::GameSavedDir() / TEXT("ShipBench.json");
+	FParse::Value(*Params, TEXT("Samples="), NumSamples);
+	FParse::Value(*Params, TEXT("Runs="), NumRuns);
+	FParse::Value(*Params, TEXT("Spacing="), Spacing);
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+	NumSamples = FMath::Max(NumSamples, 1);
+	NumRuns = FMath::Max(NumRuns, 1);
+
+	// Kept around after the bench in case another thread is still inside it when the real allocator is put back.
+	static FShipBenchMallocCounter Counter(GMalloc);
+	MallocCounter = &Counter;
+	GMalloc = &Counter;
+
+	// Run everything in a game world through the same controller the editor uses.
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	World->InitializeActorsForPlay(FURL());
+	World->GetWorldSettings()->NotifyBeginPlay();
+
+	AShipEditorPlayerController* Controller = World->SpawnActorDeferred<AShipEditorPlayerController>(AShipEditorPlayerController::StaticClass(), FTransform::Identity);
+	// Don't touch the user's autosave, and load each part class when it's first made so it shows up in MakeShipPart.
+	Controller->AutosaveInterval = 0.f;
+	Controller->bRecoverAutosave = false;
+	Controller->bPreloadShipPartClasses = false;
+	Controller->FinishSpawning(FTransform::Identity);
+
+	UShipPartFactory* ShipPartFactory = Controller->GetShipPartFactory();
+	TArray<FName> PartNames;
+	for (const FShipPartData& PartData : ShipPartFactory->GetShipPartData())
+	{
+		PartNames.Add(PartData.Name);
+	}
+
+	int32 Result = 0;
+	if (PartNames.Num() == 0 || ShipSizes.Num() == 0)
+	{
+		UE_LOG(LogShipBench, Error, TEXT("Nothing to benchmark: %d part classes, %d ship sizes."), PartNames.Num(), ShipSizes.Num());
+		Result = 1;
+	}
+	else
+	{
+		FString Json;
+		TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+		Writer->WriteObjectStart();
+		Writer->WriteValue(TEXT("part_classes"), PartNames.Num());
+		Writer->WriteValue(TEXT("samples"), NumSamples);
+		Writer->WriteValue(TEXT("runs"), NumRuns);
+		Writer->WriteValue(TEXT("spacing"), Spacing);
+		Writer->WriteArrayStart(TEXT("ships"));
+
+		for (const int32 NumParts : ShipSizes)
+		{
+			UE_LOG(LogShipBench, Display, TEXT("%d parts:"), NumParts);
+
+			// Start from an empty pool so MakeShipPart is timed spawning parts. Loading reuses them from the pool like it does in game.
+			Controller->ClearShip();
+			ShipPartFactory->GetShipPartPool()->Empty();
+			CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+
+			// Cycle through the part classes.
+			FShipBenchOp MakeShipPartOp(TEXT("MakeShipPart"));
+			TArray<AShipPart*> NewParts;
+			NewParts.Reserve(NumParts);
+			for (int32 PartIndex = 0; PartIndex < NumParts; ++PartIndex)
+			{
+				const FVector Location = GetSyntheticPartLocation(PartIndex, NumParts, Spacing);
+				AShipPart* ShipPart = nullptr;
+				MakeShipPartOp.Time([&]() { ShipPart = ShipPartFactory->MakeShipPart(Controller, PartNames[PartIndex % PartNames.Num()], Location); });
+				if (ShipPart)
+				{
+					NewParts.Add(ShipPart);
+				}
+			}
+			Controller->AddLoadedShipParts(MoveTemp(NewParts));
+
+			// Grab parts spread through the ship as if the user had just picked them up.
+			FShipBenchOp CollectOp(TEXT("CollectCompatiblePoints"), TEXT("candidate_pairs"));
+			FShipBenchOp FindOp(TEXT("FindPointsToSnapTogether"), TEXT("pairs_tested"));
+			const TArray<AShipPart*>& ShipParts = Controller->ShipParts;
+			const int32 NumHeld = FMath::Min(NumSamples, ShipParts.Num());
+			for (int32 SampleIndex = 0; SampleIndex < NumHeld; ++SampleIndex)
+			{
+				AShipPart* ShipPart = ShipParts[(int64)SampleIndex * ShipParts.Num() / NumHeld];
+				FShipPartGroup Group;
+				Group.Init(ShipPart);
+				Controller->FreePointGrid.RemoveShipPart(ShipPart);
+
+				const FBox QueryBox = Group.GetSnapQueryBox().ExpandBy(Controller->FreePointGrid.GetCellSize());
+				TArray<FShipCompatibilityCache::FEntry> CompatiblePoints;
+				CollectOp.Time([&]() { Controller->CollectCompatiblePoints(Group, QueryBox, CompatiblePoints); });
+				CollectOp.Counts.Add(CompatiblePoints.Num());
+
+				FShipCompatibilityCache Cache;
+				Cache.Reset(Group, QueryBox, MoveTemp(CompatiblePoints));
+				const FShipSnapCandidates& Candidates = Cache.GetSnapCandidates();
+				FindOp.Time([&]() { Controller->FindPointsToSnapTogether(Candidates, ShipPart->GetActorLocation(), FVector::ZeroVector); });
+				FindOp.Counts.Add(Candidates.Num());
+
+				Controller->FreePointGrid.AddShipPart(ShipPart);
+			}
+
+			UShipSaveGame* ShipSaveData = Cast<UShipSaveGame>(UGameplayStatics::CreateSaveGameObject(UShipSaveGame::StaticClass()));
+			FShipBenchOp SaveOp(TEXT("SaveShip"), TEXT("bytes"));
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				SaveOp.Time([&]() { ShipSaveData->SaveShip(TEXT("ShipBench"), Controller->ShipParts); });
+				SaveOp.Counts.Add(ShipSaveData->GetShipDataSize());
+			}
+
+			FShipBenchOp ClearOp(TEXT("ClearShip"));
+			FShipBenchOp LoadOp(TEXT("LoadShip"), TEXT("parts"));
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				ClearOp.Time([&]() { Controller->ClearShip(); });
+
+				TArray<AShipPart*> LoadedParts;
+				LoadOp.Time([&]() { ShipSaveData->LoadShip(Controller, LoadedParts, ShipPartFactory->GetShipPartPool()); });
+				LoadOp.Counts.Add(LoadedParts.Num());
+				Controller->AddLoadedShipParts(MoveTemp(LoadedParts));
+			}
+
+			// Decode and spawn a ship saving every property with each of the ways of staging the parts, without a pool.
+			// The part classes have all been loaded by MakeShipPart by now.
+			Controller->ClearShip();
+			TArray<UClass*> PartClasses;
+			for (const FName& PartName : PartNames)
+			{
+				if (UClass* PartClass = ShipPartFactory->GetShipPartClass(PartName))
+				{
+					PartClasses.Add(PartClass);
+				}
+			}
+			TArray<uint8> SyntheticShipData;
+			if (PartClasses.Num() > 0)
+			{
+				MakeSyntheticShip(PartClasses, NumParts, Spacing).Encode(FShipSaveQuantization(), SyntheticShipData);
+			}
+			FShipBenchOp UnstagedOp(TEXT("LoadUnstaged"), TEXT("parts"));
+			FShipBenchOp StagedSingleThreadedOp(TEXT("LoadStagedSingleThreaded"), TEXT("parts"));
+			FShipBenchOp StagedParallelOp(TEXT("LoadStagedParallel"), TEXT("parts"));
+			const TPair<FShipBenchOp*, ShipLoadStaging::Type> StagingOps[] = {
+				{ &UnstagedOp, ShipLoadStaging::None },
+				{ &StagedSingleThreadedOp, ShipLoadStaging::SingleThreaded },
+				{ &StagedParallelOp, ShipLoadStaging::Parallel },
+			};
+			for (const TPair<FShipBenchOp*, ShipLoadStaging::Type>& StagingOp : StagingOps)
+			{
+				for (int32 Run = 0; Run < NumRuns; ++Run)
+				{
+					TArray<AShipPart*> LoadedParts;
+					StagingOp.Key->Time([&]()
+					{
+						FShipSnapshot Snapshot;
+						Snapshot.Decode(SyntheticShipData);
+						UShipSaveGame::SpawnSnapshot(World, Snapshot, LoadedParts, nullptr, StagingOp.Value);
+					});
+					StagingOp.Key->Counts.Add(LoadedParts.Num());
+
+					// Start each run from the same state.
+					ShipUtils::DestroyActorArray(LoadedParts);
+					CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+				}
+			}
+
+			Writer->WriteObjectStart();
+			Writer->WriteValue(TEXT("parts"), NumParts);
+			Writer->WriteObjectStart(TEXT("ops"));
+			for (const FShipBenchOp* Op : { &MakeShipPartOp, &CollectOp, &FindOp, &SaveOp, &ClearOp, &LoadOp, &UnstagedOp, &StagedSingleThreadedOp, &StagedParallelOp })
+			{
+				WriteOp(*Writer, *Op);
+			}
+			Writer->WriteObjectEnd();
+			Writer->WriteObjectEnd();
+		}
+
+		Writer->WriteArrayEnd();
+		Writer->WriteObjectEnd();
+		Writer->Close();
+
+		if (FFileHelper::SaveStringToFile(Json, *OutputPath))
+		{
+			UE_LOG(LogShipBench, Display, TEXT("Wrote results to %s"), *OutputPath);
+		}
+		else
+		{
+			UE_LOG(LogShipBench, Error, TEXT("Failed to write results to %s"), *OutputPath);
+			Result = 1;
+		}
+	}
+
+	Controller->ClearShip();
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+
+	GMalloc = Counter.GetInner();
+	MallocCounter = nullptr;
+	return Result;
+}
@@ -0,0 +1,27 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "ShipBenchCommandlet.generated.h"
+
+/**
+ *	Headless benchmark of the ship editor's hot paths, for catching performance regressions on build machines.
+ *	Builds synthetic ships out of the parts found by UShipPartFactory in a game world driven by an AShipEditorPlayerController,
+ *	then times making parts, collecting and searching snap candidates, saving, loading and clearing the ship, and loading with each way of staging the parts.
+ *	The p50/p99 time and allocations of each are written as JSON.
+ *
+ *	Usage: UE4Editor-Cmd ShipBuildingDemo.uproject -run=ShipBench -nullrhi [-Parts=100,1000] [-Samples=200] [-Runs=5] [-Spacing=200] [-Output=Path.json]
+ */
+UCLASS()
+class UShipBenchCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UShipBenchCommandlet();
+
+	// Begin UCommandlet Interface.
+	int32 Main(const FString& Params) override;
+	// End UCommandlet Interface.
+};
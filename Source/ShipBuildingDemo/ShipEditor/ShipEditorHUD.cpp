@@ -27,6 +27,46 @@ void AShipEditorHUD::BeginPlay()
 	PopulateShipParts(SPF->GetShipPartData());
 }
 
+float AShipEditorHUD::GetShipPartLoadProgress() const
+{
+	const UShipPartFactory* SPF = GetShipPartFactory();
+	return SPF ? SPF->GetClassPreloadProgress() : 0.f;
+}
+
+void AShipEditorHUD::GetShipPartsOfType(EPartType PartType, TArray<FShipPartData>& OutShipPartData) const
+{
+	OutShipPartData.Reset();
+	const UShipPartFactory* SPF = GetShipPartFactory();
+	if (SPF && SPF->HasLoadedAssetData())
+	{
+		const auto& ShipPartData = SPF->GetShipPartData();
+		for (const int32 PartIndex : SPF->GetShipPartsOfType(PartType))
+		{
+			OutShipPartData.Add(ShipPartData[PartIndex]);
+		}
+	}
+}
+
+void AShipEditorHUD::GetShipPartsCompatibleWith(EPartType PartType, TArray<FShipPartData>& OutShipPartData) const
+{
+	OutShipPartData.Reset();
+	const UShipPartFactory* SPF = GetShipPartFactory();
+	if (SPF && SPF->HasLoadedAssetData() && PartType != EPartType::PT_MAX)
+	{
+		const auto& ShipPartData = SPF->GetShipPartData();
+		for (const int32 PartIndex : SPF->GetShipPartsCompatibleWith(PartType))
+		{
+			OutShipPartData.Add(ShipPartData[PartIndex]);
+		}
+	}
+}
+
+const UShipPartFactory* AShipEditorHUD::GetShipPartFactory() const
+{
+	auto* PC = Cast<AShipEditorPlayerController>(GetOwningPlayerController());
+	return PC ? PC->GetShipPartFactory() : nullptr;
+}
+
 void AShipEditorHUD::PopulateShipParts_Implementation(const TArray<FShipPartData>& ShipPartData)
 {
 
@@ -21,4 +21,20 @@ public:
 protected:
 	UFUNCTION(BlueprintNativeEvent, Category=AShipEditorHUD)
 	void PopulateShipParts(const TArray<FShipPartData>& ShipPartData);
+
+	// Fraction of the ship part classes that have finished streaming in, 0-1.
+	UFUNCTION(BlueprintCallable, Category=AShipEditorHUD)
+	float GetShipPartLoadProgress() const;
+
+	// Gets the parts of a type for filling in a category tab.
+	UFUNCTION(BlueprintCallable, Category=AShipEditorHUD)
+	void GetShipPartsOfType(EPartType PartType, TArray<FShipPartData>& OutShipPartData) const;
+
+	// Gets the parts that can attach to a type of part. Only includes parts whose classes have been loaded.
+	UFUNCTION(BlueprintCallable, Category=AShipEditorHUD)
+	void GetShipPartsCompatibleWith(EPartType PartType, TArray<FShipPartData>& OutShipPartData) const;
+
+private:
+	// Gets the ship part factory from the owning player controller, or null if it hasn't been set up.
+	const UShipPartFactory* GetShipPartFactory() const;
 };
@@ -3,9 +3,33 @@
 #include "ShipBuildingDemo.h"
 #include "ShipEditorPlayerController.h"
 #include "ShipBuilding/ShipPart.h"
-#include "ShipBuilding/ShipAttachPoint.h"
 #include "Serialization/ShipSaveGame.h"
+#include "Serialization/ShipAsyncSave.h"
+#include "Serialization/ShipSaveFile.h"
 #include "ShipBuilding/ShipPartFactory.h"
+#include "ShipBuilding/ShipPartPool.h"
+#include "ShipBuilding/ShipPartInstances.h"
+
+static TAutoConsoleVariable<int32> CVarValidateSnapKernel(
+	TEXT("ShipEditor.ValidateSnapKernel"),
+	0,
+	TEXT("Cross checks the vectorized snap search against the scalar version every tick.\n")
+	TEXT("0: off, 1: on"),
+	ECVF_Cheat);
+
+static TAutoConsoleVariable<int32> CVarValidateCompatCache(
+	TEXT("ShipEditor.ValidateCompatCache"),
+	0,
+	TEXT("Compares the incrementally updated compatibility cache against a full recompute whenever it changes or is re-used.\n")
+	TEXT("0: off, 1: on"),
+	ECVF_Cheat);
+
+static TAutoConsoleVariable<int32> CVarValidateSaveRoundTrip(
+	TEXT("ShipEditor.ValidateSaveRoundTrip"),
+	0,
+	TEXT("Checks that the compact save data decodes to the same ship as the legacy format whenever a ship is saved, and logs the size of each.\n")
+	TEXT("0: off, 1: on"),
+	ECVF_Cheat);
 
 
 AShipEditorPlayerController::AShipEditorPlayerController()
@@ -20,7 +44,54 @@ void AShipEditorPlayerController::PostInitializeComponents()
 	Super::PostInitializeComponents();
 
 	ShipPartFactory = NewObject<UShipPartFactory>();
-	ShipPartFactory->Init("/Game/ShipParts");
+	ShipPartFactory->Init("/Game/ShipParts", bPreloadShipPartClasses);
+	ShipPartFactory->GetShipPartPool()->SetSettings(ShipPartPoolSettings);
+
+	// Keep the grid of free points up to date as points are attached/detached.
+	FreePointGrid = FShipAttachPointGrid(AttachPointGridCellSize);
+	PointsAttachedHandle = AShipPart::OnPointsAttached.AddUObject(this, &AShipEditorPlayerController::HandlePointsAttached);
+	PointsDetachedHandle = AShipPart::OnPointsDetached.AddUObject(this, &AShipEditorPlayerController::HandlePointsDetached);
+}
+
+void AShipEditorPlayerController::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (ShipPartPoolSettings.TrimInterval > 0.f)
+	{
+		GetWorldTimerManager().SetTimer(TrimShipPartPoolHandle, this, &AShipEditorPlayerController::TrimShipPartPool, ShipPartPoolSettings.TrimInterval, true);
+	}
+
+	if (AutosaveInterval > 0.f)
+	{
+		EditJournal = MakeShareable(new FShipEditJournal(FShipEditJournal::GetDefaultDirectory(), SaveQuantization, AutosaveCompactRecords));
+
+		// Recovering rebases the journal on the recovered ship, otherwise start it from the empty one.
+		if (!bRecoverAutosave || !RecoverAutosavedShip())
+		{
+			EditJournal->Rebase(ShipParts);
+		}
+		GetWorldTimerManager().SetTimer(AutosaveHandle, this, &AShipEditorPlayerController::FlushEditJournal, AutosaveInterval, true);
+	}
+}
+
+void AShipEditorPlayerController::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	GetWorldTimerManager().ClearTimer(TrimShipPartPoolHandle);
+	GetWorldTimerManager().ClearTimer(AutosaveHandle);
+	CancelShipLoad();
+
+	// Shutting down cleanly, so there's nothing to recover.
+	if (EditJournal.IsValid())
+	{
+		EditJournal->Discard();
+		EditJournal.Reset();
+	}
+
+	AShipPart::OnPointsAttached.Remove(PointsAttachedHandle);
+	AShipPart::OnPointsDetached.Remove(PointsDetachedHandle);
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void AShipEditorPlayerController::SetupInputComponent()
@@ -37,43 +108,120 @@ void AShipEditorPlayerController::OnClick()
 {
 	checkf(!HoldingShipPart(), TEXT("Can't click when already holding a ship part"));
 
+	// The parts being streamed in aren't tracked until they've all been spawned.
+	if (IsLoadingShip())
+	{
+		return;
+	}
+
 	FHitResult Hit;
 	if (!GetHitResultUnderCursor(ECollisionChannel::ECC_Visibility, true, Hit))
 	{
 		return;
 	}
 
-	if (Hit.Actor.IsValid() && Hit.Actor->IsA<AShipPart>())
+	// Parts that aren't being edited are drawn as instances, in which case the hit is on the instanced mesh rather than the part.
+	AShipPart* ClickedPart = Cast<AShipPart>(Hit.GetActor());
+	if (!ClickedPart)
+	{
+		if (const AShipPartInstances* PartInstances = Cast<AShipPartInstances>(Hit.GetActor()))
+		{
+			ClickedPart = PartInstances->GetPartFromHit(Hit);
+		}
+	}
+
+	if (ClickedPart)
 	{
-		UE_LOG(LogTemp, Log, TEXT("Clicked ship part: %s"), *GetNameSafe(Hit.GetActor()));
+		UE_LOG(LogTemp, Log, TEXT("Clicked ship part: %s"), *GetNameSafe(ClickedPart));
 
-		CurrentlyHeldShipPart = Cast<AShipPart>(Hit.GetActor());
-		if (ensure(CurrentlyHeldShipPart != nullptr))
+		CurrentlyHeldShipPart = ClickedPart;
+
+		// TODO: remove this if we end up removing all the logic anyway.
+		CurrentlyHeldShipPart->Select();
+
+		// Pick up everything attached to the part along with it if we're dragging subassemblies.
+		const bool bDragGroup = bDragSubassemblies || IsInputKeyDown(EKeys::LeftAlt) || IsInputKeyDown(EKeys::RightAlt);
+		if (bDragGroup && AssemblyGraph.IsAttached(CurrentlyHeldShipPart))
 		{
-			// TODO: remove this if we end up removing all the logic anyway.
-			CurrentlyHeldShipPart->Select();
+			TArray<AShipPart*> Subassembly;
+			AssemblyGraph.GetConnectedParts(CurrentlyHeldShipPart, Subassembly);
+			HeldGroup.Init(CurrentlyHeldShipPart, Subassembly);
+		}
+		else
+		{
+			HeldGroup.Init(CurrentlyHeldShipPart);
+		}
 
-			// Collect and store all points compatible with the currently held one so we don't have to re-lookup every tick.
-			CollectCompatiblePoints(CurrentlyHeldShipPart, CachedCompatiblePoints);
-			SetCachedPointsHighlighted(true, CachedCompatiblePoints);
+		// The held parts move every frame, so they get their own meshes back until they're released.
+		for (AShipPart* ShipPart : HeldGroup.GetParts())
+		{
+			ShipPart->Materialize();
+		}
+		if (HeldGroup.IsGroup())
+		{
+			SetGroupAttachedToHeldPart(true);
+		}
+
+		// Nothing can snap to the held points while they're moving, so take them out of the grid until they're released.
+		for (AShipPart* ShipPart : HeldGroup.GetParts())
+		{
+			FreePointGrid.RemoveShipPart(ShipPart);
+		}
+
+		// Collect and store all nearby points compatible with the currently held one so we don't have to re-lookup every tick.
+		// If it's the same part as last time and it hasn't moved then the cache will have been kept up to date.
+		if (!HeldGroup.IsGroup() && CompatibilityCache.IsValidFor(CurrentlyHeldShipPart, HeldGroup.GetSnapQueryBox()))
+		{
+			ValidateCompatibilityCache();
+			SetCachedPointsHighlighted(true, CompatibilityCache.GetEntries());
+		}
+		else
+		{
+			RefreshCachedCompatiblePoints();
 		}
 	}
 }
 
 void AShipEditorPlayerController::OnReleaseClick()
+{
+	ReleaseHeldParts(nullptr);
+}
+
+void AShipEditorPlayerController::ReleaseHeldParts(AShipPart* PartToDestroy)
 {
 	if (HoldingShipPart())
 	{
 		UE_LOG(LogTemp, Log, TEXT("Released ship part: %s"), *GetNameSafe(CurrentlyHeldShipPart));
 		CurrentlyHeldShipPart->Deselect();
-		CurrentlyHeldShipPart = nullptr;
 
-		SetCachedPointsHighlighted(false, CachedCompatiblePoints);
+		if (HeldGroup.IsGroup())
+		{
+			SetGroupAttachedToHeldPart(false);
+		}
+
+		// Dematerializing the part to be destroyed would only have it materialized again when it's released to the pool.
+		TArray<AShipPart*> ReleasedParts = HeldGroup.GetParts();
+		ReleasedParts.Remove(PartToDestroy);
+		for (AShipPart* ShipPart : ReleasedParts)
+		{
+			FreePointGrid.AddShipPart(ShipPart);
+			if (EditJournal.IsValid())
+			{
+				EditJournal->RecordMove(ShipPart);
+			}
+		}
+		DematerializeIdleParts(ReleasedParts);
+
+		// Keep the cache around in case the same part is selected again.
+		// The points a group can snap with depend on how it's attached, so only a single part's cache is worth keeping.
+		SetCachedPointsHighlighted(false, CompatibilityCache.GetEntries());
+		if (HeldGroup.IsGroup())
+		{
+			CompatibilityCache.Invalidate();
+		}
 
-		// Clear the cache but keep the memory allocated.
-		// TODO: track the last selected part and re-use the cache if we select the same one we just did.
-		// Will involve invalidation when a new part is created though.
-		ShipUtils::ClearArray(CachedCompatiblePoints);
+		HeldGroup.Reset();
+		CurrentlyHeldShipPart = nullptr;
 	}
 }
 
@@ -82,8 +230,11 @@ void AShipEditorPlayerController::DeleteSelectedPart()
 	if (CurrentlyHeldShipPart)
 	{
 		UE_LOG(LogTemp, Log, TEXT("Destroying ship part: %s"), *GetNameSafe(CurrentlyHeldShipPart));
-		DestroyShipPart(CurrentlyHeldShipPart);
-		OnReleaseClick();
+		AShipPart* ShipPart = CurrentlyHeldShipPart;
+
+		// Release first so any parts being dragged with it are detached from it.
+		ReleaseHeldParts(ShipPart);
+		DestroyShipPart(ShipPart);
 	}
 }
 
@@ -91,6 +242,11 @@ void AShipEditorPlayerController::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
+	if (StreamingLoad.IsValid())
+	{
+		TickStreamingLoad();
+	}
+
 	if (!HoldingShipPart())
 	{
 		return;
@@ -109,41 +265,45 @@ void AShipEditorPlayerController::Tick(float DeltaTime)
 		FVector NewPosition = WorldLocation + WorldDirection * Dist;
 		const FVector Delta = NewPosition - PreviousHeldPartLocation;
 
-		if (CurrentlyHeldShipPart->IsAttached())
+		const bool bAttached = HeldGroup.IsGroup() ? HeldGroup.IsAttachedToOthers() : AssemblyGraph.IsAttached(CurrentlyHeldShipPart);
+		if (bAttached)
 		{
 			// Mouse hasn't moved far enough to un-snap.
-			if (Delta.Size() < CurrentlyHeldShipPart->GetMinSnapDistance())
+			if (Delta.Size() < HeldGroup.GetMinSnapDistance())
 			{
 				return;
 			}
 
-			// Detach the current ship part
-			CurrentlyHeldShipPart->DetatchAllPoints();
-
-			// Re-compute
-			CollectCompatiblePoints(CurrentlyHeldShipPart, CachedCompatiblePoints);
-			SetCachedPointsHighlighted(true, CachedCompatiblePoints);
+			// Detach the held part(s) from the rest of the ship. The points they were attached to get added to the cache as they're freed.
+			HeldGroup.DetachFromOthers();
+		}
+		else if (!CompatibilityCache.GetQueryBox().IsInside(HeldGroup.GetSnapQueryBox()))
+		{
+			// Moved far enough that there could be points in range that aren't in the cache.
+			RefreshCachedCompatiblePoints();
 		}
 
 		// Search the cache for any entry whose two points meet the requirements to snap together.
-		const int32 CacheIndex = FindPointsToSnapTogether(CachedCompatiblePoints, Delta);
+		const int32 CacheIndex = FindPointsToSnapTogether(CompatibilityCache.GetSnapCandidates(), PreviousHeldPartLocation, Delta);
 		if (CacheIndex != INDEX_NONE)
 		{
 			// Offset the ship part by the delta of the attach points.
-			FAttachPointCacheEntry& BestEntry = CachedCompatiblePoints[CacheIndex];
-			UShipAttachPoint* OwnedPoint = BestEntry.OwnedPoint;
-			UShipAttachPoint* OtherPoint = BestEntry.OtherPoint;
-			// TODO: use surface position rather than component point so they don't need to be positioned perfectly.
-			const FVector PointDelta = OtherPoint->GetComponentLocation() - OwnedPoint->GetComponentLocation();
+			// Copy the entry as attaching the points removes it from the cache.
+			const FAttachPointCacheEntry BestEntry = CompatibilityCache.GetEntries()[CacheIndex];
+			const FShipAttachPointRef& OwnedPoint = BestEntry.OwnedPoint;
+			const FShipAttachPointRef& OtherPoint = BestEntry.OtherPoint;
+			// TODO: use surface position rather than the point's location so they don't need to be positioned perfectly.
+			const FVector PointDelta = OtherPoint.GetLocation() - OwnedPoint.GetLocation();
 			if (!PointDelta.IsNearlyZero()) // This shouldn't be an issue.
 			{
 				NewPosition = CurrentlyHeldShipPart->GetActorLocation() + PointDelta;
 
-				//UE_LOG(LogTemp, Log, TEXT("Attached %s and %s"), *GetNameSafe(OwnedPoint), *GetNameSafe(OtherPoint));
-				UShipAttachPoint::AttachPoints(OwnedPoint, OtherPoint);
+				//UE_LOG(LogTemp, Log, TEXT("Attached %s and %s"), *GetNameSafe(OwnedPoint.ShipPart), *GetNameSafe(OtherPoint.ShipPart));
+				AShipPart::AttachPointPair(OwnedPoint, OtherPoint);
 			}
 		}
 
+		// Any other parts in the group are attached to the held part, so this moves the whole group.
 		CurrentlyHeldShipPart->SetActorLocation(NewPosition);
 	}
 }
@@ -155,6 +315,17 @@ void AShipEditorPlayerController::SpawnShipPart(FName PartName)
 		UE_LOG(LogTemp, Log, TEXT("Successfully created part: %s"), *PartName.ToString());
 		// Add the part to our internal list.
 		ShipParts.Add(ShipPart);
+		AssemblyGraph.AddPart(ShipPart);
+		if (EditJournal.IsValid())
+		{
+			EditJournal->RecordSpawn(ShipPart);
+		}
+		FreePointGrid.AddShipPart(ShipPart);
+		for (int32 PointIndex = 0; PointIndex < ShipPart->GetNumAttachPoints(); ++PointIndex)
+		{
+			AddFreePointToCache(FShipAttachPointRef(ShipPart, PointIndex));
+		}
+		DematerializeIdleParts({ ShipPart });
 	}
 	else
 	{
@@ -162,10 +333,72 @@ void AShipEditorPlayerController::SpawnShipPart(FName PartName)
 	}
 }
 
+void AShipEditorPlayerController::HandlePointsAttached(const FShipAttachPointRef& A, const FShipAttachPointRef& B)
+{
+	AssemblyGraph.AddEdge(A, B);
+	if (EditJournal.IsValid())
+	{
+		EditJournal->RecordAttach(A, B);
+	}
+	FreePointGrid.RemovePoint(A);
+	FreePointGrid.RemovePoint(B);
+
+	// Attaching un-highlights the points so there's nothing else to update.
+	CompatibilityCache.RemoveFreePoint(A);
+	CompatibilityCache.RemoveFreePoint(B);
+	ValidateCompatibilityCache();
+}
+
+void AShipEditorPlayerController::HandlePointsDetached(const FShipAttachPointRef& A, const FShipAttachPointRef& B)
+{
+	AssemblyGraph.RemoveEdge(A, B);
+	if (EditJournal.IsValid())
+	{
+		EditJournal->RecordDetach(A, B);
+	}
+
+	// The held points are added back to the grid once they're released.
+	for (const FShipAttachPointRef& Point : { A, B })
+	{
+		if (!HeldGroup.Contains(Point.GetOwningShipPart()))
+		{
+			FreePointGrid.AddPoint(Point);
+		}
+	}
+
+	AddFreePointToCache(A);
+	AddFreePointToCache(B);
+	ValidateCompatibilityCache();
+}
+
+void AShipEditorPlayerController::AddFreePointToCache(const FShipAttachPointRef& Point)
+{
+	const int32 NumAdded = CompatibilityCache.AddFreePoint(Point);
+	if (NumAdded > 0 && HoldingShipPart())
+	{
+		// New pairs are always added to the end.
+		const auto& Entries = CompatibilityCache.GetEntries();
+		for (int32 i = Entries.Num() - NumAdded; i < Entries.Num(); ++i)
+		{
+			Entries[i].OwnedPoint.SetHighlighted(true);
+			Entries[i].OtherPoint.SetHighlighted(true);
+		}
+	}
+}
+
+void AShipEditorPlayerController::ValidateCompatibilityCache() const
+{
+	if (CVarValidateCompatCache.GetValueOnGameThread())
+	{
+		ensureMsgf(CompatibilityCache.Validate(ShipParts), TEXT("Compatibility cache doesn't match a full recompute."));
+	}
+}
+
 // NOTE: this will have to be re-calculated if we allow rotating parts.
-bool AShipEditorPlayerController::CollectCompatiblePoints(const AShipPart* ShipPart, TArray<FAttachPointCacheEntry>& OutCompatiblePoints) const
+bool AShipEditorPlayerController::CollectCompatiblePoints(const FShipPartGroup& Group, const FBox& QueryBox, TArray<FAttachPointCacheEntry>& OutCompatiblePoints) const
 {
-	check(ShipPart);
+	SCOPE_CYCLE_COUNTER(STAT_ShipCollectCompatiblePoints);
+	check(Group.IsValid());
 	
 	ShipUtils::ClearArray(OutCompatiblePoints);
 
@@ -173,108 +406,124 @@ bool AShipEditorPlayerController::CollectCompatiblePoints(const AShipPart* ShipP
 	// Will be needed for snapping parts onto non-flat surfaces.
 	static constexpr float AllowedAngleDifference = 0.f; // Radians
 
-	// Grab the attach points for the selected part to avoid fetching inside the loop.
-	const EPartType SelectedPartType = ShipPart->GetPartType();
-	const auto& AttachPoints = ShipPart->GetAttachPoints();
+	// Grab the attach points for the selected part(s) to avoid fetching inside the loop.
+	const auto& AttachPoints = Group.GetPoints();
 	if (AttachPoints.Num() == 0)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Ship part %s has no attach points."), *GetNameSafe(ShipPart));
+		UE_LOG(LogTemp, Warning, TEXT("Ship part %s has no free attach points."), *GetNameSafe(Group.GetShipPart()));
 		return false;
 	}
 
-	// Go through all the ship parts.
-	// TODO: ensure the ship parts array is correctly populated when ships are loaded in when that's implemented.
-	for (AShipPart* OtherPart : ShipParts)
-	{
-		// Ignore the part we're checking
-		if (OtherPart == ShipPart)
-		{
-			continue;
-		}
+	// Only the free points near the selected part can be snapped to, so there's no need to go through the whole ship.
+	TArray<FShipAttachPointGrid::FEntry> NearbyPoints;
+	FreePointGrid.QueryBox(QueryBox, NearbyPoints);
 
-		// Does the other part have any points that are compatible with the selected part?
-		const EPartType OtherPartType = OtherPart->GetPartType();
-		auto PointsCompatibleWithSelected = OtherPart->GetPointsCompatibleWith(SelectedPartType);
-		if (PointsCompatibleWithSelected.Num() == 0)
+	for (const auto& Entry : NearbyPoints)
+	{
+		// Ignore the part(s) we're checking
+		const AShipPart* OtherPart = Entry.Point.GetOwningShipPart();
+		if (Group.Contains(OtherPart))
 		{
 			continue;
 		}
 
-		// Check if the selected part has any points that are compatible with the other part.
-		for (auto* AttachPoint : AttachPoints)
+		// Check if the selected part(s) have any points that are compatible with the other part, and vice versa.
+		const FShipAttachPointRef& OtherPoint = Entry.Point;
+		const FVector OtherNormal = OtherPoint.GetNormal();
+		for (const FShipAttachPointRef& AttachPoint : AttachPoints)
 		{
-			if (!AttachPoint->IsCompatibleWith(OtherPartType))
+			const FShipAttachPointData& AttachPointData = AttachPoint.GetData();
+			const FShipPartTypeMask SelectedPartType{ AttachPoint.ShipPart->GetPartType() };
+			if (!Entry.CompatibleParts.Intersects(SelectedPartType) || !AttachPointData.CompatibleMask.Intersects(Entry.OwnerPartType))
 			{
 				continue;
 			}
 
-			// Iter through all the compatible points on the other part
-			for (auto* OtherPoint : PointsCompatibleWithSelected)
+			// TODO: test points against all filters defined by the selected part if we need that kind of granularity.
+			// If the normals aren't within the allowed range then ignore them.
+			const float Dot = FVector::DotProduct(AttachPoint.GetNormal(), OtherNormal);
+			if (!FMath::IsNearlyEqual(Dot, -1.f, THRESH_NORMALS_ARE_PARALLEL))
 			{
-				// TODO: test points against all filters defined by the selected part if we need that kind of granularity.
-				// If the normals aren't within the allowed range then ignore them.
-				const float Dot = FVector::DotProduct(AttachPoint->GetNormal(), OtherPoint->GetNormal());
-				if (!FMath::IsNearlyEqual(Dot, -1.f, THRESH_NORMALS_ARE_PARALLEL))
-				{
-					continue;
-				}
-
-				OutCompatiblePoints.Add({ AttachPoint, OtherPoint });
+				continue;
 			}
+
+			OutCompatiblePoints.Add({ AttachPoint, OtherPoint });
 		}
 	}
+
+	INC_DWORD_STAT_BY(STAT_ShipCandidatePairs, OutCompatiblePoints.Num());
 	return (OutCompatiblePoints.Num() > 0);
 }
 
-void AShipEditorPlayerController::SetCachedPointsHighlighted(bool bHighlighted, TArray<FAttachPointCacheEntry>& InPoints) const
+void AShipEditorPlayerController::RefreshCachedCompatiblePoints()
+{
+	check(CurrentlyHeldShipPart);
+
+	SetCachedPointsHighlighted(false, CompatibilityCache.GetEntries());
+
+	// Search a cell further than needed so we only have to re-collect once the part has moved a decent amount.
+	const FBox QueryBox = HeldGroup.GetSnapQueryBox().ExpandBy(FreePointGrid.GetCellSize());
+	TArray<FAttachPointCacheEntry> CompatiblePoints;
+	CollectCompatiblePoints(HeldGroup, QueryBox, CompatiblePoints);
+	CompatibilityCache.Reset(HeldGroup, QueryBox, MoveTemp(CompatiblePoints));
+	ValidateCompatibilityCache();
+
+	SetCachedPointsHighlighted(true, CompatibilityCache.GetEntries());
+}
+
+void AShipEditorPlayerController::SetGroupAttachedToHeldPart(bool bAttach)
 {
+	check(CurrentlyHeldShipPart);
+
+	// Attaching lets the engine propagate the held part's transform to the rest of the group in one update rather than moving each part separately.
+	for (AShipPart* ShipPart : HeldGroup.GetParts())
+	{
+		if (ShipPart == CurrentlyHeldShipPart)
+		{
+			continue;
+		}
+
+		if (bAttach)
+		{
+			ShipPart->AttachToActor(CurrentlyHeldShipPart, FAttachmentTransformRules::KeepWorldTransform);
+		}
+		else
+		{
+			ShipPart->DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+		}
+	}
+}
+
+void AShipEditorPlayerController::SetCachedPointsHighlighted(bool bHighlighted, const TArray<FAttachPointCacheEntry>& InPoints) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShipSetCachedPointsHighlighted);
 	for (auto& Entry : InPoints)
 	{
 		check(Entry.IsValid());
-		Entry.OwnedPoint->SetHighlighted(bHighlighted);
-		Entry.OtherPoint->SetHighlighted(bHighlighted);
+		Entry.OwnedPoint.SetHighlighted(bHighlighted);
+		Entry.OtherPoint.SetHighlighted(bHighlighted);
 	}
 }
 
-int32 AShipEditorPlayerController::FindPointsToSnapTogether(const TArray<FAttachPointCacheEntry>& CompatiblePoints, const FVector& Delta) const
+int32 AShipEditorPlayerController::FindPointsToSnapTogether(const FShipSnapCandidates& Candidates, const FVector& HeldPartLocation, const FVector& Delta) const
 {
-	if (CachedCompatiblePoints.Num() == 0)
+	SCOPE_CYCLE_COUNTER(STAT_ShipFindPointsToSnapTogether);
+	if (Candidates.Num() == 0)
 	{
 		return INDEX_NONE;
 	}
 
-	// Cache these outside the loop as they won't change per entry.
-	const AShipPart* ShipPart = CompatiblePoints[0].OwnedPoint->GetOwningShipPart();
-	const FBoxSphereBounds HeldSnapBounds = ShipPart->GetSnapBounds();
+	// Broad phase rejects are counted by FindBestPair.
+	INC_DWORD_STAT_BY(STAT_ShipSnapPairsTested, Candidates.Num());
 
-	int32 BestIndex = INDEX_NONE;
-	float BestDistSq = FLT_MAX;
-	for (int32 i = 0; i < CompatiblePoints.Num(); ++i)
-	{
-		const auto& CacheEntry = CompatiblePoints[i];
-		const UShipAttachPoint* OwnedPoint = CacheEntry.OwnedPoint;
-		const UShipAttachPoint* OtherPoint = CacheEntry.OtherPoint;
-		const AShipPart* OtherPart = OtherPoint->GetOwningShipPart();
-		checkf(OwnedPoint != OtherPoint, TEXT("OwnedPoint and OtherPoint should not be the same."));
-		checkf(ShipPart != OtherPart, TEXT("ShipPart should not be linked to itself in cache."));
-
-		// TODO: offset owned points by delta
-		// TODO: check delta is in direction of cached point/part. (Probably only needed for super small pieces maybe).
-
-		// Broad phase check.
-		if (!FBoxSphereBounds::BoxesIntersect(HeldSnapBounds, OtherPart->GetSnapBounds()))
-		{
-			continue;
-		}
+	// TODO: offset owned points by delta
+	// TODO: check delta is in direction of cached point/part. (Probably only needed for super small pieces maybe).
+	const int32 BestIndex = Candidates.FindBestPair(HeldPartLocation);
 
-		// Find the two nodes that are closest together and within the min snap distance.
-		const float MinSnapDistanceSq = FMath::Square(ShipPart->GetMinSnapDistance());
-		const float DistSq = FVector::DistSquared(OwnedPoint->GetComponentLocation(), OtherPoint->GetComponentLocation());
-		if (DistSq <= MinSnapDistanceSq && DistSq < BestDistSq)
-		{
-			BestDistSq = DistSq;
-			BestIndex = i;
-		}
+	if (CVarValidateSnapKernel.GetValueOnGameThread())
+	{
+		const int32 ScalarBestIndex = Candidates.FindBestPairScalar(HeldPartLocation);
+		ensureMsgf(BestIndex == ScalarBestIndex, TEXT("Vectorized snap search found pair %d but the scalar version found %d"), BestIndex, ScalarBestIndex);
 	}
 
 	return BestIndex;
@@ -288,15 +537,53 @@ void AShipEditorPlayerController::DestroyShipPart(AShipPart* ShipPart)
 		return;
 	}
 
-	ShipParts.Remove(CurrentlyHeldShipPart);
+	ShipParts.Remove(ShipPart);
 	ShipPart->DetatchAllPoints();
-	ShipPart->Destroy();
+	AssemblyGraph.RemovePart(ShipPart);
+	if (EditJournal.IsValid())
+	{
+		EditJournal->RecordDestroy(ShipPart);
+	}
+	FreePointGrid.RemoveShipPart(ShipPart);
+
+	// Removing a cached part throws its pairs away, so un-highlight them first.
+	if (CompatibilityCache.GetHeldGroup().Contains(ShipPart))
+	{
+		SetCachedPointsHighlighted(false, CompatibilityCache.GetEntries());
+	}
+	CompatibilityCache.RemoveShipPart(ShipPart);
+	ValidateCompatibilityCache();
+	ShipPartFactory->GetShipPartPool()->Release(ShipPart);
+}
+
+void AShipEditorPlayerController::TrimShipPartPool()
+{
+	ShipPartFactory->GetShipPartPool()->Trim();
 }
 
 void AShipEditorPlayerController::ClearShip()
 {
 	UE_LOG(LogTemp, Log, TEXT("Clearing ship"));
-	ShipUtils::DestroyActorArray(ShipParts);
+	CancelShipLoad();
+	OnReleaseClick();
+	AssemblyGraph.Reset();
+	FreePointGrid.Reset();
+	CompatibilityCache.Invalidate();
+	ShipPartFactory->GetShipPartPool()->ReleaseArray(ShipParts);
+	if (EditJournal.IsValid())
+	{
+		EditJournal->Rebase(ShipParts);
+	}
+}
+
+bool AShipEditorPlayerController::IsShipOnePiece() const
+{
+	return AssemblyGraph.IsOnePiece();
+}
+
+void AShipEditorPlayerController::ShipPartPoolStats()
+{
+	ShipPartFactory->GetShipPartPool()->LogStats();
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -307,69 +594,337 @@ bool AShipEditorPlayerController::SaveShip(const FString& ShipName)
 {
 	UE_LOG(LogTemp, Log, TEXT("Saving ship: %s"), *ShipName);
 
-	UShipSaveGame* ShipSaveData = GetSaveDataForShip(ShipName);
+	if (IsSavingShip(ShipName))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s is already being saved"), *ShipName);
+		return false;
+	}
+
+	if (IsLoadingShip())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Can't save %s while a ship is still loading"), *ShipName);
+		return false;
+	}
+
+	// Everything in the slot is replaced, so there's no need to load what's already there.
+	UShipSaveGame* ShipSaveData = Cast<UShipSaveGame>(UGameplayStatics::CreateSaveGameObject(UShipSaveGame::StaticClass()));
 	if (!ShipSaveData)
 	{
-		UE_LOG(LogTemp, Error, TEXT("Failed to get or create save data for ship: %s"), *ShipName);
+		UE_LOG(LogTemp, Error, TEXT("Failed to create save data for ship: %s"), *ShipName);
 		return false;
 	}
 
-	if (!ShipSaveData->SaveShip(ShipName, ShipParts))
+	if (!ShipSaveData->SaveShip(ShipName, ShipParts, SaveQuantization))
 	{
 		UE_LOG(LogTemp, Error, TEXT("Failed to save data for ship: %s"), *ShipName);
 		return false;
 	}
 
+	ValidateSaveRoundTrip(ShipName);
+
+	FShipSaveHeader Header;
+	Header.Capture(ShipParts);
+	Header.FormatVersion = ShipSaveData->GetFormatVersion();
+
 	// TODO: update some internal flag that there are no unsaved changes (set false when change is made). Used to check if we should prompt to save before loading/exiting.
 	// TODO: maybe create some sort of prefix for the slot name.
-	return UGameplayStatics::SaveGameToSlot(ShipSaveData, ShipName, 0);
+	if (SaveBackend == EShipSaveBackend::SB_LibraryPack)
+	{
+		return GetLibraryPack().Save(ShipName, Header, ShipSaveData);
+	}
+	return ShipSaveFile::Save(ShipName, Header, ShipSaveData);
+}
+
+bool AShipEditorPlayerController::SaveShipAsync(const FString& ShipName)
+{
+	UE_LOG(LogTemp, Log, TEXT("Saving ship in the background: %s"), *ShipName);
+
+	if (IsSavingShip(ShipName))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s is already being saved"), *ShipName);
+		return false;
+	}
+
+	if (IsLoadingShip())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Can't save %s while a ship is still loading"), *ShipName);
+		return false;
+	}
+
+	// The pack's index has to be updated on the game thread anyway, so save it straight away.
+	if (SaveBackend == EShipSaveBackend::SB_LibraryPack)
+	{
+		const bool bSaved = SaveShip(ShipName);
+		OnShipSaveComplete.Broadcast(ShipName, bSaved);
+		return bSaved;
+	}
+
+	ValidateSaveRoundTrip(ShipName);
+
+	auto OnComplete = FOnShipAsyncSaveComplete::CreateUObject(this, &AShipEditorPlayerController::HandleShipSaveComplete);
+	ActiveSaves.Add(ShipName, FShipAsyncSave::Start(ShipName, ShipParts, SaveQuantization, OnComplete));
+	return true;
+}
+
+bool AShipEditorPlayerController::IsSavingShip(const FString& ShipName) const
+{
+	return ActiveSaves.Contains(ShipName);
+}
+
+void AShipEditorPlayerController::ValidateSaveRoundTrip(const FString& ShipName) const
+{
+	if (CVarValidateSaveRoundTrip.GetValueOnGameThread())
+	{
+		ensureMsgf(UShipSaveGame::ValidateCompactRoundTrip(ShipParts, SaveQuantization), TEXT("Compact save data for %s doesn't match the ship."), *ShipName);
+	}
+}
+
+void AShipEditorPlayerController::HandleShipSaveComplete(const FString& ShipName, bool bSuccess)
+{
+	ActiveSaves.Remove(ShipName);
+	UE_CLOG(!bSuccess, LogTemp, Error, TEXT("Failed to save data for ship: %s"), *ShipName);
+	OnShipSaveComplete.Broadcast(ShipName, bSuccess);
 }
 
 bool AShipEditorPlayerController::LoadShip(const FString& ShipName)
 {
 	UE_LOG(LogTemp, Log, TEXT("Loading ship: %s"), *ShipName);
 
+	UShipSaveGame* ShipSaveData = PrepareToLoadShip(ShipName);
+	if (!ShipSaveData)
+	{
+		return false;
+	}
+
+	// Convert records to ship parts.
+	TArray<AShipPart*> LoadedParts;
+	const bool bLoaded = ShipSaveData->LoadShip(this, LoadedParts, ShipPartFactory->GetShipPartPool());
+
+	// Track whatever parts were created, even if it failed part way through.
+	AddLoadedShipParts(MoveTemp(LoadedParts));
+
+	if (!bLoaded)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to create ship parts from save data for ship: %s"), *ShipName);
+		return false;
+	}
+
+	return true;
+}
+
+bool AShipEditorPlayerController::LoadShipStreaming(const FString& ShipName)
+{
+	UE_LOG(LogTemp, Log, TEXT("Streaming in ship: %s"), *ShipName);
+
+	UShipSaveGame* ShipSaveData = PrepareToLoadShip(ShipName);
+	if (!ShipSaveData)
+	{
+		return false;
+	}
+
+	// Only the compact format can be decoded up front.
+	if (!ShipSaveData->IsCompactFormat())
+	{
+		TArray<AShipPart*> LoadedParts;
+		const bool bLoaded = ShipSaveData->LoadShip(this, LoadedParts, ShipPartFactory->GetShipPartPool());
+		AddLoadedShipParts(MoveTemp(LoadedParts));
+		OnShipLoadComplete.Broadcast(ShipName, bLoaded);
+		return bLoaded;
+	}
+
+	FShipSnapshot Snapshot;
+	if (!ShipSaveData->DecodeShipData(Snapshot))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to decode save data for ship: %s"), *ShipName);
+		return false;
+	}
+
+	const FVector ViewLocation = PlayerCameraManager ? PlayerCameraManager->GetCameraLocation() : FVector::ZeroVector;
+	StreamingLoad = MakeUnique<FShipStreamingLoad>(GetWorld(), MoveTemp(Snapshot), StreamingLoadOrder, ViewLocation, ShipPartFactory->GetShipPartPool());
+	StreamingLoadShipName = ShipName;
+	return true;
+}
+
+void AShipEditorPlayerController::CancelShipLoad()
+{
+	if (StreamingLoad.IsValid())
+	{
+		UE_LOG(LogTemp, Log, TEXT("Cancelled loading ship: %s"), *StreamingLoadShipName);
+		StreamingLoad->Cancel();
+		StreamingLoad.Reset();
+		StreamingLoadShipName.Empty();
+	}
+}
+
+bool AShipEditorPlayerController::IsLoadingShip() const
+{
+	return StreamingLoad.IsValid();
+}
+
+float AShipEditorPlayerController::GetShipLoadProgress() const
+{
+	return StreamingLoad.IsValid() ? StreamingLoad->GetProgress() : 1.f;
+}
+
+UShipSaveGame* AShipEditorPlayerController::PrepareToLoadShip(const FString& ShipName)
+{
+	if (IsSavingShip(ShipName))
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s is still being saved"), *ShipName);
+		return nullptr;
+	}
+
+	CancelShipLoad();
+
 	// TODO: check if we're loading the one we're currently using.
 	// TODO: prompt to save current ship if we already have one loaded.
 	if (ShipParts.Num() > 0)
 	{
 		UE_LOG(LogTemp, Warning, TEXT("Existing ship parts exist; they will be destroyed when loading %s (for now)"), *ShipName);
-		ShipUtils::DestroyActorArray(ShipParts, true);
+		OnReleaseClick();
+		AssemblyGraph.Reset();
+		FreePointGrid.Reset();
+		CompatibilityCache.Invalidate();
+		ShipPartFactory->GetShipPartPool()->ReleaseArray(ShipParts, true);
+		if (EditJournal.IsValid())
+		{
+			EditJournal->Rebase(ShipParts);
+		}
 	}
 
-	if (!UGameplayStatics::DoesSaveGameExist(ShipName, 0))
+	const bool bUseLibraryPack = (SaveBackend == EShipSaveBackend::SB_LibraryPack);
+	if (bUseLibraryPack ? !GetLibraryPack().Contains(ShipName) : !UGameplayStatics::DoesSaveGameExist(ShipName, 0))
 	{
 		UE_LOG(LogTemp, Error, TEXT("No save data exists for ship: %s"), *ShipName);
-		return false;
+		return nullptr;
 	}
 
-	UShipSaveGame* ShipSaveData = Cast<UShipSaveGame>(UGameplayStatics::LoadGameFromSlot(ShipName, 0));
+	UShipSaveGame* ShipSaveData = Cast<UShipSaveGame>(bUseLibraryPack ? GetLibraryPack().Load(ShipName) : ShipSaveFile::Load(ShipName));
 	if (!ShipSaveData)
 	{
 		UE_LOG(LogTemp, Error, TEXT("Failed to load save data for ship: %s"), *ShipName);
-		return false;
+		return nullptr;
 	}
 	checkf(ShipSaveData->GetShipName() == ShipName, TEXT("Ship name in record does not match the one requested to be loaded."));
+	return ShipSaveData;
+}
 
-	// Convert records to ship parts and store in our ShipParts array.
-	if (!ShipSaveData->LoadShip(this, ShipParts))
+bool AShipEditorPlayerController::HasAutosavedShip() const
+{
+	return FShipEditJournal::HasRecoverableShip(FShipEditJournal::GetDefaultDirectory());
+}
+
+bool AShipEditorPlayerController::RecoverAutosavedShip()
+{
+	FShipSnapshot Snapshot;
+	if (!FShipEditJournal::Recover(FShipEditJournal::GetDefaultDirectory(), Snapshot))
 	{
-		UE_LOG(LogTemp, Error, TEXT("Failed to create ship parts from save data for ship: %s"), *ShipName);
 		return false;
 	}
 
+	UE_LOG(LogTemp, Log, TEXT("Recovering autosaved ship of %d parts"), Snapshot.Parts.Num());
+	ClearShip();
+
+	TArray<AShipPart*> LoadedParts;
+	const bool bSpawned = UShipSaveGame::SpawnSnapshot(GetWorld(), Snapshot, LoadedParts, ShipPartFactory->GetShipPartPool());
+	UE_CLOG(!bSpawned, LogTemp, Error, TEXT("Failed to create some of the autosaved ship's parts"));
+	AddLoadedShipParts(MoveTemp(LoadedParts));
 	return true;
 }
 
-UShipSaveGame* AShipEditorPlayerController::GetSaveDataForShip(const FString& ShipName) const
+void AShipEditorPlayerController::FlushEditJournal()
+{
+	EditJournal->Flush();
+}
+
+FShipLibraryPack& AShipEditorPlayerController::GetLibraryPack()
+{
+	if (!LibraryPack.IsValid())
+	{
+		LibraryPack = MakeUnique<FShipLibraryPack>(FShipLibraryPack::GetDefaultFilename());
+	}
+	return *LibraryPack;
+}
+
+void AShipEditorPlayerController::CompactShipLibrary()
+{
+	GetLibraryPack().Compact();
+}
+
+void AShipEditorPlayerController::AddLoadedShipParts(TArray<AShipPart*>&& LoadedParts)
+{
+	// The saved attachments are restored without firing the attach events, so they're picked up here and the attached points are left out of the grid.
+	for (AShipPart* ShipPart : LoadedParts)
+	{
+		FreePointGrid.AddShipPart(ShipPart);
+	}
+
+	// Parts may have been spawned while a streaming load was in progress.
+	if (ShipParts.Num() > 0)
+	{
+		ShipParts.Append(LoadedParts);
+	}
+	else
+	{
+		ShipParts = MoveTemp(LoadedParts);
+	}
+	AssemblyGraph.Build(ShipParts);
+	DematerializeIdleParts(ShipParts);
+
+	// Journal the loaded ship as a whole rather than a spawn per part.
+	if (EditJournal.IsValid())
+	{
+		EditJournal->Rebase(ShipParts);
+	}
+}
+
+void AShipEditorPlayerController::DematerializeIdleParts(const TArray<AShipPart*>& InShipParts) const
+{
+	if (!bInstanceIdleParts)
+	{
+		return;
+	}
+
+	for (AShipPart* ShipPart : InShipParts)
+	{
+		ShipPart->Dematerialize();
+	}
+}
+
+void AShipEditorPlayerController::TickStreamingLoad()
 {
-	return UGameplayStatics::DoesSaveGameExist(ShipName, 0)
-		? Cast<UShipSaveGame>(UGameplayStatics::LoadGameFromSlot(ShipName, 0))
-		: Cast<UShipSaveGame>(UGameplayStatics::CreateSaveGameObject(UShipSaveGame::StaticClass()));
+	if (!StreamingLoad->Tick(StreamingLoadBudgetMs))
+	{
+		return;
+	}
+
+	// Reset before broadcasting in case a listener starts another load.
+	TUniquePtr<FShipStreamingLoad> CompletedLoad = MoveTemp(StreamingLoad);
+	const FString ShipName = MoveTemp(StreamingLoadShipName);
+	StreamingLoadShipName.Empty();
+
+	AddLoadedShipParts(MoveTemp(CompletedLoad->GetShipParts()));
+
+	const bool bSuccess = !CompletedLoad->HasFailures();
+	UE_CLOG(!bSuccess, LogTemp, Error, TEXT("Failed to create ship parts from save data for ship: %s"), *ShipName);
+	UE_LOG(LogTemp, Log, TEXT("Finished loading ship: %s"), *ShipName);
+	OnShipLoadComplete.Broadcast(ShipName, bSuccess);
 }
 
 bool AShipEditorPlayerController::GetSavedShipNames(TArray<FName>& OutShipNames)
 {
+	if (SaveBackend == EShipSaveBackend::SB_LibraryPack)
+	{
+		TArray<FShipSaveInfo> Ships;
+		GetLibraryPack().GetShips(Ships);
+		OutShipNames.Reserve(OutShipNames.Num() + Ships.Num());
+		for (const FShipSaveInfo& Ship : Ships)
+		{
+			OutShipNames.Add(*Ship.ShipName);
+		}
+		return true;
+	}
+
 	// Directory visitor implementation that collects the filenames from a directory and optionally formats them.
 	struct FSaveGameVisitor : public IPlatformFile::FDirectoryVisitor
 	{
@@ -385,7 +940,8 @@ bool AShipEditorPlayerController::GetSavedShipNames(TArray<FName>& OutShipNames)
 
 		bool Visit(const TCHAR* FilenameOrDirectory, bool bIsDirectory) final
 		{
-			if (!bIsDirectory)
+			// Skip anything that isn't a save, ie. the temp files written by FShipAsyncSave.
+			if (!bIsDirectory && FPaths::GetExtension(FilenameOrDirectory) == TEXT("sav"))
 			{
 				FString Filename{ FilenameOrDirectory };
 				FormatFunction(Filename);
@@ -403,4 +959,14 @@ bool AShipEditorPlayerController::GetSavedShipNames(TArray<FName>& OutShipNames)
 		Filename = FPaths::GetBaseFilename(Filename); // Get just the filename.
 	}};
 	return PlatformFile.IterateDirectory(*SaveGameDir, SaveGameVisitor);
+}
+
+bool AShipEditorPlayerController::GetSavedShips(TArray<FShipSaveInfo>& OutShips)
+{
+	if (SaveBackend == EShipSaveBackend::SB_LibraryPack)
+	{
+		GetLibraryPack().GetShips(OutShips);
+		return true;
+	}
+	return SaveLibrary.GetShips(OutShips);
 }
\ No newline at end of file
@@ -3,10 +3,23 @@
 #pragma once
 
 #include "GameFramework/PlayerController.h"
+#include "ShipBuilding/ShipAttachPointGrid.h"
+#include "ShipBuilding/ShipCompatibilityCache.h"
+#include "ShipBuilding/ShipAssemblyGraph.h"
+#include "ShipBuilding/ShipPartGroup.h"
+#include "ShipBuilding/ShipPartPool.h"
+#include "Serialization/ShipRecords.h"
+#include "Serialization/ShipStreamingLoad.h"
+#include "Serialization/ShipSaveLibrary.h"
+#include "Serialization/ShipLibraryPack.h"
+#include "Serialization/ShipEditJournal.h"
 #include "ShipEditorPlayerController.generated.h"
 
 class AShipPart;
-class UShipAttachPoint;
+class FShipAsyncSave;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnShipSaveComplete, const FString&, ShipName, bool, bSuccess);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnShipLoadComplete, const FString&, ShipName, bool, bSuccess);
 
 /**
  * 
@@ -16,23 +29,56 @@ class SHIPBUILDINGDEMO_API AShipEditorPlayerController : public APlayerControlle
 {
 	GENERATED_BODY()
 
-	struct FAttachPointCacheEntry
-	{
-		UShipAttachPoint* OwnedPoint;
-		UShipAttachPoint* OtherPoint;
+	using FAttachPointCacheEntry = FShipCompatibilityCache::FEntry;
 
-		bool IsValid() const noexcept { return (OwnedPoint && OtherPoint); }
-	};
+	// Drives the snapping and saving internals directly to time them.
+	friend class UShipBenchCommandlet;
 
-	// Ship attach points compatible with the currently held ship part.
-	// Populated when a ship part is selected.
+	// Ship attach points compatible with the currently (or last) held ship part.
+	// Collected when a ship part is selected and kept up to date as points are attached/detached and parts are created/destroyed.
+	// Re-collected once the held part's snap range leaves the area it was collected from.
 	// TODO: Need to make uproperty to prevent gc?
-	TArray<FAttachPointCacheEntry> CachedCompatiblePoints;
+	FShipCompatibilityCache CompatibilityCache;
+
+	// Spatial index of all the attach points that aren't attached to anything.
+	FShipAttachPointGrid FreePointGrid;
+
+	// Which parts are attached to each other. Contains every part in ShipParts.
+	FShipAssemblyGraph AssemblyGraph;
+
+	// Handles for the attach point events bound to keep FreePointGrid, CompatibilityCache and AssemblyGraph up to date.
+	FDelegateHandle PointsAttachedHandle;
+	FDelegateHandle PointsDetachedHandle;
+
+	// Timer for periodically destroying parts that have been in the pool too long.
+	FTimerHandle TrimShipPartPoolHandle;
+
+	// Timer for periodically flushing the edit journal.
+	FTimerHandle AutosaveHandle;
+
+	// Autosave journal of the edits made to the ship. Null if autosaving is disabled.
+	TSharedPtr<FShipEditJournal, ESPMode::ThreadSafe> EditJournal;
+
+	// Saves started by SaveShipAsync that haven't finished yet, by ship name.
+	TMap<FString, TSharedPtr<FShipAsyncSave, ESPMode::ThreadSafe>> ActiveSaves;
+
+	// Load started by LoadShipStreaming that's still spawning parts, and the ship it's loading.
+	TUniquePtr<FShipStreamingLoad> StreamingLoad;
+	FString StreamingLoadShipName;
+
+	// Cached headers of the saved ships for GetSavedShips.
+	FShipSaveLibrary SaveLibrary;
+
+	// Pack the ships are saved to when SaveBackend is SB_LibraryPack. Created when it's first used.
+	TUniquePtr<FShipLibraryPack> LibraryPack;
 
 	// Ship part currently being held.
 	UPROPERTY(Transient)
 	AShipPart* CurrentlyHeldShipPart;
 
+	// CurrentlyHeldShipPart and any parts being dragged along with it.
+	FShipPartGroup HeldGroup;
+
 	// Wolrd space position of CurrentlyHeldShipPart last frame.
 	//FVector PreviousHeldPartLocation;
 
@@ -43,11 +89,71 @@ class SHIPBUILDINGDEMO_API AShipEditorPlayerController : public APlayerControlle
 	UPROPERTY()
 	class UShipPartFactory* ShipPartFactory;
 
+protected:
+	// Size in uu of the cells in the free attach point grid. Should be roughly the size of the parts' snap range.
+	UPROPERTY(EditDefaultsOnly, AdvancedDisplay, Category = "Snapping")
+	float AttachPointGridCellSize = 100.f;
+
+	// How many removed parts to keep around for reuse rather than destroying them.
+	UPROPERTY(EditDefaultsOnly, Category = "ShipPartFactory")
+	FShipPartPoolSettings ShipPartPoolSettings;
+
+	// Stream in all the ship part classes in the background at startup so the first spawn of each part doesn't hitch.
+	UPROPERTY(EditDefaultsOnly, Category = "ShipPartFactory")
+	bool bPreloadShipPartClasses = true;
+
+	// How precisely part transforms are stored when saving a ship.
+	UPROPERTY(EditDefaultsOnly, Category = "ShipSaving")
+	FShipSaveQuantization SaveQuantization;
+
+	// Seconds between writing the edits made to the ship to the autosave journal. 0 disables autosaving.
+	UPROPERTY(EditDefaultsOnly, Category = "ShipSaving")
+	float AutosaveInterval = 5.f;
+
+	// Number of edits written to the autosave journal before it's folded into a new snapshot of the ship.
+	UPROPERTY(EditDefaultsOnly, AdvancedDisplay, Category = "ShipSaving")
+	int32 AutosaveCompactRecords = 1000;
+
+	// Restore the autosaved ship at startup if the editor wasn't shut down cleanly.
+	UPROPERTY(EditDefaultsOnly, Category = "ShipSaving")
+	bool bRecoverAutosave = true;
+
+	// Draw the parts that aren't being held as instanced meshes, only giving them back their own mesh while they're picked up.
+	// Keeps large ships cheap to render and edit.
+	UPROPERTY(EditDefaultsOnly, Category = "ShipManipulation")
+	bool bInstanceIdleParts = true;
+
 public:
+	// When set, grabbing a part drags everything attached to it along with it. Holding Alt when grabbing does the same.
+	UPROPERTY(BlueprintReadWrite, Category = "ShipManipulation")
+	bool bDragSubassemblies = false;
+
+	// Milliseconds per frame LoadShipStreaming can spend spawning parts.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ShipSaving")
+	float StreamingLoadBudgetMs = 4.f;
+
+	// Order LoadShipStreaming spawns the parts in.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ShipSaving")
+	EShipLoadOrder StreamingLoadOrder = EShipLoadOrder::LO_NearestToCamera;
+
+	// Where ships are saved, loaded and listed from.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ShipSaving")
+	EShipSaveBackend SaveBackend = EShipSaveBackend::SB_Slots;
+
+	// Broadcast when a save started by SaveShipAsync finishes.
+	UPROPERTY(BlueprintAssignable, Category = "ShipSaving")
+	FOnShipSaveComplete OnShipSaveComplete;
+
+	// Broadcast when a load started by LoadShipStreaming finishes. Not broadcast if it's cancelled.
+	UPROPERTY(BlueprintAssignable, Category = "ShipSaving")
+	FOnShipLoadComplete OnShipLoadComplete;
+
 	AShipEditorPlayerController();
 	
 	// Begin PlayerController Interface.
 	void PostInitializeComponents() override;
+	void BeginPlay() override;
+	void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	void SetupInputComponent() override;
 	void Tick(float DeltaTime) override;
 	// End PlayerController Interface.
@@ -61,25 +167,95 @@ public:
 	UFUNCTION(Exec, BlueprintCallable, Category = "ShipSaving")
 	bool SaveShip(const FString& ShipName);
 
+	/**
+	 *	Saves the ship in the background. Only copying the parts' state happens on the game thread.
+	 *	OnShipSaveComplete is broadcast when it's done.
+	 *
+	 *	@param ShipName: The name the user entered.
+	 *	@return: True if the save was started. Fails if the same ship is already being saved.
+	 */
+	UFUNCTION(Exec, BlueprintCallable, Category = "ShipSaving")
+	bool SaveShipAsync(const FString& ShipName);
+
+	// Is a save started by SaveShipAsync still in progress for the ship.
+	UFUNCTION(BlueprintCallable, Category = "ShipSaving")
+	bool IsSavingShip(const FString& ShipName) const;
+
 	// Temp BPCallable for use in our hacky temp UI.
 	// ShipName is name of the ship to load.
 	// Returns if it loaded successfully or not.
 	UFUNCTION(Exec, BlueprintCallable, Category = "ShipSaving")
 	bool LoadShip(const FString& ShipName);
 
+	/**
+	 *	Loads a ship over several frames, spending at most StreamingLoadBudgetMs per frame spawning parts in StreamingLoadOrder.
+	 *	Parts can't be picked up until it's finished. OnShipLoadComplete is broadcast when it's done.
+	 *	Ships saved in the legacy format are loaded all at once.
+	 *
+	 *	@param ShipName: The name of the ship to load.
+	 *	@return: True if the load was started.
+	 */
+	UFUNCTION(Exec, BlueprintCallable, Category = "ShipSaving")
+	bool LoadShipStreaming(const FString& ShipName);
+
+	// Stops a load started by LoadShipStreaming and removes the parts it has spawned so far.
+	UFUNCTION(Exec, BlueprintCallable, Category = "ShipSaving")
+	void CancelShipLoad();
+
+	// Is a load started by LoadShipStreaming still spawning parts.
+	UFUNCTION(BlueprintCallable, Category = "ShipSaving")
+	bool IsLoadingShip() const;
+
+	// Fraction of the parts a load started by LoadShipStreaming has spawned. 1 if there isn't one.
+	UFUNCTION(BlueprintCallable, Category = "ShipSaving")
+	float GetShipLoadProgress() const;
+
+	// Is there an autosaved ship left over from a session that wasn't shut down cleanly.
+	UFUNCTION(BlueprintCallable, Category = "ShipSaving")
+	bool HasAutosavedShip() const;
+
+	// Replaces the current ship with the autosaved one, replaying the edits journaled since its last snapshot.
+	// Returns if there was an autosaved ship to recover.
+	UFUNCTION(Exec, BlueprintCallable, Category = "ShipSaving")
+	bool RecoverAutosavedShip();
+
 	// Gets the names of all the saved ships.
 	// Returns if the shipnames were retrieved successfully.
 	UFUNCTION(BlueprintCallable, Category = "ShipSaving")
 	bool GetSavedShipNames(TArray<FName>& OutShipNames);
 
+	// Gets the saved ships with their part count, size and when they were saved, for the ship library.
+	// Only reads the headers of saves that have changed since the last call.
+	UFUNCTION(BlueprintCallable, Category = "ShipSaving")
+	bool GetSavedShips(TArray<FShipSaveInfo>& OutShips);
+
 	/**
 	 *	Clears all current ship parts.
 	 */
 	UFUNCTION(Exec, BlueprintCallable, Category = "ShipManipulation")
 	void ClearShip();
 
+	/**
+	 *	Checks if all the ship parts are attached together.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "ShipManipulation")
+	bool IsShipOnePiece() const;
+
+	/**
+	 *	Logs how the ship part pool is being used.
+	 */
+	UFUNCTION(Exec)
+	void ShipPartPoolStats();
+
+	/**
+	 *	Rewrites the ship library pack without the space left by ships that have been re-saved.
+	 */
+	UFUNCTION(Exec)
+	void CompactShipLibrary();
+
 	FORCEINLINE bool HoldingShipPart() const noexcept { return (CurrentlyHeldShipPart != nullptr); }
 	FORCEINLINE class UShipPartFactory* GetShipPartFactory() const noexcept { return ShipPartFactory; }
+	FORCEINLINE const FShipAssemblyGraph& GetAssemblyGraph() const noexcept { return AssemblyGraph; }
 
 private:
 	// Input callbacks
@@ -91,13 +267,47 @@ private:
 	void DeleteSelectedPart();
 
 	/**
-	 *	Gathers all Attach points that are compatible with the ship part.
+	 *	Lets go of the held part and any parts being dragged with it.
 	 *
-	 *	@param ShipPart: The part to find compatible points for.
+	 *	@param PartToDestroy: A held part that's about to be destroyed, so it's left as it is rather than being put back in the ship. Can be null.
+	 */
+	void ReleaseHeldParts(AShipPart* PartToDestroy);
+
+	// Attach point event handlers.
+	void HandlePointsAttached(const FShipAttachPointRef& A, const FShipAttachPointRef& B);
+	void HandlePointsDetached(const FShipAttachPointRef& A, const FShipAttachPointRef& B);
+
+	/**
+	 *	Gathers all Attach points within a box that are compatible with the free points of a group of parts.
+	 *
+	 *	@param Group: The part(s) to find compatible points for.
+	 *	@param QueryBox: The world space area to search for points in.
 	 *	@param OutCompatiblePoints: The compatible points that were found.
 	 *	@return: True if OutCompatiblePoints contains any points.
 	 */
-	bool CollectCompatiblePoints(const AShipPart* ShipPart, TArray<FAttachPointCacheEntry>& OutCompatiblePoints) const;
+	bool CollectCompatiblePoints(const FShipPartGroup& Group, const FBox& QueryBox, TArray<FAttachPointCacheEntry>& OutCompatiblePoints) const;
+
+	/**
+	 *	Re-collects the compatibility cache around the currently held part and updates the highlighting.
+	 */
+	void RefreshCachedCompatiblePoints();
+
+	/**
+	 *	Adds a newly freed point to the compatibility cache, highlighting any new pairs if we're holding a part.
+	 *
+	 *	@param Point: The point that was detached or spawned.
+	 */
+	void AddFreePointToCache(const FShipAttachPointRef& Point);
+
+	// Checks the compatibility cache against a full recompute if ShipEditor.ValidateCompatCache is set.
+	void ValidateCompatibilityCache() const;
+
+	/**
+	 *	Attaches/Detaches the other parts of the held group to the held part so the whole group is moved by moving the held part.
+	 *
+	 *	@param bAttach: Whether to attach or detach the parts.
+	 */
+	void SetGroupAttachedToHeldPart(bool bAttach);
 
 	/**
 	 *	Highlights/Unhighlights all points in a cache.
@@ -105,33 +315,67 @@ private:
 	 *	@param bHighlighted: Whether or not to highlight the points.
 	 *	@param InPoints: The list of cache entries whose points are to be highlighted/not.
 	 */
-	void SetCachedPointsHighlighted(bool bHighlighted, TArray<FAttachPointCacheEntry>& InPoints) const;
+	void SetCachedPointsHighlighted(bool bHighlighted, const TArray<FAttachPointCacheEntry>& InPoints) const;
 
 	/**
 	 *	Searches the cache for any entry whose two points meet the requirements to snap together.
 	 *
-	 *	@param CompatiblePoints: The cache of points to search.
+	 *	@param Candidates: Snapshot of the cache of points to search.
+	 *	@param HeldPartLocation: Where the held part currently is.
 	 *	@param Delta: The movement delta of the mouse since last frame.
 	 *	@return: The index of the cache entry whose points should be snapped together. INDEX_NONE otherwise.
 	 */
-	int32 FindPointsToSnapTogether(const TArray<FAttachPointCacheEntry>& CompatiblePoints, const FVector& Delta) const;
+	int32 FindPointsToSnapTogether(const FShipSnapCandidates& Candidates, const FVector& HeldPartLocation, const FVector& Delta) const;
 
 	/**
 	 *	Destroys a ship part and handles detaching it from other parts.
+	 *	The actor is returned to the ship part pool rather than actually being destroyed.
 	 *
 	 *	@param ShipPart: The ship part to destroy.
 	 */
 	void DestroyShipPart(AShipPart* ShipPart);
 
+	// Destroys parts that have been sitting in the ship part pool for too long.
+	void TrimShipPartPool();
+
+	/**
+	 *	Hands parts over to AShipPartInstances if bInstanceIdleParts is set.
+	 *
+	 *	@param InShipParts: The parts that are no longer being edited. Must not be held.
+	 */
+	void DematerializeIdleParts(const TArray<AShipPart*>& InShipParts) const;
+
 	//////////////////////////////////////////////////////////////////////////
 	// Saving
 	//////////////////////////////////////////////////////////////////////////
 
+	// Checks the compact save data against the legacy format if ShipEditor.ValidateSaveRoundTrip is set.
+	void ValidateSaveRoundTrip(const FString& ShipName) const;
+
+	// Called when a save started by SaveShipAsync finishes.
+	void HandleShipSaveComplete(const FString& ShipName, bool bSuccess);
+
 	/**
-	 *	Loads or creates a UShipSaveGame instance.
+	 *	Gets the save data for a ship to load, after getting rid of the current ship.
 	 *
-	 *	@param ShipName: The name of the ship to load the data for.
-	 *	@return: The sava data or null if it failed to load or create a new instance.
+	 *	@param ShipName: The ship to load.
+	 *	@return: The save data or null if it couldn't be loaded.
 	 */
-	class UShipSaveGame* GetSaveDataForShip(const FString& ShipName) const;
+	class UShipSaveGame* PrepareToLoadShip(const FString& ShipName);
+
+	// Gets the ship library pack, opening it if this is the first time it's been used.
+	FShipLibraryPack& GetLibraryPack();
+
+	// Writes the edits made since the last autosave to the journal.
+	void FlushEditJournal();
+
+	/**
+	 *	Starts tracking parts that have just been loaded.
+	 *
+	 *	@param LoadedParts: The parts that were loaded. Moved into ShipParts.
+	 */
+	void AddLoadedShipParts(TArray<AShipPart*>&& LoadedParts);
+
+	// Spawns the next batch of parts for the streaming load and finishes it once they're all spawned.
+	void TickStreamingLoad();
 };